@@ -0,0 +1,549 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "constants.h"
+#include "vendors.h"
+#include "eeprom.h"
+#include "hash.h"
+#include "container.h"
+#include "store.h"
+#include "files.h"
+#include "pool.h"
+#include "intern.h"
+#include "columns.h"
+#include "aggregate.h"
+
+/* files larger than this are not SPD images and are skipped unread */
+#define MAX_SPD_SIZE            1024
+/* groups per worker; later new groups are counted under "(other)" */
+#define MAX_GROUPS              65536
+#define GROUP_NAME_SIZE         160
+/* containers and stores are handed to workers in runs of this many images */
+#define ITEM_IMAGES             4096
+
+static const char *group_key_names[NUM_GROUP_KEYS] = {
+    "vendor", "dram_vendor", "part", "type", "organisation", "voltage", "size"
+};
+
+enum {
+    ITEM_FILE = 0,
+    ITEM_RECORD,
+    ITEM_SIGHTING
+};
+
+/* a run of images of one path */
+struct aggregate_item {
+    int path;
+    int kind;
+    uint64_t first;             /* record number or sighting offset */
+    uint32_t count;
+    uint64_t row;               /* of the first image, counted over all items */
+};
+
+/* the key values of a module, strings by their intern() handle */
+struct group_key {
+    uint32_t values[MAX_GROUP_KEYS];
+};
+
+struct group {
+    uint64_t hash;
+    struct group_key key;
+    int used;
+    uint64_t modules;
+    uint64_t capacity;          /* MB */
+};
+
+/* an open addressing table of groups, one per worker */
+struct group_table {
+    struct group *groups;
+    uint32_t size;              /* a power of two */
+    uint32_t count;
+    struct group other;
+    uint64_t images;
+    uint64_t skipped;
+};
+
+struct aggregate {
+    struct path_list list;
+    struct container *containers;
+    struct store *stores;
+    struct aggregate_item *items;
+    int count;
+    int size;
+    uint64_t rows;              /* images in all items */
+    int num_keys;
+    const int *keys;
+    struct group_table *tables;
+    struct column_table table;
+};
+
+/* Comma separated list of group_key_names */
+int parse_group_keys (const char *text, int *keys) {
+    char buffer[256], *key, *save;
+    int i, count = 0;
+
+    snprintf (buffer, sizeof (buffer), "%s", text);
+    for (key = strtok_r (buffer, ",", &save); key; key = strtok_r (NULL, ",", &save)) {
+        for (i = 0; i < NUM_GROUP_KEYS; i++)
+            if (!strcasecmp (key, group_key_names[i]))
+                break;
+        if (i == NUM_GROUP_KEYS || count == MAX_GROUP_KEYS)
+            return -1;
+        keys[count++] = i;
+    }
+    return count ? count : -1;
+}
+
+static int add_item (struct aggregate *aggregate, int path, int kind, uint64_t first,
+                     uint32_t count) {
+    struct aggregate_item *items;
+
+    if (aggregate->count == aggregate->size) {
+        aggregate->size = aggregate->size ? 2 * aggregate->size : 1024;
+        items = realloc (aggregate->items, aggregate->size * sizeof (*items));
+        if (!items)
+            return -1;
+        aggregate->items = items;
+    }
+    items = &aggregate->items[aggregate->count++];
+    items->path = path;
+    items->kind = kind;
+    items->first = first;
+    items->count = count;
+    items->row = aggregate->rows;
+    aggregate->rows += count;
+    return 0;
+}
+
+/*
+ * Split containers and stores into runs of ITEM_IMAGES, so that they
+ * spread over workers while the items take memory for one run each
+ * rather than for every image. Records are found by number; sightings
+ * vary in size, so the store is walked once for where each run starts.
+ */
+static int collect_items (struct aggregate *aggregate) {
+    struct image_info info;
+    size_t offset, next, start = 0;
+    uint32_t record, count, sightings;
+    int i, n;
+
+    aggregate->containers = calloc (aggregate->list.count ? aggregate->list.count : 1,
+                                    sizeof (struct container));
+    aggregate->stores = calloc (aggregate->list.count ? aggregate->list.count : 1,
+                                sizeof (struct store));
+    if (!aggregate->containers || !aggregate->stores)
+        return -1;
+
+    for (i = 0; i < aggregate->list.count; i++) {
+        const char *path = aggregate->list.paths[i];
+
+        if (!container_open (&aggregate->containers[i], path)) {
+            count = aggregate->containers[i].count;
+            for (record = 0; record < count; record += ITEM_IMAGES)
+                if (add_item (aggregate, i, ITEM_RECORD, record,
+                              count - record < ITEM_IMAGES ? count - record : ITEM_IMAGES))
+                    return -1;
+        } else if (is_store (path) && !store_map (&aggregate->stores[i], path)) {
+            for (offset = next = 0, sightings = 0;
+                 (n = store_next (&aggregate->stores[i], &next, &info)) > 0;
+                 offset = next) {
+                if (!sightings)
+                    start = offset;
+                if (++sightings == ITEM_IMAGES) {
+                    if (add_item (aggregate, i, ITEM_SIGHTING, start, sightings))
+                        return -1;
+                    sightings = 0;
+                }
+            }
+            if (sightings && add_item (aggregate, i, ITEM_SIGHTING, start, sightings))
+                return -1;
+            if (n < 0)
+                fprintf (stderr, "%s: corrupt sighting at offset %zu\n", path, offset);
+        } else if (add_item (aggregate, i, ITEM_FILE, 0, 1))
+            return -1;
+    }
+    return 0;
+}
+
+static const char *type_name (int type) {
+    switch (type) {
+    case MEMTYPE_SDR: return "SDR";
+    case MEMTYPE_DDR: return "DDR";
+    case MEMTYPE_DDR2: return "DDR2";
+    case MEMTYPE_DDR3: return "DDR3";
+    case MEMTYPE_DDR4: return "DDR4";
+    case MEMTYPE_DDR4E: return "DDR4E";
+    }
+    return "unknown";
+}
+
+/* The key of the group a module belongs to */
+static uint64_t group_key (struct group_key *key, const struct module_info *module,
+                           int num_keys, const int *keys) {
+    int i;
+
+    memset (key, 0, sizeof (*key));
+    for (i = 0; i < num_keys; i++) {
+        switch (keys[i]) {
+        case GROUP_VENDOR:
+            key->values[i] = module->vendor;
+            break;
+        case GROUP_DRAM_VENDOR:
+            key->values[i] = module->dram_vendor;
+            break;
+        case GROUP_PART:
+            key->values[i] = intern (module->part);
+            break;
+        case GROUP_TYPE:
+            key->values[i] = module->type;
+            break;
+        case GROUP_ORGANISATION:
+            key->values[i] = module->ranks << 16 | module->device_width << 1 | module->ecc;
+            break;
+        case GROUP_VOLTAGE:
+            key->values[i] = intern (module->voltage);
+            break;
+        case GROUP_SIZE:
+            key->values[i] = module->size;
+            break;
+        }
+    }
+    return hash64 (key, sizeof (*key));
+}
+
+/* The name of a group, the key values joined by " / " */
+static void group_name (char *name, const struct group_key *key,
+                        int num_keys, const int *keys) {
+    char value[64];
+    const char *text;
+    uint32_t v;
+    int i;
+
+    name[0] = 0;
+    for (i = 0; i < num_keys; i++) {
+        v = key->values[i];
+        switch (keys[i]) {
+        case GROUP_VENDOR:
+            snprintf (value, sizeof (value), "%s", get_vendor16 (v));
+            break;
+        case GROUP_DRAM_VENDOR:
+            snprintf (value, sizeof (value), "%s", v ? get_vendor16 (v) : "unknown");
+            break;
+        case GROUP_PART:
+            text = interned (v);
+            snprintf (value, sizeof (value), "%s", text[0] ? text : "-");
+            break;
+        case GROUP_TYPE:
+            snprintf (value, sizeof (value), "%s", type_name (v));
+            break;
+        case GROUP_ORGANISATION:
+            snprintf (value, sizeof (value), "%dRx%d%s", v >> 16,
+                      (v & 0xffff) >> 1, v & 1 ? " ECC" : "");
+            break;
+        case GROUP_VOLTAGE:
+            text = interned (v);
+            snprintf (value, sizeof (value), "%s", text[0] ? text : "unknown");
+            break;
+        case GROUP_SIZE:
+            snprintf (value, sizeof (value), "%dMB", v);
+            break;
+        }
+        if (i)
+            strncat (name, " / ", GROUP_NAME_SIZE - strlen (name) - 1);
+        strncat (name, value, GROUP_NAME_SIZE - strlen (name) - 1);
+    }
+}
+
+static struct group *find_group (struct group *groups, uint32_t size,
+                                 uint64_t hash, const struct group_key *key) {
+    uint32_t i;
+
+    for (i = hash & (size - 1); groups[i].used; i = (i + 1) & (size - 1))
+        if (groups[i].hash == hash && !memcmp (&groups[i].key, key, sizeof (*key)))
+            break;
+    return &groups[i];
+}
+
+/* Count modules and capacity under key; the table grows up to MAX_GROUPS */
+static void add_to_group (struct group_table *table, uint64_t hash,
+                          const struct group_key *key,
+                          uint64_t modules, uint64_t capacity) {
+    struct group *groups, *group;
+    uint32_t i, size;
+
+    if (table->count < MAX_GROUPS && 2 * (table->count + 1) > table->size) {
+        size = table->size ? 2 * table->size : 1024;
+        if ((groups = calloc (size, sizeof (*groups)))) {
+            for (i = 0; i < table->size; i++)
+                if (table->groups[i].used)
+                    *find_group (groups, size, table->groups[i].hash,
+                                 &table->groups[i].key) = table->groups[i];
+            free (table->groups);
+            table->groups = groups;
+            table->size = size;
+        }
+    }
+
+    group = table->groups ? find_group (table->groups, table->size, hash, key) : NULL;
+    if (!group || (!group->used &&
+                   (table->count >= MAX_GROUPS || 2 * (table->count + 1) > table->size)))
+        group = &table->other;
+    else if (!group->used) {
+        group->hash = hash;
+        group->key = *key;
+        group->used = 1;
+        table->count++;
+    }
+    group->modules += modules;
+    group->capacity += capacity;
+}
+
+/* Read a small plain file; returns its length, or -1 if it is skipped */
+static int read_file (const char *path, unsigned char *buffer) {
+    struct stat statbuf;
+    int fd, length = -1;
+
+    if ((fd = open (path, O_RDONLY)) < 0) {
+        fprintf (stderr, "Can't open %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    if (!fstat (fd, &statbuf) && statbuf.st_size <= MAX_SPD_SIZE)
+        length = read (fd, buffer, MAX_SPD_SIZE);
+    close (fd);
+    return length;
+}
+
+/*
+ * Image n of item, info->length is -1 if it can't be had. Sightings are
+ * read in order from *offset, which starts out as item->first.
+ */
+static void read_item (struct aggregate *aggregate, const struct aggregate_item *item,
+                       uint32_t n, size_t *offset, unsigned char *buffer,
+                       struct image_info *info) {
+    switch (item->kind) {
+    case ITEM_RECORD:
+        if (container_get (&aggregate->containers[item->path], item->first + n, info))
+            info->length = -1;
+        break;
+    case ITEM_SIGHTING:
+        if (store_next (&aggregate->stores[item->path], offset, info) <= 0)
+            info->length = -1;
+        break;
+    default:
+        info->image = buffer;
+        info->length = read_file (aggregate->list.paths[item->path], buffer);
+    }
+}
+
+static void aggregate_task (void *arg, int worker, int index) {
+    struct aggregate *aggregate = arg;
+    const struct aggregate_item *item = &aggregate->items[index];
+    struct group_table *table = &aggregate->tables[worker];
+    struct image_info info;
+    struct module_info module;
+    unsigned char buffer[MAX_SPD_SIZE];
+    struct group_key key;
+    size_t offset = item->first;
+    uint64_t hash;
+    uint32_t n;
+
+    for (n = 0; n < item->count; n++) {
+        table->images++;
+        read_item (aggregate, item, n, &offset, buffer, &info);
+        if (info.length < 0 || get_module_info (info.image, info.length, &module)) {
+            table->skipped++;
+            continue;
+        }
+        hash = group_key (&key, &module, aggregate->num_keys, aggregate->keys);
+        add_to_group (table, hash, &key, 1, module.size);
+    }
+}
+
+/* a group to be printed, named only once all are counted */
+struct named_group {
+    const struct group *group;
+    char name[GROUP_NAME_SIZE];
+};
+
+static int compare_groups (const void *a, const void *b) {
+    const struct named_group *x = a, *y = b;
+
+    if (x->group->modules != y->group->modules)
+        return x->group->modules > y->group->modules ? -1 : 1;
+    return strcmp (x->name, y->name);
+}
+
+/* Merge the worker tables into the first one and print it */
+static void print_groups (struct aggregate *aggregate, int jobs) {
+    struct group_table *total = &aggregate->tables[0], *table;
+    struct named_group *named;
+    uint64_t modules = 0, capacity = 0;
+    uint32_t i, n = 0;
+    int w, k;
+
+    for (w = 1; w < jobs; w++) {
+        table = &aggregate->tables[w];
+        for (i = 0; i < table->size; i++)
+            if (table->groups[i].used)
+                add_to_group (total, table->groups[i].hash, &table->groups[i].key,
+                              table->groups[i].modules, table->groups[i].capacity);
+        total->other.modules += table->other.modules;
+        total->other.capacity += table->other.capacity;
+        total->images += table->images;
+        total->skipped += table->skipped;
+    }
+
+    if (!(named = malloc ((total->count ? total->count : 1) * sizeof (*named)))) {
+        fprintf (stderr, "Out of memory\n");
+        return;
+    }
+    for (i = 0; i < total->size; i++)
+        if (total->groups[i].used) {
+            named[n].group = &total->groups[i];
+            group_name (named[n++].name, &total->groups[i].key,
+                        aggregate->num_keys, aggregate->keys);
+        }
+    qsort (named, n, sizeof (*named), compare_groups);
+
+    printf ("%10s %12s  ", "Modules", "Capacity");
+    for (k = 0; k < aggregate->num_keys; k++)
+        printf ("%s%s", k ? " / " : "", group_key_names[aggregate->keys[k]]);
+    printf ("\n");
+    for (i = 0; i < n; i++) {
+        printf ("%10llu %8.1f GiB  %s\n",
+                (unsigned long long) named[i].group->modules,
+                named[i].group->capacity / 1024.0, named[i].name);
+        modules += named[i].group->modules;
+        capacity += named[i].group->capacity;
+    }
+    if (total->other.modules) {
+        printf ("%10llu %8.1f GiB  (other)\n",
+                (unsigned long long) total->other.modules,
+                total->other.capacity / 1024.0);
+        modules += total->other.modules;
+        capacity += total->other.capacity;
+    }
+    printf ("%llu modules, %.1f GiB in %u groups; %llu of %llu images skipped\n",
+            (unsigned long long) modules, capacity / 1024.0, n,
+            (unsigned long long) total->skipped, (unsigned long long) total->images);
+    free (named);
+}
+
+/* The items below paths, with their containers and stores open */
+static int load_corpus (struct aggregate *aggregate, int count, char **paths) {
+    int i;
+
+    memset (aggregate, 0, sizeof (*aggregate));
+    for (i = 0; i < count; i++)
+        collect_path (paths[i], &aggregate->list);
+    return collect_items (aggregate);
+}
+
+static void free_corpus (struct aggregate *aggregate) {
+    int i;
+
+    for (i = 0; i < aggregate->list.count; i++) {
+        if (aggregate->containers && aggregate->containers[i].map)
+            container_close (&aggregate->containers[i]);
+        if (aggregate->stores && aggregate->stores[i].images)
+            store_unmap (&aggregate->stores[i]);
+    }
+    free (aggregate->containers);
+    free (aggregate->stores);
+    free (aggregate->items);
+    free_path_list (&aggregate->list);
+}
+
+/*
+ * Count the modules below paths and their capacity, grouped by keys.
+ * Workers fill tables of their own without locking, which are merged
+ * once all images are done.
+ */
+int aggregate_corpus (int count, char **paths, int jobs,
+                      int num_keys, const int *keys) {
+    struct aggregate aggregate;
+    int i, result = 0;
+
+    if (load_corpus (&aggregate, count, paths) ||
+        !(aggregate.tables = calloc (jobs, sizeof (struct group_table)))) {
+        fprintf (stderr, "Out of memory\n");
+        result = -1;
+        goto out;
+    }
+    aggregate.num_keys = num_keys;
+    aggregate.keys = keys;
+    pool_run (jobs, aggregate.count, aggregate_task, &aggregate);
+    print_groups (&aggregate, jobs);
+
+out:
+    if (aggregate.tables)
+        for (i = 0; i < jobs; i++)
+            free (aggregate.tables[i].groups);
+    free (aggregate.tables);
+    free_corpus (&aggregate);
+    return result;
+}
+
+/* Decode the images of item index into their rows of the columns, rows left zero are dropped */
+static void column_task (void *arg, int worker, int index) {
+    struct aggregate *aggregate = arg;
+    const struct aggregate_item *item = &aggregate->items[index];
+    struct image_info info;
+    struct module_info module;
+    unsigned char buffer[MAX_SPD_SIZE];
+    size_t offset = item->first;
+    uint32_t n;
+
+    for (n = 0; n < item->count; n++) {
+        read_item (aggregate, item, n, &offset, buffer, &info);
+        if (info.length >= 0 && !get_module_info (info.image, info.length, &module))
+            column_table_set (&aggregate->table, item->row + n, &module);
+    }
+}
+
+/*
+ * Decode the modules below paths once into columns, then count the
+ * modules and capacity matching each filter by scanning the columns
+ * of its predicates.
+ */
+int query_corpus (int count, char **paths, int jobs,
+                  int num_filters, char **texts, const struct filter *filters) {
+    struct aggregate aggregate;
+    uint64_t *selection = NULL;
+    uint32_t modules, images;
+    int i, result = 0;
+
+    if (load_corpus (&aggregate, count, paths) || aggregate.rows > UINT32_MAX ||
+        column_table_init (&aggregate.table, aggregate.rows) ||
+        !(selection = malloc (aggregate.table.size / 8 + 8))) {
+        fprintf (stderr, "Out of memory\n");
+        result = -1;
+        goto out;
+    }
+    pool_run (jobs, aggregate.count, column_task, &aggregate);
+    images = aggregate.table.rows;
+    column_table_compact (&aggregate.table);
+
+    printf ("%10s %12s  %s\n", "Modules", "Capacity", "Filter");
+    for (i = 0; i < num_filters; i++) {
+        modules = column_select (&aggregate.table, &filters[i], selection);
+        printf ("%10u %8.1f GiB  %s\n", modules,
+                column_sum (&aggregate.table, COLUMN_SIZE, selection) / 1024.0, texts[i]);
+    }
+    printf ("%u modules; %u of %u images skipped\n", aggregate.table.rows,
+            images - aggregate.table.rows, images);
+
+out:
+    free (selection);
+    column_table_free (&aggregate.table);
+    free_corpus (&aggregate);
+    return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+struct filter;
+
+enum {
+    GROUP_VENDOR = 0,
+    GROUP_DRAM_VENDOR,
+    GROUP_PART,
+    GROUP_TYPE,
+    GROUP_ORGANISATION,
+    GROUP_VOLTAGE,
+    GROUP_SIZE,
+    NUM_GROUP_KEYS
+};
+
+/* at most this many keys in one grouping */
+#define MAX_GROUP_KEYS          8
+
+int parse_group_keys (const char *text, int *keys);
+int aggregate_corpus (int count, char **paths, int jobs,
+                      int num_keys, const int *keys);
+/* Count the modules and capacity matching each of filters, given as texts */
+int query_corpus (int count, char **paths, int jobs,
+                  int num_filters, char **texts, const struct filter *filters);
@@ -0,0 +1,77 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+/* size of a block unless an allocation needs a larger one */
+#define ARENA_BLOCK             65536
+#define ARENA_ALIGN             16
+
+struct arena_block {
+    struct arena_block *next;
+    size_t used;
+    size_t size;
+    _Alignas (ARENA_ALIGN) unsigned char data[];
+};
+
+void *arena_alloc (struct arena *arena, size_t size) {
+    struct arena_block *block = arena->current, **link;
+    void *result;
+
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+    /* move on to the next block kept from before the last reset that fits */
+    while (block && block->size - block->used < size) {
+        block = block->next;
+        if (block)
+            block->used = 0;
+    }
+    if (!block) {
+        for (link = &arena->first; *link; link = &(*link)->next)
+            ;
+        if (!(block = malloc (sizeof (*block) + (size > ARENA_BLOCK ? size : ARENA_BLOCK))))
+            return NULL;
+        block->next = NULL;
+        block->used = 0;
+        block->size = size > ARENA_BLOCK ? size : ARENA_BLOCK;
+        *link = block;
+    }
+    arena->current = block;
+    result = block->data + block->used;
+    block->used += size;
+    return result;
+}
+
+void *arena_calloc (struct arena *arena, size_t size) {
+    void *result = arena_alloc (arena, size);
+
+    if (result)
+        memset (result, 0, size);
+    return result;
+}
+
+const char *arena_strndup (struct arena *arena, const char *text, size_t length) {
+    char *result;
+
+    length = strnlen (text, length);
+    if (!(result = arena_alloc (arena, length + 1)))
+        return NULL;
+    memcpy (result, text, length);
+    result[length] = 0;
+    return result;
+}
+
+void arena_reset (struct arena *arena) {
+    arena->current = arena->first;
+    if (arena->first)
+        arena->first->used = 0;
+}
+
+void arena_free (struct arena *arena) {
+    struct arena_block *block, *next;
+
+    for (block = arena->first; block; block = next) {
+        next = block->next;
+        free (block);
+    }
+    arena->first = arena->current = NULL;
+}
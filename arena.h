@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Bump allocator for data that lives exactly as long as a batch. Memory
+ * comes from a chain of blocks that reset() rewinds rather than frees,
+ * so once the chain has grown to the size of a batch, allocating costs
+ * no heap calls at all. One arena per thread, it takes no locks.
+ */
+struct arena_block;
+
+struct arena {
+    struct arena_block *first;
+    struct arena_block *current;
+};
+
+/* NULL if out of memory; memory is aligned for any type but not cleared */
+void *arena_alloc (struct arena *arena, size_t size);
+void *arena_calloc (struct arena *arena, size_t size);
+/* A copy of the first length bytes of text, NUL terminated */
+const char *arena_strndup (struct arena *arena, const char *text, size_t length);
+/* Make all memory handed out available again */
+void arena_reset (struct arena *arena);
+void arena_free (struct arena *arena);
@@ -0,0 +1,229 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "busstats.h"
+#include "output.h"
+
+/* bucket n counts latencies below 2^n us, the last one all longer ones */
+#define BUS_BUCKETS             24
+/* errno values counted one by one, larger ones go to 0 */
+#define BUS_ERRNOS              256
+#define MAX_ADAPTERS            128
+
+struct op_stats {
+    uint64_t count;
+    uint64_t errors;
+    uint64_t retries;
+    uint64_t bytes;
+    uint64_t total_ns;
+    uint64_t max_ns;
+    uint64_t buckets[BUS_BUCKETS];
+};
+
+struct adapter_stats {
+    char name[64];
+    struct op_stats ops[NUM_BUS_OPS];
+    uint64_t errnos[BUS_ERRNOS];
+};
+
+static const char *op_names[NUM_BUS_OPS] = {
+    [BUS_OPEN] = "open", [BUS_SELECT] = "select", [BUS_ADDRESS] = "address",
+    [BUS_READ] = "read", [BUS_SMBUS] = "smbus", [BUS_BANK] = "bank", [BUS_DDC] = "ddc"
+};
+
+static int enabled;
+static const char *json_path;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static struct adapter_stats *adapters[MAX_ADAPTERS];
+static int num_adapters;
+
+static __thread struct adapter_stats *current;
+
+static uint64_t now_ns (void) {
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+/* Adapters are looked up once per read_adapter(), so a list will do */
+void bus_stats_adapter (const char *adapter) {
+    struct adapter_stats *stats = NULL;
+    int i;
+
+    current = NULL;
+    if (!enabled || !adapter)
+        return;
+
+    pthread_mutex_lock (&lock);
+    for (i = 0; i < num_adapters; i++)
+        if (!strcmp (adapters[i]->name, adapter))
+            stats = adapters[i];
+    if (!stats && num_adapters < MAX_ADAPTERS &&
+        (stats = calloc (1, sizeof (*stats)))) {
+        snprintf (stats->name, sizeof (stats->name), "%s", adapter);
+        adapters[num_adapters++] = stats;
+    }
+    pthread_mutex_unlock (&lock);
+    current = stats;
+}
+
+uint64_t bus_stats_start (void) {
+    return current ? now_ns () : 0;
+}
+
+void bus_stats_end (int op, uint64_t start, int failed, int bytes) {
+    struct op_stats *stats;
+    uint64_t ns, us;
+    int saved = errno, bucket;
+
+    if (!current || !start)
+        return;
+
+    ns = now_ns () - start;
+    stats = &current->ops[op];
+    stats->count++;
+    stats->total_ns += ns;
+    if (ns > stats->max_ns)
+        stats->max_ns = ns;
+    for (bucket = 0, us = ns / 1000; us && bucket < BUS_BUCKETS - 1; us >>= 1)
+        bucket++;
+    stats->buckets[bucket]++;
+    if (failed) {
+        stats->errors++;
+        current->errnos[saved > 0 && saved < BUS_ERRNOS ? saved : 0]++;
+    } else if (bytes > 0)
+        stats->bytes += bytes;
+    errno = saved;
+}
+
+void bus_stats_retry (int op) {
+    if (current)
+        current->ops[op].retries++;
+}
+
+/* The upper bound of the bucket holding the given fraction of the count, in us */
+static uint64_t percentile (const struct op_stats *stats, double fraction) {
+    uint64_t seen = 0;
+    int bucket;
+
+    for (bucket = 0; bucket < BUS_BUCKETS - 1; bucket++) {
+        seen += stats->buckets[bucket];
+        if (seen >= fraction * stats->count)
+            return 1ull << bucket;
+    }
+    return stats->max_ns / 1000;
+}
+
+/* bytes per ns times 10^6 is bytes per ms, i.e. kB/s */
+static uint64_t throughput (const struct op_stats *stats) {
+    return stats->total_ns ? stats->bytes * 1000000 / stats->total_ns : 0;
+}
+
+static void print_summary (FILE *file) {
+    const struct op_stats *stats;
+    int i, op, err;
+
+    if (num_adapters)
+        fprintf (file, "Bus transactions, latencies in us, percentiles rounded up to a power of two\n");
+    for (i = 0; i < num_adapters; i++) {
+        fprintf (file, "%s\n  %-8s %8s %7s %7s %7s %7s %7s %7s %9s %7s\n", adapters[i]->name,
+                 "", "count", "errors", "retries", "mean", "p50", "p99", "max", "bytes", "kB/s");
+        for (op = 0; op < NUM_BUS_OPS; op++) {
+            stats = &adapters[i]->ops[op];
+            if (!stats->count)
+                continue;
+            fprintf (file, "  %-8s %8llu %7llu %7llu %7llu %7llu %7llu %7llu",
+                     op_names[op], (unsigned long long) stats->count,
+                     (unsigned long long) stats->errors,
+                     (unsigned long long) stats->retries,
+                     (unsigned long long) (stats->total_ns / stats->count / 1000),
+                     (unsigned long long) percentile (stats, 0.5),
+                     (unsigned long long) percentile (stats, 0.99),
+                     (unsigned long long) (stats->max_ns / 1000));
+            if (stats->bytes)
+                fprintf (file, " %9llu %7llu\n", (unsigned long long) stats->bytes,
+                         (unsigned long long) throughput (stats));
+            else
+                fprintf (file, "\n");
+        }
+        for (err = 0; err < BUS_ERRNOS; err++)
+            if (adapters[i]->errnos[err])
+                fprintf (file, "  errno %d (%s): %llu\n", err, err ? strerror (err) : "other",
+                         (unsigned long long) adapters[i]->errnos[err]);
+    }
+}
+
+static void print_json (FILE *file) {
+    const struct op_stats *stats;
+    char name[6 * sizeof (adapters[0]->name)];
+    int i, op, err, bucket, first;
+
+    fprintf (file, "{\"bucket_bounds_us\":[");
+    for (bucket = 0; bucket < BUS_BUCKETS - 1; bucket++)
+        fprintf (file, "%s%llu", bucket ? "," : "", 1ull << bucket);
+    fprintf (file, "],\"adapters\":[");
+    for (i = 0; i < num_adapters; i++) {
+        fprintf (file, "%s{\"adapter\":\"%s\",\"operations\":{", i ? "," : "",
+                 json_escape (name, sizeof (name), adapters[i]->name));
+        for (op = 0, first = 1; op < NUM_BUS_OPS; op++) {
+            stats = &adapters[i]->ops[op];
+            if (!stats->count)
+                continue;
+            fprintf (file, "%s\"%s\":{\"count\":%llu,\"errors\":%llu,\"retries\":%llu,"
+                     "\"bytes\":%llu,\"total_ns\":%llu,\"max_ns\":%llu,"
+                     "\"bytes_per_second\":%llu,\"histogram\":[",
+                     first ? "" : ",", op_names[op], (unsigned long long) stats->count,
+                     (unsigned long long) stats->errors,
+                     (unsigned long long) stats->retries,
+                     (unsigned long long) stats->bytes,
+                     (unsigned long long) stats->total_ns,
+                     (unsigned long long) stats->max_ns,
+                     (unsigned long long) throughput (stats) * 1000);
+            for (bucket = 0; bucket < BUS_BUCKETS; bucket++)
+                fprintf (file, "%s%llu", bucket ? "," : "",
+                         (unsigned long long) stats->buckets[bucket]);
+            fprintf (file, "]}");
+            first = 0;
+        }
+        fprintf (file, "},\"errno\":{");
+        for (err = 0, first = 1; err < BUS_ERRNOS; err++)
+            if (adapters[i]->errnos[err]) {
+                fprintf (file, "%s\"%d\":%llu", first ? "" : ",", err,
+                         (unsigned long long) adapters[i]->errnos[err]);
+                first = 0;
+            }
+        fprintf (file, "}}");
+    }
+    fprintf (file, "]}\n");
+}
+
+static void report (void) {
+    FILE *file;
+
+    pthread_mutex_lock (&lock);
+    if (!json_path)
+        print_summary (stderr);
+    else if (!(file = fopen (json_path, "w")))
+        fprintf (stderr, "Can't create %s: %s\n", json_path, strerror (errno));
+    else {
+        print_json (file);
+        if (fclose (file))
+            fprintf (stderr, "Can't write %s: %s\n", json_path, strerror (errno));
+    }
+    pthread_mutex_unlock (&lock);
+}
+
+int bus_stats_setup (const char *path) {
+    if (atexit (report)) {
+        fprintf (stderr, "Can't register the bus statistics report\n");
+        return -1;
+    }
+    json_path = path;
+    enabled = 1;
+    return 0;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+
+/* the bus transactions timed per adapter */
+enum {
+    BUS_OPEN = 0,               /* open() and the feature query */
+    BUS_SELECT,                 /* I2C_SLAVE_FORCE of a client */
+    BUS_ADDRESS,                /* write of the eeprom address pointer */
+    BUS_READ,                   /* read() of one chunk */
+    BUS_SMBUS,                  /* one SMBus byte or word read attempt */
+    BUS_BANK,                   /* EE1004 page switch */
+    BUS_DDC,                    /* one E-DDC segment transfer */
+    NUM_BUS_OPS
+};
+
+/*
+ * Latency histograms, error and byte counts per adapter and transaction.
+ * A thread names the adapter it drives with bus_stats_adapter(), after
+ * which its transactions are accounted there; an adapter must only be
+ * driven by one thread at a time, as read_adapter() does. Until
+ * bus_stats_setup() is called, nothing is recorded.
+ */
+
+/* Report at exit: a summary on stderr, or JSON written to path if given */
+int bus_stats_setup (const char *path);
+void bus_stats_adapter (const char *adapter);
+/* A timestamp to pass to bus_stats_end(), 0 when not recording */
+uint64_t bus_stats_start (void);
+/* Account for a transaction begun at start, taking errno if it failed; keeps errno */
+void bus_stats_end (int op, uint64_t start, int failed, int bytes);
+void bus_stats_retry (int op);
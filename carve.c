@@ -0,0 +1,180 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "constants.h"
+#include "eeprom.h"
+#include "ddc.h"
+#include "container.h"
+#include "files.h"
+#include "crc.h"
+#include "carve.h"
+
+/* SPD images are decoded from 256 bytes on, see get_eeprom_memreq() */
+#define SPD_MIN_SIZE            256
+
+static int crc_matches (const unsigned char *data, int count, int at) {
+    return spd_crc (data, count) == (data[at] | data[at + 1] << 8);
+}
+
+/*
+ * Cheap tests on a candidate at p: the EDID header, or a DDR3/DDR4
+ * memory type with a plausible bytes used/total byte. These are what the
+ * vector scan below computes 16 offsets at a time.
+ */
+static int is_edid_candidate (const unsigned char *p) {
+    return p[0] == 0x00 && p[1] == 0xff && p[6] == 0xff && p[7] == 0x00;
+}
+
+static int is_spd_candidate (const unsigned char *p) {
+    return (p[2] == MEMTYPE_DDR3 || p[2] == MEMTYPE_DDR4 || p[2] == MEMTYPE_DDR4E) &&
+        ((p[0] & 0x70) == 0x10 || (p[0] & 0x70) == 0x20);
+}
+
+/* Confirm a candidate; returns the image length, 0 if it is none */
+static int confirm (const unsigned char *p, size_t available) {
+    int i, length, sum = 0;
+
+    if (is_edid_candidate (p) && available >= EDID_BLOCK_SIZE && is_eedid (p)) {
+        for (i = 0; i < EDID_BLOCK_SIZE; i++)
+            sum += p[i];
+        if (sum & 0xff)
+            return 0;
+        /* keep the extension blocks that are there and check out */
+        for (length = EDID_BLOCK_SIZE;
+             length < EDID_BLOCK_SIZE * (1 + p[126]) &&
+             length + EDID_BLOCK_SIZE <= available; length += EDID_BLOCK_SIZE) {
+            for (i = sum = 0; i < EDID_BLOCK_SIZE; i++)
+                sum += p[length + i];
+            if (sum & 0xff)
+                break;
+        }
+        return length;
+    }
+
+    /* SPD revision 1.x and a module type the decoders know of */
+    if (!is_spd_candidate (p) || available < SPD_MIN_SIZE || (p[1] >> 4) != 1 ||
+        (p[3] & 0x0f) > 0x0d)
+        return 0;
+    /* DDR3 has a single CRC, so also insist on the reserved bits being clear */
+    if (p[2] == MEMTYPE_DDR3)
+        return (p[0] & 0x0f) >= 1 && (p[0] & 0x0f) <= 3 && !(p[4] & 0x80) &&
+            !(p[5] & 0xc0) && !(p[8] & 0xe0) &&
+            crc_matches (p, (p[0] & 0x80) ? 117 : 126, 126) ? SPD_MIN_SIZE : 0;
+    /* DDR4: both CRC protected blocks of the base configuration */
+    if (!crc_matches (p, 126, 126) || !crc_matches (p + 128, 126, 126))
+        return 0;
+    length = get_eeprom_memreq (p, available);
+    return length > SPD_MIN_SIZE && length <= available ? length : SPD_MIN_SIZE;
+}
+
+#ifdef __SSE2__
+/* candidate bitmap of the 16 offsets starting at p, p[0..23] readable */
+static unsigned int scan16 (const unsigned char *p) {
+    const __m128i zero = _mm_setzero_si128 (), ones = _mm_set1_epi8 (-1);
+    __m128i b0 = _mm_loadu_si128 ((const __m128i *) p);
+    __m128i b1 = _mm_loadu_si128 ((const __m128i *) (p + 1));
+    __m128i b2 = _mm_loadu_si128 ((const __m128i *) (p + 2));
+    __m128i b6 = _mm_loadu_si128 ((const __m128i *) (p + 6));
+    __m128i b7 = _mm_loadu_si128 ((const __m128i *) (p + 7));
+    __m128i edid, type, used, spd;
+
+    edid = _mm_and_si128 (_mm_and_si128 (_mm_cmpeq_epi8 (b0, zero),
+                                         _mm_cmpeq_epi8 (b1, ones)),
+                          _mm_and_si128 (_mm_cmpeq_epi8 (b6, ones),
+                                         _mm_cmpeq_epi8 (b7, zero)));
+    type = _mm_or_si128 (_mm_or_si128 (_mm_cmpeq_epi8 (b2, _mm_set1_epi8 (MEMTYPE_DDR3)),
+                                       _mm_cmpeq_epi8 (b2, _mm_set1_epi8 (MEMTYPE_DDR4))),
+                         _mm_cmpeq_epi8 (b2, _mm_set1_epi8 (MEMTYPE_DDR4E)));
+    used = _mm_and_si128 (b0, _mm_set1_epi8 (0x70));
+    spd = _mm_and_si128 (type, _mm_or_si128 (_mm_cmpeq_epi8 (used, _mm_set1_epi8 (0x10)),
+                                             _mm_cmpeq_epi8 (used, _mm_set1_epi8 (0x20))));
+    return _mm_movemask_epi8 (_mm_or_si128 (edid, spd));
+}
+#else
+static unsigned int scan16 (const unsigned char *p) {
+    unsigned int mask = 0;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        if (is_edid_candidate (p + i) || is_spd_candidate (p + i))
+            mask |= 1U << i;
+    return mask;
+}
+#endif
+
+static void carve_at (const char *path, const unsigned char *data, size_t offset,
+                      int length) {
+    char label[4200];
+
+    snprintf (label, sizeof (label), "%s@0x%llx", path, (unsigned long long) offset);
+    collect_image (SOURCE_FILE, label, 0, data + offset, length);
+    decode_image (label, data + offset, length);
+}
+
+int carve_file (const char *path) {
+    struct stat statbuf;
+    const unsigned char *data;
+    size_t offset, next = 0, block;
+    unsigned int mask;
+    int fd, length, edids = 0, spds = 0;
+
+    if ((fd = open (path, O_RDONLY)) < 0) {
+        fprintf (stderr, "Can't open %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    if (fstat (fd, &statbuf)) {
+        fprintf (stderr, "Can't stat() %s: %s\n", path, strerror (errno));
+        close (fd);
+        return -1;
+    }
+    if (statbuf.st_size < EDID_BLOCK_SIZE) {
+        close (fd);
+        printf ("Carved 0 EDIDs and 0 SPD images from %s\n", path);
+        return 0;
+    }
+    data = mmap (NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (data == MAP_FAILED) {
+        fprintf (stderr, "Can't mmap() %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    madvise ((void *) data, statbuf.st_size, MADV_SEQUENTIAL);
+
+    /* 16 offsets per step while a full 24 byte window is left */
+    for (block = 0; block < statbuf.st_size; block += 16) {
+        if (block + 24 <= statbuf.st_size)
+            mask = scan16 (data + block);
+        else
+            for (mask = 0, offset = block;
+                 offset < block + 16 && offset + EDID_BLOCK_SIZE <= statbuf.st_size;
+                 offset++)
+                if (is_edid_candidate (data + offset) || is_spd_candidate (data + offset))
+                    mask |= 1U << (offset - block);
+        for (; mask; mask &= mask - 1) {
+            offset = block + __builtin_ctz (mask);
+            if (offset < next ||
+                !(length = confirm (data + offset, statbuf.st_size - offset)))
+                continue;
+            carve_at (path, data, offset, length);
+            if (is_eedid (data + offset))
+                edids++;
+            else
+                spds++;
+            next = offset + length;
+        }
+    }
+    printf ("Carved %d EDIDs and %d SPD images from %s\n", edids, spds, path);
+
+    munmap ((void *) data, statbuf.st_size);
+    return edids + spds;
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+/*
+ * Carving: recover the EDIDs and DDR3/DDR4 SPD images embedded at any
+ * offset in firmware images, flash or memory dumps. Candidates are found
+ * with vector compares over the mapped file and only decoded once their
+ * checksum or CRC holds.
+ */
+int carve_file (const char *path);
@@ -0,0 +1,220 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <limits.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "constants.h"
+#include "eeprom.h"
+#include "vendors.h"
+#include "intern.h"
+#include "columns.h"
+
+const char *column_names[NUM_COLUMNS] = {
+    "type", "module_type", "size", "ranks", "bank_groups", "width", "ecc", "tck", "taa",
+    "vendor", "dram_vendor", "part"
+};
+
+/*
+ * Sizes are in MB, a G suffix gives GB; types and vendors are taken by
+ * name, part numbers match as a whole
+ */
+static int parse_value (int column, const char *text, int32_t *value) {
+    static const struct { const char *name; int type; } types[] = {
+        { "sdr", MEMTYPE_SDR }, { "ddr", MEMTYPE_DDR }, { "ddr2", MEMTYPE_DDR2 },
+        { "ddr3", MEMTYPE_DDR3 }, { "ddr4", MEMTYPE_DDR4 }, { "ddr4e", MEMTYPE_DDR4E }
+    };
+    long number;
+    char *end;
+    int i;
+
+    switch (column) {
+    case COLUMN_VENDOR:
+    case COLUMN_DRAM_VENDOR:
+        if ((i = parse_vendor16 (text)) < 0)
+            return -1;
+        *value = i;
+        return 0;
+    case COLUMN_PART:
+        if ((*value = intern (text)) == INTERN_NONE)
+            return -1;
+        return 0;
+    }
+    if (column == COLUMN_TYPE)
+        for (i = 0; i < sizeof (types) / sizeof (types[0]); i++)
+            if (!strcasecmp (text, types[i].name)) {
+                *value = types[i].type;
+                return 0;
+            }
+    number = strtol (text, &end, 0);
+    if (column == COLUMN_SIZE && (*end == 'G' || *end == 'g')) {
+        number *= 1024;
+        end++;
+    }
+    if (end == text || *end || number < INT_MIN || number > INT_MAX)
+        return -1;
+    *value = number;
+    return 0;
+}
+
+int parse_filter (const char *text, struct filter *filter) {
+    char buffer[256], *term, *save, *value, *high;
+    struct predicate *predicate;
+    int c;
+
+    memset (filter, 0, sizeof (*filter));
+    snprintf (buffer, sizeof (buffer), "%s", text);
+    for (term = strtok_r (buffer, ",", &save); term; term = strtok_r (NULL, ",", &save)) {
+        if (filter->count == MAX_PREDICATES || !(value = strchr (term, '=')))
+            return -1;
+        *value++ = 0;
+        for (c = 0; c < NUM_COLUMNS; c++)
+            if (!strcasecmp (term, column_names[c]))
+                break;
+        if (c == NUM_COLUMNS)
+            return -1;
+        predicate = &filter->predicates[filter->count++];
+        predicate->column = c;
+        predicate->low = INT32_MIN;
+        predicate->high = INT32_MAX;
+        if ((high = strstr (value, "..")) && c != COLUMN_PART) {
+            *high = 0;
+            high += 2;
+            if ((*value && parse_value (c, value, &predicate->low)) ||
+                (*high && parse_value (c, high, &predicate->high)))
+                return -1;
+        } else {
+            if (parse_value (c, value, &predicate->low))
+                return -1;
+            predicate->high = predicate->low;
+        }
+    }
+    return filter->count ? 0 : -1;
+}
+
+int column_table_init (struct column_table *table, uint32_t rows) {
+    int c;
+
+    memset (table, 0, sizeof (*table));
+    table->rows = rows;
+    table->size = (rows + 63) & ~63u;
+    for (c = 0; c < NUM_COLUMNS; c++)
+        if (!(table->columns[c] = calloc (table->size ? table->size : 64, sizeof (int32_t)))) {
+            column_table_free (table);
+            return -1;
+        }
+    return 0;
+}
+
+void column_table_free (struct column_table *table) {
+    int c;
+
+    for (c = 0; c < NUM_COLUMNS; c++)
+        free (table->columns[c]);
+    memset (table, 0, sizeof (*table));
+}
+
+void column_table_set (struct column_table *table, uint32_t row,
+                       const struct module_info *module) {
+    table->columns[COLUMN_TYPE][row] = module->type;
+    table->columns[COLUMN_MODULE_TYPE][row] = module->module_type;
+    table->columns[COLUMN_SIZE][row] = module->size;
+    table->columns[COLUMN_RANKS][row] = module->ranks;
+    table->columns[COLUMN_BANK_GROUPS][row] = module->bank_groups;
+    table->columns[COLUMN_WIDTH][row] = module->device_width;
+    table->columns[COLUMN_ECC][row] = module->ecc;
+    table->columns[COLUMN_TCK][row] = module->tck;
+    table->columns[COLUMN_TAA][row] = module->taa;
+    table->columns[COLUMN_VENDOR][row] = module->vendor;
+    table->columns[COLUMN_DRAM_VENDOR][row] = module->dram_vendor;
+    table->columns[COLUMN_PART][row] = intern (module->part);
+}
+
+void column_table_compact (struct column_table *table) {
+    uint32_t row, rows = 0;
+    int c;
+
+    for (row = 0; row < table->rows; row++) {
+        if (!table->columns[COLUMN_TYPE][row])
+            continue;
+        if (rows != row)
+            for (c = 0; c < NUM_COLUMNS; c++)
+                table->columns[c][rows] = table->columns[c][row];
+        rows++;
+    }
+    /* the rows left over at the end become zero padding */
+    for (c = 0; c < NUM_COLUMNS; c++)
+        memset (table->columns[c] + rows, 0, (table->rows - rows) * sizeof (int32_t));
+    table->rows = rows;
+}
+
+/* The bits of the 64 rows from values on that lie within low..high */
+static uint64_t scan_word (const int32_t *values, int32_t low, int32_t high) {
+    uint64_t bits = 0;
+    int i;
+
+#ifdef __SSE2__
+    const __m128i lows = _mm_set1_epi32 (low), highs = _mm_set1_epi32 (high);
+    __m128i v, out;
+
+    for (i = 0; i < 64; i += 4) {
+        v = _mm_loadu_si128 ((const __m128i *) (values + i));
+        out = _mm_or_si128 (_mm_cmplt_epi32 (v, lows), _mm_cmpgt_epi32 (v, highs));
+        bits |= (uint64_t) (~_mm_movemask_ps (_mm_castsi128_ps (out)) & 15) << i;
+    }
+#else
+    for (i = 0; i < 64; i++)
+        bits |= (uint64_t) (values[i] >= low && values[i] <= high) << i;
+#endif
+    return bits;
+}
+
+/*
+ * Each predicate is a pass over its column, the first one setting the
+ * selection and the others narrowing it down; words without any rows
+ * left are not looked at again.
+ */
+uint32_t column_select (const struct column_table *table, const struct filter *filter,
+                        uint64_t *selection) {
+    const struct predicate *predicate;
+    uint32_t w, words = (table->rows + 63) / 64, count = 0;
+    int p;
+
+    for (p = 0; p < filter->count; p++) {
+        predicate = &filter->predicates[p];
+        for (w = 0; w < words; w++) {
+            if (p && !selection[w])
+                continue;
+            selection[w] = (p ? selection[w] : ~0ull) &
+                scan_word (table->columns[predicate->column] + 64 * w,
+                           predicate->low, predicate->high);
+        }
+    }
+    if (table->rows % 64)
+        selection[words - 1] &= (1ull << (table->rows % 64)) - 1;
+    for (w = 0; w < words; w++)
+        count += __builtin_popcountll (selection[w]);
+    return count;
+}
+
+uint64_t column_sum (const struct column_table *table, int column,
+                     const uint64_t *selection) {
+    const int32_t *values = table->columns[column];
+    uint64_t bits, sum = 0;
+    uint32_t w;
+
+    for (w = 0; w < (table->rows + 63) / 64; w++) {
+        if (selection[w] == ~0ull) {
+            for (bits = 0; bits < 64; bits++)
+                sum += values[64 * w + bits];
+            continue;
+        }
+        for (bits = selection[w]; bits; bits &= bits - 1)
+            sum += values[64 * w + __builtin_ctzll (bits)];
+    }
+    return sum;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+struct module_info;
+
+/* The derived fields of a module, one column of each */
+enum {
+    COLUMN_TYPE = 0,
+    COLUMN_MODULE_TYPE,
+    COLUMN_SIZE,
+    COLUMN_RANKS,
+    COLUMN_BANK_GROUPS,
+    COLUMN_WIDTH,
+    COLUMN_ECC,
+    COLUMN_TCK,
+    COLUMN_TAA,
+    COLUMN_VENDOR,
+    COLUMN_DRAM_VENDOR,
+    COLUMN_PART,               /* intern() handles */
+    NUM_COLUMNS
+};
+
+/* at most this many predicates in one filter */
+#define MAX_PREDICATES          8
+
+/* low <= column <= high */
+struct predicate {
+    int column;
+    int32_t low;
+    int32_t high;
+};
+
+struct filter {
+    int count;
+    struct predicate predicates[MAX_PREDICATES];
+};
+
+/*
+ * A corpus decoded into one contiguous array per field, so that a
+ * predicate is a linear scan over a single column. Columns are padded
+ * to a multiple of 64 rows, one word of the selection per 64 rows.
+ */
+struct column_table {
+    uint32_t rows;
+    uint32_t size;              /* rows allocated */
+    int32_t *columns[NUM_COLUMNS];
+};
+
+extern const char *column_names[NUM_COLUMNS];
+
+/* Comma separated FIELD=VALUE or FIELD=LOW..HIGH, either bound may be left out */
+int parse_filter (const char *text, struct filter *filter);
+
+int column_table_init (struct column_table *table, uint32_t rows);
+void column_table_free (struct column_table *table);
+void column_table_set (struct column_table *table, uint32_t row,
+                       const struct module_info *module);
+/* Drop the rows of a zero type, the order of the others is kept */
+void column_table_compact (struct column_table *table);
+
+/* Set the bits of the rows matching all predicates of filter, returns their count */
+uint32_t column_select (const struct column_table *table, const struct filter *filter,
+                        uint64_t *selection);
+/* Sum of column over the selected rows */
+uint64_t column_sum (const struct column_table *table, int column,
+                     const uint64_t *selection);
@@ -0,0 +1,643 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "container.h"
+#include "eeprom.h"
+#include "hash.h"
+#include "store.h"
+
+static const char *source_names[] = { "file", "i2c", "dp-aux", "drm" };
+
+const char *source_name (int source) {
+    if (source < 0 || source >= sizeof (source_names) / sizeof (source_names[0]))
+        return "unknown";
+    return source_names[source];
+}
+
+int is_container (const unsigned char *data, size_t size) {
+    return size >= sizeof (struct container_header) + sizeof (struct container_footer) &&
+        !memcmp (data, CONTAINER_MAGIC, 8);
+}
+
+/* Validate a mapped container and locate its index */
+int container_map (struct container *container, const unsigned char *map,
+                   size_t size) {
+    const struct container_footer *footer;
+    uint64_t index_offset;
+    uint32_t count, version;
+
+    if (!is_container (map, size))
+        return -1;
+    /* a later version may store records in ways this one can't rebuild */
+    version = le32toh (((const struct container_header *) map)->version);
+    if (version > CONTAINER_VERSION)
+        return -1;
+    footer = (const struct container_footer *) (map + size - sizeof (*footer));
+    if (memcmp (footer->magic, CONTAINER_INDEX_MAGIC, 8))
+        return -1;
+    index_offset = le64toh (footer->index_offset);
+    count = le32toh (footer->count);
+    /* subtract first, the offsets come from the file and may be anything */
+    if (index_offset < sizeof (struct container_header) ||
+        index_offset > size - sizeof (*footer) ||
+        count > (size - sizeof (*footer) - index_offset) /
+        sizeof (struct container_index_entry))
+        return -1;
+
+    container->map = map;
+    container->size = size;
+    container->version = version;
+    container->index = (const struct container_index_entry *) (map + index_offset);
+    container->count = count;
+    return 0;
+}
+
+int container_open (struct container *container, const char *path) {
+    struct stat statbuf;
+    char magic[8];
+    void *map;
+    int fd;
+
+    if ((fd = open (path, O_RDONLY)) < 0)
+        return -1;
+    /* cheap check first, most files handed to us are plain images */
+    if (fstat (fd, &statbuf) || pread (fd, magic, 8, 0) != 8 ||
+        memcmp (magic, CONTAINER_MAGIC, 8)) {
+        close (fd);
+        errno = EINVAL;
+        return -1;
+    }
+    map = mmap (NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+        return -1;
+
+    if (container_map (container, map, statbuf.st_size)) {
+        munmap (map, statbuf.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void container_close (struct container *container) {
+    munmap ((void *) container->map, container->size);
+    container->map = NULL;
+}
+
+static void copy_name (char *dest, const unsigned char *src, int length) {
+    if (length > 255)
+        length = 255;
+    memcpy (dest, src, length);
+    dest[length] = 0;
+}
+
+/* A record of size bytes, checked to lie within the mapping */
+static const unsigned char *get_entry (const struct container *container,
+                                       uint32_t record, uint64_t *size) {
+    uint64_t offset;
+
+    if (record >= container->count)
+        return NULL;
+    offset = le64toh (container->index[record].offset);
+    *size = le32toh (container->index[record].size);
+    if (offset > container->size || *size > container->size - offset)
+        return NULL;
+    return container->map + offset;
+}
+
+static int is_compact (const struct container *container, uint32_t record) {
+    return container->version >= CONTAINER_VERSION_COMPACT &&
+        (le32toh (container->index[record].flags) & INDEX_DELTA);
+}
+
+/* The header of a record with one, checked to lie within the mapping */
+static const struct container_record *get_record (const struct container *container,
+                                                  uint32_t record, uint64_t *size) {
+    const struct container_record *header;
+
+    if (!(header = (const struct container_record *) get_entry (container, record, size)) ||
+        is_compact (container, record) || *size < sizeof (*header))
+        return NULL;
+    if (sizeof (*header) + le16toh (header->host_length) +
+        le16toh (header->adapter_length) > *size)
+        return NULL;
+    return header;
+}
+
+/*
+ * The header of the full record a delta refers to, with its image copied
+ * to info->data; references are always full records, so this does not
+ * recurse
+ */
+static const struct container_record *get_reference (const struct container *container,
+                                                     uint32_t reference,
+                                                     struct image_info *info) {
+    const struct container_record *header;
+    uint64_t size;
+    int length;
+
+    header = get_record (container, reference, &size);
+    if (!header || (le16toh (header->flags) & RECORD_DELTA))
+        return NULL;
+    length = le32toh (header->length);
+    if (length > CONTAINER_DELTA_MAX || sizeof (*header) + le16toh (header->host_length) +
+        le16toh (header->adapter_length) + length > size)
+        return NULL;
+    memcpy (info->data, (const unsigned char *) (header + 1) +
+            le16toh (header->host_length) + le16toh (header->adapter_length), length);
+    return header;
+}
+
+/* Apply the runs of a delta to the reference image in info->data */
+static int apply_runs (const unsigned char *delta, uint64_t size, struct image_info *info) {
+    const struct container_run *run;
+    int offset, length;
+
+    while (size) {
+        if (size < sizeof (*run))
+            return -1;
+        run = (const struct container_run *) delta;
+        offset = le16toh (run->offset);
+        length = run->length;
+        if (size < sizeof (*run) + length || offset + length > info->length)
+            return -1;
+        memcpy (info->data + offset, run + 1, length);
+        delta += sizeof (*run) + length;
+        size -= sizeof (*run) + length;
+    }
+    info->image = info->data;
+    return 0;
+}
+
+/* Rebuild a version 2 delta record of the given length in info->data */
+static int apply_delta (const struct container *container, const unsigned char *delta,
+                        uint64_t size, struct image_info *info) {
+    const struct container_record *header;
+
+    if (info->length > CONTAINER_DELTA_MAX || size < sizeof (struct container_delta))
+        return -1;
+    header = get_reference (container,
+                            le32toh (((const struct container_delta *) delta)->reference),
+                            info);
+    if (!header || le32toh (header->length) != info->length)
+        return -1;
+    return apply_runs (delta + sizeof (struct container_delta),
+                       size - sizeof (struct container_delta), info);
+}
+
+/* Rebuild a name from the reference's and a container_name_delta */
+static int apply_name (const unsigned char **delta, uint64_t *size,
+                       const unsigned char *reference, int reference_length, char *name) {
+    const struct container_name_delta *change;
+
+    if (*size < sizeof (*change))
+        return -1;
+    change = (const struct container_name_delta *) *delta;
+    if (*size < sizeof (*change) + change->length ||
+        change->prefix + change->suffix > reference_length ||
+        change->prefix + change->length + change->suffix > 255)
+        return -1;
+    memcpy (name, reference, change->prefix);
+    memcpy (name + change->prefix, change + 1, change->length);
+    memcpy (name + change->prefix + change->length,
+            reference + reference_length - change->suffix, change->suffix);
+    name[change->prefix + change->length + change->suffix] = 0;
+    *delta += sizeof (*change) + change->length;
+    *size -= sizeof (*change) + change->length;
+    return 0;
+}
+
+/* Rebuild a version 3 delta record, metadata and all */
+static int get_compact (const struct container *container, uint32_t record,
+                        struct image_info *info) {
+    const struct container_delta_record *delta;
+    const struct container_record *header;
+    const unsigned char *data, *names;
+    uint64_t size;
+    int host_length;
+
+    data = get_entry (container, record, &size);
+    if (!data || size < sizeof (*delta))
+        return -1;
+    delta = (const struct container_delta_record *) data;
+    if (!(header = get_reference (container, le32toh (delta->reference), info)))
+        return -1;
+    data += sizeof (*delta);
+    size -= sizeof (*delta);
+
+    info->length = le32toh (header->length);
+    info->source = delta->source;
+    info->client = delta->client;
+    info->timestamp = le64toh (header->timestamp) + (int32_t) le32toh (delta->timestamp);
+    names = (const unsigned char *) (header + 1);
+    host_length = le16toh (header->host_length);
+    if (apply_name (&data, &size, names, host_length, info->host) ||
+        apply_name (&data, &size, names + host_length,
+                    le16toh (header->adapter_length), info->adapter))
+        return -1;
+    return apply_runs (data, size, info);
+}
+
+int container_get (const struct container *container, uint32_t record,
+                   struct image_info *info) {
+    const struct container_record *header;
+    const unsigned char *names;
+    uint64_t size;
+    int host_length, adapter_length;
+
+    if (record < container->count && is_compact (container, record))
+        return get_compact (container, record, info);
+    if (!(header = get_record (container, record, &size)))
+        return -1;
+    host_length = le16toh (header->host_length);
+    adapter_length = le16toh (header->adapter_length);
+    info->length = le32toh (header->length);
+    size -= sizeof (*header) + host_length + adapter_length;
+
+    names = (const unsigned char *) (header + 1);
+    info->source = header->source;
+    info->client = header->client;
+    info->timestamp = le64toh (header->timestamp);
+    copy_name (info->host, names, host_length);
+    copy_name (info->adapter, names + host_length, adapter_length);
+    if (le16toh (header->flags) & RECORD_DELTA) {
+        if (container->version < CONTAINER_VERSION_DELTA)
+            return -1;
+        return apply_delta (container, names + host_length + adapter_length, size, info);
+    }
+    if (info->length > size)
+        return -1;
+    info->image = names + host_length + adapter_length;
+    return 0;
+}
+
+/*
+ * Collection: images read by any of the acquisition backends are
+ * appended to the output container, the index is written on close.
+ * They are also handed to the image store if one is being ingested into.
+ *
+ * In delta mode the first full record of each module or display model
+ * becomes its reference, and later images of the same model are stored
+ * as runs of differing bytes against it, as long as that saves at least
+ * half the image. Their names, which mostly share a prefix and suffix with
+ * the reference's, and their timestamp are stored as differences too.
+ */
+#define MAX_REFERENCES          4096
+#define REFERENCE_TABLE_SIZE    (2 * MAX_REFERENCES)
+
+struct reference {
+    uint64_t key;
+    uint32_t record;
+    int length;                 /* 0 for an empty slot */
+    uint64_t timestamp;
+    char host[256];
+    char adapter[256];
+    unsigned char image[CONTAINER_DELTA_MAX];
+};
+
+static struct {
+    FILE *file;
+    char host[256];
+    uint64_t offset;
+    struct container_index_entry *index;
+    uint32_t count;
+    uint32_t size;
+    struct reference *references;
+    int num_references;
+    uint32_t deltas;
+    uint64_t image_bytes;
+} output;
+
+static pthread_mutex_t output_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct collect_queue *queue;
+
+/*
+ * Images of one model share everything but the per unit fields; SPDs are
+ * told apart by type, manufacturers and part number, EDIDs by the
+ * manufacturer and product code.
+ */
+static int get_model_key (const unsigned char *image, int length, uint64_t *key) {
+    static const unsigned char edid_header[8] = { 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0 };
+    struct module_info module;
+    struct {
+        uint32_t length;
+        uint32_t type;
+        uint32_t vendor;
+        uint32_t dram_vendor;
+        char part[24];
+    } model;
+
+    memset (&model, 0, sizeof (model));
+    model.length = length;
+    if (length >= 128 && !memcmp (image, edid_header, 8)) {
+        model.type = 0x100;
+        model.vendor = image[8] << 8 | image[9];
+        model.dram_vendor = image[10] | image[11] << 8;
+    } else if (!get_module_info (image, length, &module)) {
+        model.type = module.type;
+        model.vendor = module.vendor;
+        model.dram_vendor = module.dram_vendor;
+        memcpy (model.part, module.part, sizeof (module.part));
+    } else
+        return -1;
+    *key = hash64 (&model, sizeof (model));
+    return 0;
+}
+
+static struct reference *find_reference (uint64_t key, int length) {
+    uint32_t i = key % REFERENCE_TABLE_SIZE;
+
+    while (output.references[i].length &&
+           (output.references[i].key != key || output.references[i].length != length))
+        i = (i + 1) % REFERENCE_TABLE_SIZE;
+    return &output.references[i];
+}
+
+/*
+ * Encode the bytes of image differing from reference as runs; equal
+ * stretches shorter than a run header are folded into the run. Returns
+ * the size of the runs, or -1 if they would exceed limit.
+ */
+static int encode_runs (const unsigned char *reference, const unsigned char *image,
+                        int length, unsigned char *delta, int limit) {
+    struct container_run *run;
+    int i = 0, j, start, end, size = 0;
+
+    while (i < length) {
+        if (image[i] == reference[i]) {
+            i++;
+            continue;
+        }
+        start = end = i;
+        for (j = i; j < length && j - start < 255; j++)
+            if (image[j] != reference[j])
+                end = j + 1;
+            else if (j - end >= sizeof (*run))
+                break;
+        if (size + sizeof (*run) + end - start > limit)
+            return -1;
+        run = (struct container_run *) (delta + size);
+        run->offset = htole16 (start);
+        run->length = end - start;
+        memcpy (run + 1, image + start, end - start);
+        size += sizeof (*run) + end - start;
+        i = end;
+    }
+    return size;
+}
+
+/* Encode name as the part between what it shares with reference at either end */
+static int encode_name (const char *reference, const char *name,
+                        unsigned char *delta, int limit) {
+    struct container_name_delta *change = (struct container_name_delta *) delta;
+    int reference_length = strlen (reference), length = strlen (name);
+    int prefix = 0, suffix = 0;
+
+    while (prefix < reference_length && prefix < length && reference[prefix] == name[prefix])
+        prefix++;
+    while (suffix < reference_length - prefix && suffix < length - prefix &&
+           reference[reference_length - suffix - 1] == name[length - suffix - 1])
+        suffix++;
+    length -= prefix + suffix;
+    if (sizeof (*change) + length > limit)
+        return -1;
+    change->prefix = prefix;
+    change->suffix = suffix;
+    change->length = length;
+    memcpy (change + 1, name + prefix, length);
+    return sizeof (*change) + length;
+}
+
+/* Encode a delta record against reference; returns its size, or -1 if over limit */
+static int encode_delta (const struct reference *reference, const struct image_info *info,
+                         const char *host, uint64_t timestamp,
+                         unsigned char *delta, int limit) {
+    struct container_delta_record *header = (struct container_delta_record *) delta;
+    int64_t offset = timestamp - reference->timestamp;
+    int size = sizeof (*header), n;
+
+    if (size > limit || offset < INT32_MIN || offset > INT32_MAX)
+        return -1;
+    header->reference = htole32 (reference->record);
+    header->source = info->source;
+    header->client = info->client;
+    header->timestamp = htole32 ((int32_t) offset);
+    if ((n = encode_name (reference->host, host, delta + size, limit - size)) < 0)
+        return -1;
+    size += n;
+    if ((n = encode_name (reference->adapter, info->adapter, delta + size, limit - size)) < 0)
+        return -1;
+    size += n;
+    if ((n = encode_runs (reference->image, info->image, info->length,
+                          delta + size, limit - size)) < 0)
+        return -1;
+    return size + n;
+}
+
+int collect_open (const char *path, int delta) {
+    struct container_header header;
+
+    if (delta && !(output.references = calloc (REFERENCE_TABLE_SIZE,
+                                               sizeof (*output.references)))) {
+        fprintf (stderr, "Out of memory\n");
+        return -1;
+    }
+    if (!(output.file = fopen (path, "w"))) {
+        fprintf (stderr, "Can't create %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    if (gethostname (output.host, sizeof (output.host)))
+        strcpy (output.host, "unknown");
+    output.host[sizeof (output.host) - 1] = 0;
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, CONTAINER_MAGIC, 8);
+    header.version = htole32 (delta ? CONTAINER_VERSION_COMPACT : 1);
+    fwrite (&header, sizeof (header), 1, output.file);
+    output.offset = sizeof (header);
+    return 0;
+}
+
+/*
+ * While a thread has a queue set, the images it collects are kept there
+ * rather than written, so workers running in any order can have theirs
+ * written in input order by collect_flush(). Pass NULL to write directly.
+ */
+void set_collect_queue (struct collect_queue *collect_queue) {
+    queue = collect_queue;
+}
+
+static void defer_info (const struct image_info *info) {
+    struct image_info *infos, *copy;
+    unsigned char *image;
+
+    if (queue->count == queue->size) {
+        queue->size = queue->size ? 2 * queue->size : 16;
+        infos = realloc (queue->infos, queue->size * sizeof (*infos));
+        if (!infos) {
+            fprintf (stderr, "Out of memory, image not collected\n");
+            queue->size = queue->count;
+            return;
+        }
+        queue->infos = infos;
+    }
+    if (!(image = malloc (info->length ? info->length : 1))) {
+        fprintf (stderr, "Out of memory, image not collected\n");
+        return;
+    }
+    memcpy (image, info->image, info->length);
+    copy = &queue->infos[queue->count++];
+    *copy = *info;
+    copy->image = image;
+    if (!copy->timestamp)
+        copy->timestamp = time (NULL);
+}
+
+/* Write the images of a queue in the order they were collected, and empty it */
+void collect_flush (struct collect_queue *collect_queue) {
+    int i;
+
+    for (i = 0; i < collect_queue->count; i++) {
+        collect_info (&collect_queue->infos[i]);
+        free ((void *) collect_queue->infos[i].image);
+    }
+    free (collect_queue->infos);
+    memset (collect_queue, 0, sizeof (*collect_queue));
+}
+
+/* Append an image with its metadata; an empty host means this host */
+void collect_info (const struct image_info *info) {
+    struct container_record record;
+    struct container_index_entry *index;
+    struct reference *reference;
+    const char *host = info->host[0] ? info->host : output.host;
+    unsigned char delta[CONTAINER_DELTA_MAX];
+    int host_length, adapter_length, size = -1;
+    uint64_t key, timestamp = info->timestamp ? info->timestamp : time (NULL);
+
+    if (queue) {
+        if (output.file || store_is_open ())
+            defer_info (info);
+        return;
+    }
+    store_add (info);
+    if (!output.file)
+        return;
+
+    host_length = strlen (host);
+    adapter_length = strlen (info->adapter);
+
+    memset (&record, 0, sizeof (record));
+    record.length = htole32 (info->length);
+    record.source = info->source;
+    record.client = info->client;
+    record.host_length = htole16 (host_length);
+    record.adapter_length = htole16 (adapter_length);
+    record.timestamp = htole64 (timestamp);
+
+    pthread_mutex_lock (&output_lock);
+    if (output.count == output.size) {
+        output.size = output.size ? 2 * output.size : 1024;
+        index = realloc (output.index, output.size * sizeof (*index));
+        if (!index) {
+            fprintf (stderr, "Out of memory, image not collected\n");
+            output.size = output.count;
+            pthread_mutex_unlock (&output_lock);
+            return;
+        }
+        output.index = index;
+    }
+
+    if (output.references && info->length <= CONTAINER_DELTA_MAX &&
+        !get_model_key (info->image, info->length, &key)) {
+        reference = find_reference (key, info->length);
+        if (reference->length)
+            size = encode_delta (reference, info, host, timestamp, delta, info->length / 2);
+        else if (output.num_references < MAX_REFERENCES) {
+            reference->key = key;
+            reference->record = output.count;
+            reference->length = info->length;
+            reference->timestamp = timestamp;
+            snprintf (reference->host, sizeof (reference->host), "%s", host);
+            snprintf (reference->adapter, sizeof (reference->adapter), "%s", info->adapter);
+            memcpy (reference->image, info->image, info->length);
+            output.num_references++;
+        }
+    }
+
+    index = &output.index[output.count++];
+    memset (index, 0, sizeof (*index));
+    index->offset = htole64 (output.offset);
+    if (size >= 0) {
+        fwrite (delta, 1, size, output.file);
+        index->flags = htole32 (INDEX_DELTA);
+        output.deltas++;
+    } else {
+        size = sizeof (record) + host_length + adapter_length + info->length;
+        fwrite (&record, sizeof (record), 1, output.file);
+        fwrite (host, 1, host_length, output.file);
+        fwrite (info->adapter, 1, adapter_length, output.file);
+        fwrite (info->image, 1, info->length, output.file);
+    }
+    index->size = htole32 (size);
+    output.offset += size;
+    output.image_bytes += info->length;
+    pthread_mutex_unlock (&output_lock);
+}
+
+void collect_image (int source, const char *adapter, int client,
+                    const unsigned char *image, int length) {
+    struct image_info info;
+
+    if (!output.file && !store_is_open ())
+        return;
+
+    memset (&info, 0, sizeof (info));
+    info.source = source;
+    info.client = client;
+    snprintf (info.adapter, sizeof (info.adapter), "%s", adapter);
+    info.image = image;
+    info.length = length;
+    collect_info (&info);
+}
+
+int collect_close (void) {
+    struct container_footer footer;
+    int result = 0;
+
+    if (!output.file)
+        return 0;
+
+    memset (&footer, 0, sizeof (footer));
+    footer.index_offset = htole64 (output.offset);
+    footer.count = htole32 (output.count);
+    memcpy (footer.magic, CONTAINER_INDEX_MAGIC, 8);
+    fwrite (output.index, sizeof (*output.index), output.count, output.file);
+    fwrite (&footer, sizeof (footer), 1, output.file);
+    if (ferror (output.file) | fclose (output.file)) {
+        fprintf (stderr, "Error writing container: %s\n", strerror (errno));
+        result = -1;
+    } else if (output.references)
+        fprintf (stderr, "Collected %u images of %llu bytes in %llu bytes, "
+                 "%u as deltas against %d models\n", output.count,
+                 (unsigned long long) output.image_bytes,
+                 (unsigned long long) (output.offset + output.count * sizeof (*output.index) +
+                                       sizeof (footer)),
+                 output.deltas, output.num_references);
+
+    free (output.index);
+    free (output.references);
+    memset (&output, 0, sizeof (output));
+    return result;
+}
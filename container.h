@@ -0,0 +1,149 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Container for many raw images in one file:
+ *
+ *   header | record 0 | record 1 | ... | index | footer
+ *
+ * Every record is a container_record followed by the host and adapter
+ * names (not terminated) and the raw image. The index holds one fixed
+ * size entry per record, so any record can be found in O(1) from the
+ * footer at the very end of the file. All values are little endian.
+ *
+ * Version 2 containers may hold delta records instead of the raw image:
+ * a container_delta naming a full record of the same module or display
+ * model, followed by container_runs of the bytes that differ from it
+ * (usually just serial number, date and checksum). The image is rebuilt
+ * from the reference on container_get(), so random access still works.
+ *
+ * In version 3 a delta record is marked in its index entry and has no
+ * container_record of its own: a container_delta_record holds what its
+ * metadata differs in from the reference's, the names follow as
+ * container_name_deltas, then the runs. The length is the reference's.
+ */
+#define CONTAINER_MAGIC         "DSPDCON1"
+#define CONTAINER_INDEX_MAGIC   "DSPDIDX1"
+/* largest image stored as a delta, enough for SPD and 4 block EDIDs */
+#define CONTAINER_DELTA_MAX     512
+
+/* the first version with delta records, with them compacted, and the latest one */
+#define CONTAINER_VERSION_DELTA 2
+#define CONTAINER_VERSION_COMPACT 3
+#define CONTAINER_VERSION       3
+
+/* container_record flags */
+#define RECORD_DELTA            0x0001
+
+/* container_index_entry flags */
+#define INDEX_DELTA             0x0001
+
+enum {
+    SOURCE_FILE = 0,
+    SOURCE_I2C,
+    SOURCE_DP_AUX,
+    SOURCE_DRM
+};
+
+#pragma pack(1)
+struct container_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct container_record {
+    uint32_t length;            /* of the raw image */
+    uint8_t source;
+    uint8_t client;             /* bus address, 0 if not applicable */
+    uint16_t host_length;
+    uint16_t adapter_length;
+    uint16_t flags;             /* RECORD_* */
+    uint64_t timestamp;         /* seconds since the epoch */
+};
+
+struct container_delta {
+    uint32_t reference;         /* record number of a full record */
+};
+
+struct container_delta_record {
+    uint32_t reference;         /* as in container_delta */
+    uint8_t source;
+    uint8_t client;
+    int32_t timestamp;          /* seconds after the reference's */
+};
+
+struct container_name_delta {
+    uint8_t prefix;             /* bytes shared with the start of the reference's name */
+    uint8_t suffix;             /* and with its end */
+    uint8_t length;             /* followed by that many bytes in between */
+};
+
+struct container_run {
+    uint16_t offset;
+    uint8_t length;             /* followed by that many image bytes */
+};
+
+struct container_index_entry {
+    uint64_t offset;            /* of the container_record */
+    uint32_t size;              /* of the record including names and image */
+    uint32_t flags;             /* INDEX_*, version 3 and later */
+};
+
+struct container_footer {
+    uint64_t index_offset;
+    uint32_t count;
+    uint32_t reserved;
+    char magic[8];
+};
+#pragma pack()
+
+/*
+ * A record as handed out by container_get(), pointing into the mapping;
+ * delta records are rebuilt in data[], which is reused by the next call.
+ */
+struct image_info {
+    int source;
+    int client;
+    uint64_t timestamp;
+    char host[256];
+    char adapter[256];
+    const unsigned char *image;
+    int length;
+    unsigned char data[CONTAINER_DELTA_MAX];
+};
+
+struct container {
+    const unsigned char *map;
+    size_t size;
+    uint32_t version;
+    const struct container_index_entry *index;
+    uint32_t count;
+};
+
+const char *source_name (int source);
+
+int is_container (const unsigned char *data, size_t size);
+int container_map (struct container *container, const unsigned char *map,
+                   size_t size);
+int container_open (struct container *container, const char *path);
+void container_close (struct container *container);
+int container_get (const struct container *container, uint32_t record,
+                   struct image_info *info);
+
+/* images collected by a thread while deferred, see set_collect_queue() */
+struct collect_queue {
+    struct image_info *infos;   /* with image pointing to a copy of its own */
+    int count;
+    int size;
+};
+
+int collect_open (const char *path, int delta);
+int collect_close (void);
+void collect_info (const struct image_info *info);
+void collect_image (int source, const char *adapter, int client,
+                    const unsigned char *image, int length);
+void set_collect_queue (struct collect_queue *queue);
+void collect_flush (struct collect_queue *queue);
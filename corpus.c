@@ -0,0 +1,183 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "output.h"
+#include "files.h"
+#include "container.h"
+#include "pool.h"
+#include "arena.h"
+#include "corpus.h"
+
+/* images decoded before their output is merged and written */
+#define CORPUS_BATCH            4096
+
+struct worker_output {
+    FILE *file;
+    char *buffer;
+    size_t size;
+    struct arena arena;         /* records of the batch */
+};
+
+/* a plain image file, or one record of a container */
+struct corpus_item {
+    int path;
+    int record;                 /* -1 for plain files */
+};
+
+struct task_output {
+    int worker;
+    int failed;
+    long start;
+    long end;
+    struct collect_queue collected;     /* images to collect, in order */
+};
+
+struct corpus {
+    struct path_list list;
+    struct container *containers;
+    struct corpus_item *items;
+    int count;
+    int size;
+    struct corpus_item *batch;
+    struct worker_output *workers;
+    struct task_output *tasks;
+    int records;
+};
+
+static int add_item (struct corpus *corpus, int path, int record) {
+    struct corpus_item *items;
+
+    if (corpus->count == corpus->size) {
+        corpus->size = corpus->size ? 2 * corpus->size : 1024;
+        items = realloc (corpus->items, corpus->size * sizeof (*items));
+        if (!items)
+            return -1;
+        corpus->items = items;
+    }
+    corpus->items[corpus->count].path = path;
+    corpus->items[corpus->count].record = record;
+    corpus->count++;
+    return 0;
+}
+
+/* Containers are split into their records so they spread across workers */
+static int collect_items (struct corpus *corpus) {
+    uint32_t record;
+    int i;
+
+    corpus->containers = calloc (corpus->list.count ? corpus->list.count : 1,
+                                 sizeof (struct container));
+    if (!corpus->containers)
+        return -1;
+
+    for (i = 0; i < corpus->list.count; i++) {
+        if (container_open (&corpus->containers[i], corpus->list.paths[i])) {
+            if (add_item (corpus, i, -1))
+                return -1;
+            continue;
+        }
+        for (record = 0; record < corpus->containers[i].count; record++)
+            if (add_item (corpus, i, record))
+                return -1;
+    }
+    return 0;
+}
+
+static void decode_task (void *arg, int worker, int index) {
+    struct corpus *corpus = arg;
+    struct corpus_item *item = &corpus->batch[index];
+    struct task_output *task = &corpus->tasks[index];
+    const char *path = corpus->list.paths[item->path];
+    FILE *file = corpus->workers[worker].file;
+
+    task->worker = worker;
+    task->start = ftell (file);
+    set_output (file);
+    set_collect_queue (&task->collected);
+    if (corpus->records)
+        set_record_arena (&corpus->workers[worker].arena);
+    if (item->record < 0)
+        task->failed = decode_file (path) != 0;
+    else
+        task->failed = decode_record (path, &corpus->containers[item->path],
+                                      item->record) != 0;
+    set_output (NULL);
+    set_collect_queue (NULL);
+    set_record_arena (NULL);
+    task->end = ftell (file);
+}
+
+/*
+ * Decode all files below paths with jobs worker threads. Every worker
+ * renders into a memory stream of its own; after each batch the pieces
+ * are written out in input order, so the output matches a serial run;
+ * so are the images collected into a container or store.
+ * With records, images are decoded into records from an arena of the
+ * worker that is reset after each batch, and printed as JSON.
+ */
+int decode_corpus (int count, char **paths, int jobs, int records) {
+    struct corpus corpus;
+    struct task_output *task;
+    int i, w, base, n, decoded = 0, workers = jobs;
+
+    memset (&corpus, 0, sizeof (corpus));
+    corpus.records = records;
+    for (i = 0; i < count; i++)
+        collect_path (paths[i], &corpus.list);
+
+    corpus.workers = calloc (jobs, sizeof (struct worker_output));
+    corpus.tasks = calloc (CORPUS_BATCH, sizeof (struct task_output));
+    if (!corpus.workers || !corpus.tasks || collect_items (&corpus)) {
+        fprintf (stderr, "Out of memory\n");
+        decoded = -1;
+        goto out;
+    }
+
+    for (base = 0; base < corpus.count; base += CORPUS_BATCH) {
+        n = corpus.count - base < CORPUS_BATCH ? corpus.count - base : CORPUS_BATCH;
+        corpus.batch = corpus.items + base;
+
+        for (w = 0; w < jobs; w++)
+            if (!(corpus.workers[w].file = open_memstream (&corpus.workers[w].buffer,
+                                                           &corpus.workers[w].size))) {
+                fprintf (stderr, "Can't create output buffer\n");
+                jobs = w;
+                break;
+            }
+        if (!jobs)
+            break;
+
+        pool_run (jobs, n, decode_task, &corpus);
+
+        for (w = 0; w < jobs; w++)
+            fclose (corpus.workers[w].file);
+        for (i = 0; i < n; i++) {
+            task = &corpus.tasks[i];
+            fwrite (corpus.workers[task->worker].buffer + task->start, 1,
+                    task->end - task->start, stdout);
+            collect_flush (&task->collected);
+            if (!task->failed)
+                decoded++;
+        }
+        for (w = 0; w < jobs; w++) {
+            free (corpus.workers[w].buffer);
+            arena_reset (&corpus.workers[w].arena);
+        }
+    }
+
+out:
+    if (corpus.containers)
+        for (i = 0; i < corpus.list.count; i++)
+            if (corpus.containers[i].map)
+                container_close (&corpus.containers[i]);
+    free (corpus.containers);
+    free (corpus.items);
+    if (corpus.workers)
+        for (w = 0; w < workers; w++)
+            arena_free (&corpus.workers[w].arena);
+    free (corpus.workers);
+    free (corpus.tasks);
+    free_path_list (&corpus.list);
+    return decoded;
+}
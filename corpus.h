@@ -0,0 +1,3 @@
+#pragma once
+
+int decode_corpus (int count, char **paths, int jobs, int records);
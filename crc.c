@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "constants.h"
+#include "crc.h"
+
+#define CRC_POLY                0x1021
+
+static uint16_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init (void) {
+    int i, bit, crc;
+
+    for (i = 0; i < 256; i++) {
+        crc = i << 8;
+        for (bit = 0; bit < 8; bit++)
+            crc = crc & 0x8000 ? crc << 1 ^ CRC_POLY : crc << 1;
+        crc_table[i] = crc;
+    }
+}
+
+/* a byte at a time through the table */
+uint16_t spd_crc (const void *data, int count) {
+    const unsigned char *p = data;
+    uint16_t crc = 0;
+
+    pthread_once (&crc_once, crc_init);
+    while (count-- > 0)
+        crc = crc << 8 ^ crc_table[(crc >> 8) ^ *p++];
+    return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * Turn 16 rows of 16 bytes into 16 columns: four rounds of interleaving
+ * row i with row i + 8 amount to a transpose.
+ */
+__attribute__ ((target ("avx2")))
+static void transpose16 (__m128i *rows) {
+    __m128i next[16];
+    int round, i;
+
+    for (round = 0; round < 4; round++) {
+        for (i = 0; i < 8; i++) {
+            next[2 * i] = _mm_unpacklo_epi8 (rows[i], rows[i + 8]);
+            next[2 * i + 1] = _mm_unpackhi_epi8 (rows[i], rows[i + 8]);
+        }
+        memcpy (rows, next, sizeof (next));
+    }
+}
+
+/*
+ * One buffer per 16 bit lane: every 16 bytes of all buffers are loaded
+ * and transposed, so that each column holds the next byte of every
+ * buffer, and then fed through the bitwise CRC in all lanes at once.
+ */
+__attribute__ ((target ("avx2")))
+static void spd_crc_avx2 (const unsigned char *const *data, int n, int count,
+                          uint16_t *crcs) {
+    const __m256i poly = _mm256_set1_epi16 (CRC_POLY);
+    __m256i crc = _mm256_setzero_si256 (), mask;
+    __m128i rows[16];
+    unsigned char tail[16];
+    uint16_t out[16];
+    int i, j, k, bit, chunk;
+
+    for (j = 0; j < count; j += 16) {
+        chunk = count - j < 16 ? count - j : 16;
+        for (i = 0; i < 16; i++) {
+            /* idle lanes repeat the first buffer */
+            const unsigned char *p = data[i < n ? i : 0] + j;
+
+            if (chunk < 16) {
+                memset (tail, 0, sizeof (tail));
+                memcpy (tail, p, chunk);
+                p = tail;
+            }
+            rows[i] = _mm_loadu_si128 ((const __m128i *) p);
+        }
+        transpose16 (rows);
+        for (k = 0; k < chunk; k++) {
+            crc = _mm256_xor_si256 (crc, _mm256_slli_epi16 (_mm256_cvtepu8_epi16 (rows[k]), 8));
+            for (bit = 0; bit < 8; bit++) {
+                mask = _mm256_srai_epi16 (crc, 15);
+                crc = _mm256_xor_si256 (_mm256_slli_epi16 (crc, 1),
+                                        _mm256_and_si256 (mask, poly));
+            }
+        }
+    }
+    _mm256_storeu_si256 ((__m256i *) out, crc);
+    memcpy (crcs, out, n * sizeof (*crcs));
+}
+#endif
+
+void spd_crc_multi (const unsigned char *const *data, int n, int count, uint16_t *crcs) {
+    int i;
+
+#if defined(__x86_64__) || defined(__i386__)
+    static int have_avx2 = -1;
+
+    if (have_avx2 < 0)
+        have_avx2 = __builtin_cpu_supports ("avx2");
+    /* a single buffer is faster through the table */
+    if (have_avx2 && n > 1) {
+        spd_crc_avx2 (data, n, count, crcs);
+        return;
+    }
+#endif
+    for (i = 0; i < n; i++)
+        crcs[i] = spd_crc (data[i], count);
+}
+
+/* a CRC protected range of an image, with the CRC stored little endian at at */
+struct crc_span {
+    int offset;
+    int count;
+    int at;
+};
+
+static int get_crc_spans (const unsigned char *image, int length, struct crc_span *spans) {
+    if (length < 128)
+        return 0;
+    switch (image[2]) {
+    case MEMTYPE_DDR3:
+        /* bit 7 of byte 0 excludes the serial number bytes */
+        spans[0].offset = 0;
+        spans[0].count = (image[0] & 0x80) ? 117 : 126;
+        spans[0].at = 126;
+        return 1;
+    case MEMTYPE_DDR4:
+    case MEMTYPE_DDR4E:
+        if (length < 256)
+            return 0;
+        spans[0].offset = 0;
+        spans[0].count = 126;
+        spans[0].at = 126;
+        spans[1].offset = 128;
+        spans[1].count = 126;
+        spans[1].at = 254;
+        return 2;
+    }
+    return 0;
+}
+
+/* the spans of one length waiting for a full set of lanes */
+struct lanes {
+    int count;
+    int n;
+    const unsigned char *data[CRC_LANES];
+    const unsigned char *crc[CRC_LANES];
+    int image[CRC_LANES];
+};
+
+static void flush_lanes (struct lanes *lanes, int *results) {
+    uint16_t crcs[CRC_LANES];
+    int i;
+
+    spd_crc_multi (lanes->data, lanes->n, lanes->count, crcs);
+    for (i = 0; i < lanes->n; i++)
+        if (crcs[i] != (lanes->crc[i][0] | lanes->crc[i][1] << 8))
+            results[lanes->image[i]] = CRC_FAIL;
+    lanes->n = 0;
+}
+
+void spd_crc_verify (const unsigned char *const *images, const int *lengths, int n,
+                     int *results) {
+    struct lanes lanes[2] = { { 126 }, { 117 } };
+    struct crc_span spans[2];
+    struct lanes *l;
+    int i, s, num_spans;
+
+    for (i = 0; i < n; i++) {
+        num_spans = get_crc_spans (images[i], lengths[i], spans);
+        results[i] = num_spans ? CRC_PASS : CRC_NONE;
+        for (s = 0; s < num_spans; s++) {
+            l = spans[s].count == lanes[0].count ? &lanes[0] : &lanes[1];
+            l->data[l->n] = images[i] + spans[s].offset;
+            l->crc[l->n] = images[i] + spans[s].at;
+            l->image[l->n] = i;
+            if (++l->n == CRC_LANES)
+                flush_lanes (l, results);
+        }
+    }
+    for (i = 0; i < 2; i++)
+        if (lanes[i].n)
+            flush_lanes (&lanes[i], results);
+}
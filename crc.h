@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+/* most buffers spd_crc_multi() works on at once */
+#define CRC_LANES               16
+
+enum {
+    CRC_NONE = 0,               /* no CRC protected SPD */
+    CRC_PASS,
+    CRC_FAIL
+};
+
+/* CRC-16/XMODEM, polynomial 0x1021 and initial value 0, as used by DDR3 and DDR4 */
+uint16_t spd_crc (const void *data, int count);
+/* The CRCs of up to CRC_LANES buffers of count bytes each */
+void spd_crc_multi (const unsigned char *const *data, int n, int count, uint16_t *crcs);
+/* Check every CRC of n images, CRC_* for each in results */
+void spd_crc_verify (const unsigned char *const *images, const int *lengths, int n,
+                     int *results);
@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "i2c-tools-i2c-dev.h"
+#include "gentle.h"
+#include "busstats.h"
+#include "probes.h"
+#include "ddc.h"
+
+/*
+ * Read length bytes starting at offset from the client at address using
+ * a single combined write+read transfer, so no other master can move
+ * the address pointer between the two.
+ */
+int ddc_read (int device, int address, int offset, unsigned char *buffer,
+              int length) {
+    unsigned char start = offset;
+    struct i2c_msg msgs[2] = {
+        { .addr = address, .flags = 0,        .len = 1,      .buf = (char *) &start },
+        { .addr = address, .flags = I2C_M_RD, .len = length, .buf = (char *) buffer }
+    };
+    struct i2c_rdwr_ioctl_data data = { .msgs = msgs, .nmsgs = 2 };
+
+    if (ioctl (device, I2C_RDWR, &data) < 0)
+        return -1;
+    gentle_pace (length + 1);
+    return length;
+}
+
+/*
+ * Read length bytes from offset of a 256 byte E-DDC segment. Segments
+ * other than 0 need the segment pointer at 0x30 written in the same
+ * transfer, as it is reset by the stop condition.
+ */
+static int segment_transfer (int device, int segment, int offset,
+                             unsigned char *buffer, int length) {
+    unsigned char pointer = segment;
+    unsigned char start = offset;
+    struct i2c_msg msgs[3] = {
+        { .addr = DDC_ADDR_SEGMENT, .flags = 0,        .len = 1,      .buf = (char *) &pointer },
+        { .addr = DDC_ADDR_EDID,    .flags = 0,        .len = 1,      .buf = (char *) &start },
+        { .addr = DDC_ADDR_EDID,    .flags = I2C_M_RD, .len = length, .buf = (char *) buffer }
+    };
+    struct i2c_rdwr_ioctl_data data = { .msgs = segment ? msgs : msgs + 1,
+                                        .nmsgs = segment ? 3 : 2 };
+    uint64_t began;
+    int result;
+
+    PROBE3 (read_start, device, segment * EDID_SEGMENT_SIZE + offset, length);
+    began = bus_stats_start ();
+    result = ioctl (device, I2C_RDWR, &data);
+    bus_stats_end (BUS_DDC, began, result < 0, length);
+    PROBE4 (read_done, device, segment * EDID_SEGMENT_SIZE + offset,
+            result < 0 ? -1 : length, result < 0 ? errno : 0);
+    if (result < 0)
+        return -1;
+    gentle_pace (length + (segment ? 2 : 1));
+    return length;
+}
+
+/*
+ * Read (part of) a segment from its start. In gentle mode this takes one
+ * transfer per GENTLE_CHUNK bytes, like read_data(), so that other
+ * masters get the bus in between.
+ */
+int ddc_read_segment (int device, int segment, unsigned char *buffer,
+                      int length) {
+    int offset, chunk = gentle_rate ? GENTLE_CHUNK : length;
+
+    for (offset = 0; offset < length; offset += chunk) {
+        if (chunk > length - offset)
+            chunk = length - offset;
+        if (segment_transfer (device, segment, offset, buffer + offset, chunk) < 0)
+            return -1;
+    }
+    return length;
+}
+
+/*
+ * Read the base block and all extension blocks, up to size bytes, with
+ * one transfer per segment. The first have bytes of buffer were read
+ * before, either none or all of segment 0, which is then not read again.
+ * The first segment is read in full; on 128 byte EEPROMs the second half
+ * just wraps around, so the buffer must hold at least EDID_SEGMENT_SIZE
+ * bytes.
+ */
+int ddc_read_edid (int device, unsigned char *buffer, int have, int size) {
+    int length, segment, chunk;
+
+    if (have < EDID_SEGMENT_SIZE &&
+        ddc_read_segment (device, 0, buffer, EDID_SEGMENT_SIZE) < 0)
+        return errno == ENXIO || errno == EIO || errno == ETIMEDOUT ? 0 : -1;
+
+    length = EDID_BLOCK_SIZE * (buffer[126] + 1);
+    if (length > size)
+        length = size;
+
+    for (segment = 1; segment * EDID_SEGMENT_SIZE < length; segment++) {
+        chunk = length - segment * EDID_SEGMENT_SIZE;
+        if (chunk > EDID_SEGMENT_SIZE)
+            chunk = EDID_SEGMENT_SIZE;
+        if (ddc_read_segment (device, segment,
+                              buffer + segment * EDID_SEGMENT_SIZE, chunk) < 0)
+            return segment * EDID_SEGMENT_SIZE;
+    }
+
+    return length;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#define DDC_ADDR_SEGMENT        0x30
+#define DDC_ADDR_EDID           0x50
+#define EDID_BLOCK_SIZE         128
+#define EDID_SEGMENT_SIZE       256
+/* base block plus the maximum of 255 extension blocks */
+#define EDID_MAX_SIZE           (256 * EDID_BLOCK_SIZE)
+
+int ddc_read (int device, int address, int offset, unsigned char *buffer,
+              int length);
+int ddc_read_segment (int device, int segment, unsigned char *buffer,
+                      int length);
+int ddc_read_edid (int device, unsigned char *buffer, int have, int size);
@@ -4,8 +4,13 @@
 #include "constants.h"
 #include "struct.h"
 #include "output.h"
+#include "probes.h"
+#include "memo.h"
+#include "eeprom.h"
 #include "vendors.h"
+#include "crc.h"
 #include "ddr3.h"
+#include "record.h"
 
 static const char *moduletypenames[] = {
     "Undefined", "RDIMM", "UDIMM", "SO-DIMM",
@@ -82,28 +87,40 @@ static int ddr3_bytestotal (const unsigned char x) {
     }
 }
 
-static int ddr3_crc (const char *data, int count) {
-    int crc, i;
-    crc = 0;
-    while (--count >= 0) {
-        crc = crc ^ (int) *data++ << 8;
-        for (i = 0; i < 8; i++)
-            if (crc & 0x8000)
-                crc = crc << 1 ^ 0x1021;
-            else
-                crc = crc << 1;
-    }
-    return (crc & 0xFFFF);
+/* module size in MB, including the ECC byte lane if there is one */
+static int ddr3_size (const struct ddr3_sdram_spd *eeprom) {
+    int ranks = ((eeprom->organization >> 3) & 7) + 1;
+    int rows = ((eeprom->adressing >> 3) & 7) + 12;
+    int columns = (eeprom->adressing & 7) + 9;
+    int banks = 8 << ((eeprom->density_banks >> 3) & 7);
+    int width = (8 << (eeprom->bus_width & 7)) +
+                (((eeprom->bus_width >> 3) & 3) == 1 ? 8 : 0);
+
+    return ranks * (1 << (rows + columns - 20)) * banks * (width >> 3);
 }
 
-void do_ddr3 (const struct ddr3_sdram_spd *eeprom, int length) {
+static void ddr3_voltage (const struct ddr3_sdram_spd *eeprom, char *linebuf) {
+    linebuf[0] = 0;
+    if (eeprom->voltage & 4)
+        addlist (linebuf, "1.2V");
+    if (eeprom->voltage & 2)
+        addlist (linebuf, "1.35V");
+    if (!(eeprom->voltage & 1))
+        addlist (linebuf, "1.5V");
+}
+
+/* module location, manufacturing date, serial number and CRC */
+static const struct memo_mask ddr3_unit_fields[] = { { 0x77, 9 } };
+
+/* Everything that is the same for all modules of a model */
+static void ddr3_model (const void *data, int length) {
+    const struct ddr3_sdram_spd *eeprom = data;
     int i;
     int rows, columns, banks, ranks;
     int width, size;
     int min_tras;
     double mtb, freq;
     char linebuf[200], linebuf2[256];
-    int checksum;
 
     const int ddr3_frequencies[] =
         { 1500, 1466, 1400, 1333, 1200, 1066, 1000, 933, 900, 800, 667, 533, 400 };
@@ -120,27 +137,6 @@ void do_ddr3 (const struct ddr3_sdram_spd *eeprom, int length) {
         return -1;
     }
 
-    if (length != 256) {
-        printf ("Insufficient data read, aborting decode\n");
-        return;
-    }
-
-    /* SPD information */
-    sprintf (linebuf, "%d.%d", eeprom->spd_revision >> 4,
-             eeprom->spd_revision & 15);
-    if (eeprom->bytes_used_crc & 15 && eeprom->bytes_used_crc & 112) {
-        sprintf (linebuf2, ", %d/%d bytes used",
-                 ddr3_bytesused (eeprom->bytes_used_crc),
-                 ddr3_bytestotal (eeprom->bytes_used_crc));
-        strcat (linebuf, linebuf2);
-    }
-    do_line ("SPD Revision", linebuf);
-    checksum = ddr3_crc ((char *) eeprom,
-                         (eeprom->bytes_used_crc & 128) ? 117 : 126);
-    sprintf (linebuf, "%04X, %scorrect", checksum,
-             checksum == eeprom->crc ? "" : "not ");
-    do_line ("Checksum", linebuf);
-
     /* Vendor information */
     sprintf (linebuf, "%s (%04x)",
              get_vendor16 (eeprom->manufacturer_jedec_id),
@@ -171,7 +167,7 @@ void do_ddr3 (const struct ddr3_sdram_spd *eeprom, int length) {
     banks = 8 << ((eeprom->density_banks >> 3) & 7);
     width = (8 << (eeprom->bus_width & 7)) +
             (((eeprom->bus_width >> 3) & 3) == 1 ? 8 : 0);
-    size = ranks * (1 << (rows + columns - 20)) * banks * (width >> 3);
+    size = ddr3_size (eeprom);
 
     strcpy (linebuf, "DDR3 ");
     if (eeprom->module_type & 15)
@@ -185,13 +181,7 @@ void do_ddr3 (const struct ddr3_sdram_spd *eeprom, int length) {
     do_line ("Part Type", linebuf2);
 
     /* voltage */
-    linebuf[0] = 0;
-    if (eeprom->voltage & 4)
-        addlist (linebuf, "1.2V");
-    if (eeprom->voltage & 2)
-        addlist (linebuf, "1.35V");
-    if (!(eeprom->voltage & 1))
-        addlist (linebuf, "1.5V");
+    ddr3_voltage (eeprom, linebuf);
     do_line ("Voltage", linebuf);
 
     /* organisation */
@@ -224,3 +214,94 @@ void do_ddr3 (const struct ddr3_sdram_spd *eeprom, int length) {
         do_xmp (&eeprom->xmp);
     do_line (NULL, NULL);
 }
+
+void do_ddr3 (const struct ddr3_sdram_spd *eeprom, int length) {
+    char linebuf[200], linebuf2[256];
+    int checksum;
+
+    PROBE2 (do_ddr3_entry, eeprom, length);
+    if (length != 256) {
+        do_printf ("Insufficient data read, aborting decode\n");
+        PROBE2 (do_ddr3_return, eeprom, 0);
+        return;
+    }
+
+    /* SPD information */
+    sprintf (linebuf, "%d.%d", eeprom->spd_revision >> 4,
+             eeprom->spd_revision & 15);
+    if (eeprom->bytes_used_crc & 15 && eeprom->bytes_used_crc & 112) {
+        sprintf (linebuf2, ", %d/%d bytes used",
+                 ddr3_bytesused (eeprom->bytes_used_crc),
+                 ddr3_bytestotal (eeprom->bytes_used_crc));
+        strcat (linebuf, linebuf2);
+    }
+    do_line ("SPD Revision", linebuf);
+    checksum = spd_crc (eeprom,
+                        (eeprom->bytes_used_crc & 128) ? 117 : 126);
+    sprintf (linebuf, "%04X, %scorrect", checksum,
+             checksum == eeprom->crc ? "" : "not ");
+    do_line ("Checksum", linebuf);
+
+    memo_decode (eeprom, length, ddr3_unit_fields,
+                 sizeof (ddr3_unit_fields) / sizeof (ddr3_unit_fields[0]),
+                 ddr3_model);
+    PROBE2 (do_ddr3_return, eeprom, 1);
+}
+
+int get_ddr3_info (const struct ddr3_sdram_spd *eeprom, int length,
+                   struct module_info *info) {
+    if (length != 256)
+        return -1;
+
+    info->vendor = eeprom->manufacturer_jedec_id;
+    if (ddr3_bytesused (eeprom->bytes_used_crc) > 128) {
+        info->dram_vendor = eeprom->dram_manufacturer_jedec_id;
+        get_part_number (info->part, eeprom->part_number,
+                         sizeof (eeprom->part_number));
+    }
+    info->ranks = ((eeprom->organization >> 3) & 7) + 1;
+    info->device_width = 4 << (eeprom->organization & 7);
+    info->ecc = ((eeprom->bus_width >> 3) & 3) == 1;
+    info->size = info->ecc ? ddr3_size (eeprom) * 8 / 9 : ddr3_size (eeprom);
+    ddr3_voltage (eeprom, info->voltage);
+    info->module_type = eeprom->module_type & 15;
+    /* in medium timebase units, as decoded by do_ddr3() */
+    if (eeprom->mtb_divisor) {
+        info->tck = eeprom->min_tck * 1000 * eeprom->mtb_dividend / eeprom->mtb_divisor;
+        info->taa = eeprom->min_taa * 1000 * eeprom->mtb_dividend / eeprom->mtb_divisor;
+    }
+    return 0;
+}
+
+struct decoded_record *get_ddr3_record (const struct ddr3_sdram_spd *eeprom, int length,
+                                       struct arena *arena) {
+    struct decoded_record *record;
+    struct ddr3_record *ddr3;
+    int i, mtb;
+
+    if (!(record = new_spd_record (RECORD_DDR3, (const unsigned char *) eeprom,
+                                   length, arena)))
+        return NULL;
+    ddr3 = &record->ddr3;
+    ddr3->spd.serial = eeprom->serial_number;
+    set_spd_date (&ddr3->spd, eeprom->manufacturing_date);
+
+    ddr3->banks = 8 << ((eeprom->density_banks >> 3) & 7);
+    ddr3->rows = ((eeprom->adressing >> 3) & 7) + 12;
+    ddr3->columns = (eeprom->adressing & 7) + 9;
+    for (i = 0; i < 15; i++)
+        if (eeprom->cas_latency & (1 << i))
+            ddr3->spd.cas_latencies |= 1ull << (i + 4);
+
+    /* tck and taa are set by get_ddr3_info() */
+    if (eeprom->mtb_divisor) {
+        mtb = 1000 * eeprom->mtb_dividend / eeprom->mtb_divisor;
+        ddr3->spd.trcd = mtb * eeprom->min_trcd;
+        ddr3->spd.trp = mtb * eeprom->min_trp;
+        ddr3->spd.tras = mtb * (eeprom->min_tras_lsb +
+                                ((eeprom->min_tras_trc_upper_nibble & 15) << 8));
+        ddr3->spd.trc = mtb * (eeprom->min_trc_lsb +
+                               ((eeprom->min_tras_trc_upper_nibble >> 4) << 8));
+    }
+    return record;
+}
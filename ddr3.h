@@ -2,4 +2,12 @@
 
 #include "struct.h"
 
+struct module_info;
+struct decoded_record;
+struct arena;
+
 void do_ddr3 (const struct ddr3_sdram_spd *eeprom, int length);
+int get_ddr3_info (const struct ddr3_sdram_spd *eeprom, int length,
+                   struct module_info *info);
+struct decoded_record *get_ddr3_record (const struct ddr3_sdram_spd *eeprom, int length,
+                                       struct arena *arena);
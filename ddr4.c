@@ -4,7 +4,13 @@
 #include "constants.h"
 #include "struct.h"
 #include "output.h"
+#include "probes.h"
+#include "memo.h"
+#include "eeprom.h"
 #include "vendors.h"
+#include "crc.h"
+#include "arena.h"
+#include "record.h"
 #include "ddr4.h"
 
 static const char *moduletypenames[] = {
@@ -63,7 +69,7 @@ int get_ddr4_secondary_density (char density, char ratio) {
 const char * get_ddr4_package (char package) {
     unsigned char loading = package & 3;
     unsigned char diecount = (package >> 4) & 7;
-    static char retval[40];
+    static __thread char retval[40];
     switch (loading) {
     case 0: if (package & 128) return "Unspecified Non-Monolithic Device";
             else return "SDP (Single Die Package)";
@@ -110,20 +116,6 @@ static int ddr4_bytestotal (const unsigned char x) {
     }
 }
 
-static int ddr4_crc (const char *data, int count) {
-    int crc, i;
-    crc = 0;
-    while (--count >= 0) {
-        crc = crc ^ (int) *data++ << 8;
-        for (i = 0; i < 8; i++)
-            if (crc & 0x8000)
-                crc = crc << 1 ^ 0x1021;
-           else
-                crc = crc << 1;
-    }
-    return (crc & 0xFFFF);
-}
-
 int get_ddr4_memreq (const struct ddr4_sdram_spd *eeprom, int length) {
     if (length == 0)
         return -1;
@@ -135,7 +127,7 @@ static int ps_to_clocks (const int minimum, const int period) {
 }
 
 static const char * get_thickness (int value) {
-    static char buffer [16];
+    static __thread char buffer [16];
     switch (value) {
     case 0: return ("<= 1mm");
     case 15: return ("> 15mm");
@@ -146,8 +138,31 @@ static const char * get_thickness (int value) {
     return buffer;
 }
 
-void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
+/* module size in MB, including the ECC byte lane if there is one */
+static int ddr4_size (const struct ddr4_sdram_spd *eeprom) {
+    int ranks = ((eeprom->organization >> 3) & 7) + 1;
+    int rows = ((eeprom->adressing >> 3) & 7) + 12;
+    int columns = (eeprom->adressing & 7) + 9;
+    int bankgroups = 1 << ((eeprom->density_banks >> 6) & 3);
+    int banks = 4 << ((eeprom->density_banks >> 4) & 3);
+    int width = (8 << (eeprom->bus_width & 7)) + (((eeprom->bus_width >> 3) & 3) == 1 ? 8 : 0);
+
+    return ranks * (1 << (rows + columns - 20)) * bankgroups * banks * (width >> 3);
+}
+
+static void ddr4_voltage (const struct ddr4_sdram_spd *eeprom, char *linebuf) {
+    linebuf[0] = 0;
+    if (eeprom->voltage & 1) addlist (linebuf, "1.2V operable");
+    if (eeprom->voltage & 2) addlist (linebuf, "1.2V endurant");
+    if (eeprom->voltage & 0xfc) addlist (linebuf, "(Unknown)");
+}
 
+/* module location, manufacturing date and serial number, and the CRC */
+static const struct memo_mask ddr4_unit_fields[] = { { 0x7e, 2 }, { 0x142, 7 } };
+
+/* Everything that is the same for all modules of a model */
+static void ddr4_model (const void *data, int length) {
+    const struct ddr4_sdram_spd *eeprom = data;
     int i;
     int bankgroups, banks, ranks, rows, columns;
     int width, size;
@@ -155,7 +170,7 @@ void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
 
     char linebuf[200], linebuf2[256];
     int bytes_used = 0;
-    int checksum, checksum2;
+    int checksum2;
 
     const int ddr4_frequencies[] = { 1600, 1466, 1333, 1200, 1066, 933, 667 };
     const int ddr4_periods[] = {  625, /* 1600MHz = 625ps */
@@ -168,24 +183,8 @@ void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
     };
     const int num_ddr4_frequencies = sizeof (ddr4_frequencies) / sizeof (ddr4_frequencies[0]);
 
-    if (length < 256) {
-        printf ("Insufficient data read, aborting decode\n");
-        return;
-    }
-    /* SPD information */
-    sprintf (linebuf, "%d.%d", eeprom->spd_revision >> 4,
-             eeprom->spd_revision & 15);
-    if (eeprom->bytes_used_crc & 15 && eeprom->bytes_used_crc & 112) {
+    if (eeprom->bytes_used_crc & 15 && eeprom->bytes_used_crc & 112)
         bytes_used = ddr4_bytesused (eeprom->bytes_used_crc);
-        sprintf (linebuf2, ", %d/%d bytes used",
-                 bytes_used, ddr4_bytestotal (eeprom->bytes_used_crc));
-        strcat (linebuf, linebuf2);
-    }
-    do_line ("SPD Revision:", linebuf);
-    checksum = ddr4_crc ((char *) eeprom, 126);
-    sprintf (linebuf, "%04X, %scorrect", checksum,
-             checksum == eeprom->crc ? "" : "not ");
-    do_line ("Checksum", linebuf);
 
     /* Vendor information */
     if (bytes_used > 256) {
@@ -204,7 +203,7 @@ void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
             linebuf[20] = 0;
             do_line ("Part Number", linebuf);
         } else {
-            printf ("Vendor information not available, insufficient data read\n");
+            do_printf ("Vendor information not available, insufficient data read\n");
         }
     }
 
@@ -215,7 +214,7 @@ void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
     bankgroups = 1 << ((eeprom->density_banks >> 6) & 3);
     banks = 4 << ((eeprom->density_banks >> 4) & 3);
     width = (8 << (eeprom->bus_width & 7)) + (((eeprom->bus_width >> 3) & 3) == 1 ? 8 : 0);
-    size  = ranks * (1 << (rows + columns - 20)) * bankgroups * banks * (width >> 3);
+    size  = ddr4_size (eeprom);
 
     strcpy (linebuf, "DDR4 ");
     if (eeprom->module_type & 15)
@@ -235,7 +234,7 @@ void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
     case DDR4MODULETYPE_72B_SO_UDIMM:
     case DDR4MODULETYPE_16B_SO_DIMM:
     case DDR4MODULETYPE_32B_SO_DIMM:
-        checksum2 = ddr4_crc ((char *) eeprom->module_specific, 126);
+        checksum2 = spd_crc (eeprom->module_specific, 126);
         sprintf (linebuf, "%04X, %scorrect", checksum2,
                  checksum2 == eeprom->ext_ub.crc ? "" : "not ");
         do_line ("Extension Checksum", linebuf);
@@ -260,10 +259,7 @@ void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
     }
 
     /* voltage */
-    linebuf[0] = 0;
-    if (eeprom->voltage & 1) addlist (linebuf, "1.2V operable");
-    if (eeprom->voltage & 2) addlist (linebuf, "1.2V endurant");
-    if (eeprom->voltage & 0xfc) addlist (linebuf, "(Unknown)");
+    ddr4_voltage (eeprom, linebuf);
     do_line ("Voltage", linebuf);
 
     /* organisation */
@@ -296,7 +292,7 @@ void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
 
     /* primary timings */
     if (eeprom->timebases) {
-        printf ("Unknown timebases, not calculating timing information");
+        do_printf ("Unknown timebases, not calculating timing information");
         return;
     }
     mtb = 125; /* in ps */
@@ -351,3 +347,103 @@ void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
 
     do_line (NULL, NULL);
 }
+
+void do_ddr4 (const struct ddr4_sdram_spd *eeprom, int length) {
+    char linebuf[200], linebuf2[256];
+    int checksum;
+
+    PROBE2 (do_ddr4_entry, eeprom, length);
+    if (length < 256) {
+        do_printf ("Insufficient data read, aborting decode\n");
+        PROBE2 (do_ddr4_return, eeprom, 0);
+        return;
+    }
+    /* SPD information */
+    sprintf (linebuf, "%d.%d", eeprom->spd_revision >> 4,
+             eeprom->spd_revision & 15);
+    if (eeprom->bytes_used_crc & 15 && eeprom->bytes_used_crc & 112) {
+        sprintf (linebuf2, ", %d/%d bytes used",
+                 ddr4_bytesused (eeprom->bytes_used_crc),
+                 ddr4_bytestotal (eeprom->bytes_used_crc));
+        strcat (linebuf, linebuf2);
+    }
+    do_line ("SPD Revision:", linebuf);
+    checksum = spd_crc (eeprom, 126);
+    sprintf (linebuf, "%04X, %scorrect", checksum,
+             checksum == eeprom->crc ? "" : "not ");
+    do_line ("Checksum", linebuf);
+
+    memo_decode (eeprom, length, ddr4_unit_fields,
+                 sizeof (ddr4_unit_fields) / sizeof (ddr4_unit_fields[0]),
+                 ddr4_model);
+    PROBE2 (do_ddr4_return, eeprom, 1);
+}
+
+int get_ddr4_info (const struct ddr4_sdram_spd * eeprom, int length,
+                   struct module_info * info) {
+    if (length < 256)
+        return -1;
+
+    if (length >= 384 && ddr4_bytesused (eeprom->bytes_used_crc) > 256) {
+        info->vendor = eeprom->manufacturer_jedec_id;
+        info->dram_vendor = eeprom->dram_manufacturer_jedec_id;
+        get_part_number (info->part, eeprom->part_number,
+                         sizeof (eeprom->part_number));
+    }
+    info->ranks = ((eeprom->organization >> 3) & 7) + 1;
+    info->device_width = 4 << (eeprom->organization & 7);
+    info->ecc = ((eeprom->bus_width >> 3) & 3) == 1;
+    info->size = info->ecc ? ddr4_size (eeprom) * 8 / 9 : ddr4_size (eeprom);
+    ddr4_voltage (eeprom, info->voltage);
+    info->module_type = eeprom->module_type & 15;
+    info->bank_groups = 1 << ((eeprom->density_banks >> 6) & 3);
+    /* medium timebase of 125ps, fine timebase of 1ps */
+    info->tck = 125 * eeprom->min_tckavg + eeprom->fine_min_tckavg;
+    info->taa = 125 * eeprom->min_taa + eeprom->fine_min_taa;
+    return 0;
+}
+
+struct decoded_record *get_ddr4_record (const struct ddr4_sdram_spd * eeprom, int length,
+                                       struct arena * arena) {
+    struct decoded_record *record;
+    struct ddr4_record *ddr4;
+    uint32_t cas;
+    int i, base;
+
+    if (!(record = new_spd_record (RECORD_DDR4, (const unsigned char *) eeprom,
+                                   length, arena)))
+        return NULL;
+    ddr4 = &record->ddr4;
+    if (length >= 384 && ddr4_bytesused (eeprom->bytes_used_crc) > 256) {
+        ddr4->spd.serial = eeprom->serial_number;
+        set_spd_date (&ddr4->spd, eeprom->manufacturing_date);
+    }
+
+    ddr4->bank_groups = 1 << ((eeprom->density_banks >> 6) & 3);
+    ddr4->banks = 4 << ((eeprom->density_banks >> 4) & 3);
+    ddr4->rows = ((eeprom->adressing >> 3) & 7) + 12;
+    ddr4->columns = (eeprom->adressing & 7) + 9;
+    ddr4->density = get_ddr4_density (eeprom->density_banks);
+    ddr4->package = arena_strndup (arena, get_ddr4_package (eeprom->primary_package), 40);
+    if (!ddr4->package)
+        return NULL;
+
+    /* bit 7 of the last byte moves the range from CL7-36 to CL23-52 */
+    cas = eeprom->cas_latencies[0] | eeprom->cas_latencies[1] << 8 |
+          eeprom->cas_latencies[2] << 16 | (uint32_t) eeprom->cas_latencies[3] << 24;
+    base = cas & 0x80000000 ? 23 : 7;
+    for (i = 0; i < 30; i++)
+        if (cas & (1u << i))
+            ddr4->spd.cas_latencies |= 1ull << (base + i);
+
+    if (eeprom->timebases) {
+        ddr4->spd.tck = ddr4->spd.taa = 0;
+        return record;
+    }
+    ddr4->spd.trcd = 125 * eeprom->min_trcd + eeprom->fine_min_trcd;
+    ddr4->spd.trp = 125 * eeprom->min_trp + eeprom->fine_min_trp;
+    ddr4->spd.tras = 125 * (((eeprom->min_tras_trc_upper & 15) << 8) + eeprom->min_tras_lower);
+    ddr4->spd.trc = 125 * (((eeprom->min_tras_trc_upper >> 4) << 8) + eeprom->min_trc_lower) +
+                    eeprom->fine_min_trc;
+    return record;
+}
@@ -2,5 +2,13 @@
 
 #include "struct.h"
 
+struct module_info;
+struct decoded_record;
+struct arena;
+
 int get_ddr4_memreq (const struct ddr4_sdram_spd * eeprom, int length);
 void do_ddr4 (const struct ddr4_sdram_spd * eeprom, int length);
+int get_ddr4_info (const struct ddr4_sdram_spd * eeprom, int length,
+                   struct module_info * info);
+struct decoded_record *get_ddr4_record (const struct ddr4_sdram_spd * eeprom, int length,
+                                       struct arena * arena);
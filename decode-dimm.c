@@ -9,6 +9,7 @@
 #include <dirent.h>
 #include <math.h>
 #include <fcntl.h>
+#include <getopt.h>
 
 #include "vendors.h"
 #include "constants.h"
@@ -18,6 +19,29 @@
 #include "ddr3.h"
 #include "ddr4.h"
 #include "eedid.h"
+#include "eeprom.h"
+#include "decode-dimm.h"
+#include "dpaux.h"
+#include "ddc.h"
+#include "drm.h"
+#include "pipeline.h"
+#include "files.h"
+#include "corpus.h"
+#include "container.h"
+#include "spdindex.h"
+#include "edidindex.h"
+#include "diff.h"
+#include "serialindex.h"
+#include "carve.h"
+#include "verify.h"
+#include "columns.h"
+#include "aggregate.h"
+#include "store.h"
+#include "gentle.h"
+#include "busstats.h"
+#include "trace.h"
+#include "output.h"
+#include "probes.h"
 
 char *get_i2c_bus_name (const char *id) {
     char bus[256];
@@ -42,74 +66,33 @@ char *get_i2c_bus_name (const char *id) {
     return strdup (busname);
 }
 
-int get_eeprom_memreq (const unsigned char *eeprom, int length) {
-    switch (eeprom[2]) {
-    case MEMTYPE_SDR:
-    case MEMTYPE_DDR:
-    case MEMTYPE_DDR2:
-    case MEMTYPE_DDR3:
-        return 256;
-    case MEMTYPE_DDR4:
-    case MEMTYPE_DDR4E:
-        return get_ddr4_memreq ((struct ddr4_sdram_spd *) eeprom, length);
-    case 0xff:
-        if (eeprom[0] == 0x00 && eeprom[1] == 0xff && eeprom[2] == 0xff &&
-            eeprom[3] == 0xff && eeprom[4] == 0xff && eeprom[5] == 0xff &&
-            eeprom[6] == 0xff && eeprom[7] == 0x00)
-            return get_eedid_memreq ((struct eedid_t *) eeprom, length);
-    default:
-        return -1;
-    }
-    return 0;
-}
-
-int do_eeprom (int device, const unsigned char *eeprom, int length) {
-    printf ("Analyzing client 0x%02x\n", device);
-    switch (eeprom[2]) {
-    case MEMTYPE_SDR:
-    case MEMTYPE_DDR:
-    case MEMTYPE_DDR2:
-        do_sdram ((struct sdram_spd *) eeprom, length);
-        break;
-    case MEMTYPE_DDR3:
-        do_ddr3 ((struct ddr3_sdram_spd *) eeprom, length);
-        break;
-    case MEMTYPE_DDR4:
-    case MEMTYPE_DDR4E:
-        do_ddr4 ((struct ddr4_sdram_spd *) eeprom, length);
-        break;
-    case 0xff:
-        if (eeprom[0] == 0x00 && eeprom[1] == 0xff && eeprom[2] == 0xff &&
-            eeprom[3] == 0xff && eeprom[4] == 0xff && eeprom[5] == 0xff &&
-            eeprom[6] == 0xff && eeprom[7] == 0x00)
-            do_eedid ((struct eedid_t *) eeprom, length);
-        break;
-    default:
-        printf ("Unsupported memory type %d\n", eeprom[2]);
-        return -1;
-    }
-    return 0;
-}
-
-
 int read_data_ioctl (int device, int features, unsigned char * buffer) {
     int has_word = features & I2C_FUNC_SMBUS_READ_WORD_DATA;
     int address, retry, result;
     int bytes_read = 0;
     int increment = has_word ? 2 : 1;
+    uint64_t start;
 
     for (address = 0; address < 256; address += increment) {
         retry = 0;
         do {
-            retry++;
+            if (retry++)
+                bus_stats_retry (BUS_SMBUS);
+            PROBE3 (read_start, device, address, increment);
+            start = bus_stats_start ();
             if (has_word)
                 result = i2c_smbus_read_word_data (device, address);
             else
                 result = i2c_smbus_read_byte_data (device, address);
+            bus_stats_end (BUS_SMBUS, start, result < 0, increment);
+            PROBE4 (read_done, device, address, result < 0 ? -1 : increment,
+                    result < 0 ? errno : 0);
+            gentle_pace (increment + 1);
         } while (result < 0 && retry < 5);
         if (result < 0) {
 	    if (errno != ENXIO)
-	        printf ("result: %d %s\n", errno, strerror (errno));
+	        fprintf (stderr, "Failed to read from device at 0x%02x: %s\n", address,
+	                 strerror (errno));
             break;
         }
         buffer[address] = result & 0xff;
@@ -122,132 +105,224 @@ int read_data_ioctl (int device, int features, unsigned char * buffer) {
 }
 
 int read_data (int device, int features, unsigned char * buffer) {
-    int result;
-    unsigned char address = 0;
-
-    result = write (device, &address, 1);
-    if (result < 0) {
-        if (errno == EOPNOTSUPP)
-            return read_data_ioctl (device, features, buffer);
-	if (errno == EIO)
-   	    return 0;
-        fprintf (stderr, "Failed to reset address: %d %s\n", errno, strerror (errno));
-        return 0;
-    }
-    result = read (device, buffer, 256);
-    if (result < 0) {
-        if (errno == EOPNOTSUPP)
-            return read_data_ioctl (device, features, buffer);
-	if (errno == EIO)
-   	    return 0;
-        fprintf (stderr, "Failed to read from device: %s\n", strerror (errno));
-        return 0;
+    int result, offset;
+    int chunk = gentle_rate ? GENTLE_CHUNK : 256;
+    unsigned char address;
+    uint64_t start;
+
+    /* in gentle mode, re-address every chunk since other masters may
+       have moved the eeprom's address pointer in between */
+    for (offset = 0; offset < 256; offset += result) {
+        address = offset;
+        start = bus_stats_start ();
+        result = write (device, &address, 1);
+        bus_stats_end (BUS_ADDRESS, start, result < 0, 1);
+        if (result < 0) {
+            if (errno == EOPNOTSUPP)
+                return read_data_ioctl (device, features, buffer);
+            if (errno == EIO)
+                return 0;
+            fprintf (stderr, "Failed to reset address: %d %s\n", errno, strerror (errno));
+            return 0;
+        }
+        PROBE3 (read_start, device, offset, chunk);
+        start = bus_stats_start ();
+        result = read (device, buffer + offset, chunk);
+        bus_stats_end (BUS_READ, start, result < 0, result);
+        PROBE4 (read_done, device, offset, result, result < 0 ? errno : 0);
+        if (result < 0) {
+            if (errno == EOPNOTSUPP)
+                return read_data_ioctl (device, features, buffer);
+            if (errno == EIO)
+                return 0;
+            fprintf (stderr, "Failed to read from device: %s\n", strerror (errno));
+            return 0;
+        }
+        gentle_pace (result + 1);
+        if (result < chunk) {
+            offset += result;
+            break;
+        }
     }
-    return result;
+    return offset;
 }
 
 int set_ee1004_bank (int device, int bank, int client) {
     union i2c_smbus_data data;
     int result;
     int SPA = bank ? EE1004_SPA1 : EE1004_SPA0;
+    uint64_t begin = trace_begin ();
+    uint64_t start = bus_stats_start ();
 
+    PROBE2 (page_switch_start, device, bank);
     if (ioctl (device, I2C_SLAVE_FORCE, SPA)) {
+        bus_stats_end (BUS_BANK, start, 1, 0);
+        PROBE4 (page_switch_done, device, bank, -1, errno);
         fprintf (stderr, "Can't select client 0x%02x: %s\n", SPA, strerror (errno));
         return -1;
     }
 
     data.byte = 0;
     result = i2c_smbus_access (device, I2C_SMBUS_WRITE, 0, I2C_SMBUS_BYTE, &data);
+    bus_stats_end (BUS_BANK, start, result < 0, 0);
+    gentle_pace (1);
     if (!result && client >= 0) {
+        start = bus_stats_start ();
         result = ioctl (device, I2C_SLAVE_FORCE, client);
+        bus_stats_end (BUS_SELECT, start, result, 0);
+        PROBE3 (client_select, device, client, result ? errno : 0);
         if (result) {
             fprintf (stderr, "Can't select client 0x%02x: %s\n", client, strerror (errno));
         }
     }
+    PROBE4 (page_switch_done, device, bank, result, result ? errno : 0);
 
+    trace_span (begin, "bus", "page switch", "\"bank\":%d,\"result\":%d", bank, result);
     return result;
 }
 
+static int decode_client (void *arg, int client, const unsigned char *eeprom,
+                          int length, const char *note) {
+    if (note)
+        printf ("%s\n", note);
+    return do_eeprom (client, eeprom, length) == 0;
+}
+
 int scan_adapter (const char *adapter) {
+    return read_adapter (adapter, decode_client, NULL);
+}
+
+int read_adapter (const char *adapter, eeprom_handler handler, void *arg) {
     char dev_name[512];
     struct stat statbuf;
     int result, features;
-    int device, client;
-    unsigned char eeprom[512];
+    int device = -1, client;
+    unsigned char eeprom[EDID_MAX_SIZE];
     int count = 0;
     int required;
     int bytes_read;
+    uint64_t start, begin, scan = trace_begin (), client_begin;
+    char note[SCAN_NOTE_SIZE], escaped[256];
 
     snprintf (dev_name, 256, "/dev/%s", adapter);
     if ((result = stat (dev_name, &statbuf))) {
         fprintf (stderr, "Can't stat() %s: %s\n", dev_name, strerror (errno));
-        return -1;
+        count = -1;
+        goto out;
     }
     if (!S_ISCHR (statbuf.st_mode)) {
         fprintf (stderr, "%s is not a character device.\n", dev_name);
-        return -1;
+        count = -1;
+        goto out;
     }
 
+    bus_stats_adapter (adapter);
+    begin = trace_begin ();
+    start = bus_stats_start ();
     device = open (dev_name, O_RDWR);
     if (device < 0) {
+        bus_stats_end (BUS_OPEN, start, 1, 0);
+        PROBE4 (adapter_open, adapter, -1, 0, errno);
         fprintf (stderr, "Can't open %s: %s\n", dev_name, strerror (errno));
-        return -1;
+        count = -1;
+        goto out;
     }
 
-    if (ioctl (device, I2C_FUNCS, &features)) {
+    result = ioctl (device, I2C_FUNCS, &features);
+    bus_stats_end (BUS_OPEN, start, result, 0);
+    PROBE4 (adapter_open, adapter, device, result ? 0 : features, result ? errno : 0);
+    trace_span (begin, "bus", "open", "\"adapter\":\"%s\",\"features\":\"0x%08x\"",
+                json_escape (escaped, sizeof (escaped), adapter), result ? 0 : features);
+    if (result) {
         fprintf (stderr, "Can't retrieve features: %s\n", strerror (errno));
-        return -1;
+        count = -1;
+        goto out;
     }
 
     if (!(features & (I2C_FUNC_SMBUS_READ_BYTE_DATA | I2C_FUNC_SMBUS_READ_WORD_DATA))) {
         fprintf (stderr, "Doesn't support byte or word read\n");
-        return -1;
+        count = -1;
+        goto out;
     }
 
     if ((features & I2C_FUNC_SMBUS_PEC) && ioctl (device, I2C_PEC, 0)) {
         fprintf (stderr, "Can't disable PEC: %s\n", strerror (errno));
-        return -1;
+        count = -1;
+        goto out;
     }
 
     if ((features & I2C_FUNC_10BIT_ADDR) && ioctl (device, I2C_TENBIT, 0)) {
         fprintf (stderr, "Can't disable tenbit: %s\n", strerror (errno));
-        return -1;
+        count = -1;
+        goto out;
     }
 
     for (client = 0x50; client < 0x58; client++) {
-        if (ioctl (device, I2C_SLAVE_FORCE, client)) {
+        client_begin = begin = trace_begin ();
+        start = bus_stats_start ();
+        result = ioctl (device, I2C_SLAVE_FORCE, client);
+        bus_stats_end (BUS_SELECT, start, result, 0);
+        PROBE3 (client_select, device, client, result ? errno : 0);
+        trace_span (begin, "bus", "select", "\"client\":\"0x%02x\"", client);
+        if (result) {
             fprintf (stderr, "Can't select client 0x%02x: %s\n", client,
                      strerror (errno));
             continue;
         }
+        begin = trace_begin ();
         bytes_read = read_data (device, features, eeprom);
+        trace_span (begin, "bus", "read", "\"client\":\"0x%02x\",\"bytes\":%d",
+                    client, bytes_read);
         if (bytes_read > 0) {
+            note[0] = 0;
             required = get_eeprom_memreq (eeprom, bytes_read);
-            if (bytes_read == 256 && required > 256) {
+            if (bytes_read == 256 && required > 256 && is_eedid (eeprom)) {
+                if (features & I2C_FUNC_I2C) {
+                    begin = trace_begin ();
+                    result = ddc_read_edid (device, eeprom, bytes_read, sizeof (eeprom));
+                    trace_span (begin, "bus", "e-ddc read", "\"bytes\":%d", result);
+                    if (result > bytes_read)
+                        bytes_read = result;
+                } else
+                    snprintf (note, sizeof (note),
+                              "Adapter can't read E-DDC segments, decoding %d of %d bytes",
+                              bytes_read, required);
+            } else if (bytes_read == 256 && required > 256) {
                 set_ee1004_bank (device, 1, client);
+                begin = trace_begin ();
                 result = read_data (device, features, eeprom + 256);
+                trace_span (begin, "bus", "read", "\"client\":\"0x%02x\",\"bank\":1,"
+                            "\"bytes\":%d", client, result);
                 set_ee1004_bank (device, 0, client);
                 if (result == 256) {
                     if (memcmp (eeprom, eeprom + 256, 256))
                         bytes_read += 256;
                 }
             }
-            result = do_eeprom (client, eeprom, bytes_read);
-            if (result == 0)
-                count++;
+            collect_image (SOURCE_I2C, adapter, client, eeprom, bytes_read);
+            count += handler (arg, client, eeprom, bytes_read, note[0] ? note : NULL);
         }
+        trace_span (client_begin, "client", bytes_read > 0 ? "present" : "absent",
+                    "\"client\":\"0x%02x\",\"bytes\":%d", client, bytes_read);
+        gentle_yield ();
     }
-    close (device);
+
+out:
+    if (device >= 0)
+        close (device);
+    bus_stats_adapter (NULL);
+    trace_span (scan, "adapter", adapter, count < 0 ? "\"failed\":true" : NULL);
     return count;
 }
 
-int foreach_i2c_adapter (int all) {
+int list_i2c_adapters (int all, adapter_handler handler, void *arg) {
     struct stat statbuf;
     int result;
     DIR *sysfsdir;
     struct dirent *i2cadapter;
     int count = 0;
-    char *name;
+    char *name, escaped[256];
+    uint64_t begin, list = trace_begin ();
 
     if ((result = stat ("/sys/class/i2c-dev", &statbuf))) {
         fprintf (stderr, "Can't stat() /sys/class/i2c-dev: %s\n",
@@ -267,20 +342,280 @@ int foreach_i2c_adapter (int all) {
 
     while ((i2cadapter = readdir (sysfsdir)))
         if (i2cadapter->d_name[0] != '.') {
+            begin = trace_begin ();
             name = get_i2c_bus_name (strchr (i2cadapter->d_name, '-') + 1);
+            trace_span (begin, "sysfs", "bus name", "\"adapter\":\"%s\"",
+                        json_escape (escaped, sizeof (escaped), i2cadapter->d_name));
             if (all == 1 || (!strncasecmp (name, "smbus", 5) && all == 0)) {
-                printf ("Testing %s (%s)\n", i2cadapter->d_name, name);
-                count += scan_adapter (i2cadapter->d_name);
+                count += handler (arg, i2cadapter->d_name, name);
             }
 
             free (name);
         }
     closedir (sysfsdir);
+    trace_span (list, "sysfs", "list adapters", "\"count\":%d", count);
     return count;
 }
 
-int main () {
-    foreach_i2c_adapter (1);
+static int test_adapter (void *arg, const char *adapter, const char *name) {
+    printf ("Testing %s (%s)\n", adapter, name);
+    return scan_adapter (adapter);
+}
+
+int foreach_i2c_adapter (int all) {
+    return list_i2c_adapters (all, test_adapter, NULL);
+}
+
+static void usage (const char *name) {
+    printf ("Usage: %s [options] [FILE|DIRECTORY]...\n"
+            "Decodes the eeproms found on the system's buses, or the raw images\n"
+            "in the given files and directories.\n"
+            "  -g, --gentle[=RATE]  pace bus transfers to RATE bytes/ms (default %d),\n"
+            "                       run at idle CPU and I/O priority\n"
+            "  -d, --drm            decode the EDIDs cached by the kernel's DRM connectors\n"
+            "  -P, --pipeline       read all adapters in parallel while decoding\n"
+            "  -p, --dp-aux         read EDIDs through DisplayPort AUX channels\n"
+            "  -j, --jobs=N         decode files with N threads, 0 for one per CPU\n"
+            "  -J, --json           decode the given files into records, printed as one\n"
+            "                       line of JSON per image\n"
+            "  -o, --output=FILE    also store all images read in container FILE\n"
+            "  -z, --delta          store images of a model already in the container as\n"
+            "                       deltas against the first one\n"
+            "  -s, --store=DIR      also record all images read in image store DIR,\n"
+            "                       keeping every distinct image once\n"
+            "  -I, --build-index    write secondary, display model and serial number\n"
+            "                       indexes for the given containers\n"
+            "  -q, --query=F=V[..V] decode the records of the given indexed containers\n"
+            "                       matching all queries, fields are type, vendor,\n"
+            "                       dram_vendor, part (prefix), serial and date (YYYY-WW);\n"
+            "                       vendors by name or JEDEC id in hex, either as the SPD\n"
+            "                       bytes read (80CE) or as printed (CE80)\n"
+            "  -m, --monitors=CAPS  list the display models of the given indexed containers\n"
+            "                       with all of CAPS, e.g. 3840x2160@60,hdmi; also dp, dvi,\n"
+            "                       digital, analog, tmds=MHZ, vendor=PNP, product=N\n"
+            "  -S, --serial=[V:]SER list where serial number SER, optionally of vendor V,\n"
+            "                       was seen in the given indexed containers\n"
+            "  -a, --aggregate=KEYS count the modules in the given files and their\n"
+            "                       capacity grouped by KEYS, any of vendor, dram_vendor,\n"
+            "                       part, type, organisation, voltage and size\n"
+            "  -F, --filter=F=V,..  count the modules in the given files and their\n"
+            "                       capacity matching all of F, comma separated, out of\n"
+            "                       type, module_type, size (MB or G), ranks, bank_groups,\n"
+            "                       width, ecc, tck and taa (ps), vendor, dram_vendor and\n"
+            "                       part; may be given repeatedly\n"
+            "  -C, --carve          search the given files for embedded EDIDs and DDR3/DDR4\n"
+            "                       SPD images and decode those that check out\n"
+            "  -V, --verify=BITMAP  check the SPD CRCs of all images in the given files,\n"
+            "                       writing one bit per image, set if it passed, to BITMAP\n"
+            "  -D, --diff           compare two images or two containers field by field,\n"
+            "                       exiting with 0 if they are the same, 1 if not and\n"
+            "                       2 on errors\n"
+            "  -b, --bus-stats[=FILE] time every bus transaction, printing latency\n"
+            "                       histograms and error counts per adapter at exit,\n"
+            "                       or writing them to FILE as JSON\n"
+            "  -T, --trace=FILE     write a timeline of the scan to FILE in Chrome's trace\n"
+            "                       event format, one track per thread\n"
+            "  -h, --help           show this help\n",
+            name, GENTLE_DEFAULT_RATE);
+}
+
+int main (int argc, char **argv) {
+    static const struct option options[] = {
+        { "gentle", optional_argument, NULL, 'g' },
+        { "drm",    no_argument,       NULL, 'd' },
+        { "dp-aux", no_argument,       NULL, 'p' },
+        { "pipeline", no_argument,     NULL, 'P' },
+        { "jobs",   required_argument, NULL, 'j' },
+        { "json",   no_argument,       NULL, 'J' },
+        { "output", required_argument, NULL, 'o' },
+        { "delta",  no_argument,       NULL, 'z' },
+        { "store",  required_argument, NULL, 's' },
+        { "build-index", no_argument,  NULL, 'I' },
+        { "query",  required_argument, NULL, 'q' },
+        { "monitors", required_argument, NULL, 'm' },
+        { "serial", required_argument, NULL, 'S' },
+        { "aggregate", required_argument, NULL, 'a' },
+        { "filter", required_argument, NULL, 'F' },
+        { "carve",  no_argument,       NULL, 'C' },
+        { "verify", required_argument, NULL, 'V' },
+        { "diff",   no_argument,       NULL, 'D' },
+        { "bus-stats", optional_argument, NULL, 'b' },
+        { "trace",  required_argument, NULL, 'T' },
+        { "help",   no_argument,       NULL, 'h' },
+        { NULL,     0,                 NULL, 0 }
+    };
+    int c, i;
+    const char *output = NULL, *store = NULL, *bitmap = NULL;
+    int dp_aux = 0, drm = 0, pipeline = 0, jobs = 1, delta = 0, json = 0;
+    int build_index = 0, num_queries = 0, monitors = 0, serial = 0, carve = 0, diff = 0;
+    int num_group_keys = 0, group_keys[MAX_GROUP_KEYS];
+    struct spd_query queries[16];
+    struct filter filters[16];
+    char *filter_texts[16];
+    int num_filters = 0;
+    struct edid_query monitor_query;
+    struct serial_query serial_query;
+
+    while ((c = getopt_long (argc, argv, "g::dpPj:Jo:zs:Iq:m:S:a:F:CV:Db::T:h", options, NULL)) != -1)
+        switch (c) {
+        case 'g':
+            if (gentle_setup (optarg ? atoi (optarg) : GENTLE_DEFAULT_RATE))
+                return 1;
+            break;
+        case 'd':
+            drm = 1;
+            break;
+        case 'p':
+            dp_aux = 1;
+            break;
+        case 'P':
+            pipeline = 1;
+            break;
+        case 'j':
+            jobs = atoi (optarg);
+            if (jobs <= 0)
+                jobs = sysconf (_SC_NPROCESSORS_ONLN);
+            break;
+        case 'J':
+            json = 1;
+            break;
+        case 'o':
+            output = optarg;
+            break;
+        case 'z':
+            delta = 1;
+            break;
+        case 's':
+            store = optarg;
+            break;
+        case 'I':
+            build_index = 1;
+            break;
+        case 'q':
+            if (num_queries == sizeof (queries) / sizeof (queries[0]) ||
+                parse_spd_query (optarg, &queries[num_queries])) {
+                fprintf (stderr, "Invalid query %s\n", optarg);
+                return 1;
+            }
+            num_queries++;
+            break;
+        case 'm':
+            if (parse_edid_query (optarg, &monitor_query)) {
+                fprintf (stderr, "Invalid display capabilities %s\n", optarg);
+                return 1;
+            }
+            monitors = 1;
+            break;
+        case 'S':
+            if (parse_serial_query (optarg, &serial_query)) {
+                fprintf (stderr, "Invalid serial number %s\n", optarg);
+                return 1;
+            }
+            serial = 1;
+            break;
+        case 'a':
+            if ((num_group_keys = parse_group_keys (optarg, group_keys)) < 0) {
+                fprintf (stderr, "Invalid grouping %s\n", optarg);
+                return 1;
+            }
+            break;
+        case 'F':
+            if (num_filters == sizeof (filters) / sizeof (filters[0]) ||
+                parse_filter (optarg, &filters[num_filters])) {
+                fprintf (stderr, "Invalid filter %s\n", optarg);
+                return 1;
+            }
+            filter_texts[num_filters++] = optarg;
+            break;
+        case 'C':
+            carve = 1;
+            break;
+        case 'V':
+            bitmap = optarg;
+            break;
+        case 'D':
+            diff = 1;
+            break;
+        case 'b':
+            if (bus_stats_setup (optarg))
+                return 1;
+            break;
+        case 'T':
+            if (trace_open (optarg))
+                return 1;
+            break;
+        case 'h':
+            usage (argv[0]);
+            return 0;
+        default:
+            usage (argv[0]);
+            return 1;
+        }
+
+    /* like diff(1): 0 if the same, 1 if different, 2 on trouble */
+    if (diff) {
+        if (argc - optind != 2) {
+            usage (argv[0]);
+            return 2;
+        }
+        c = diff_paths (argv[optind], argv[optind + 1]);
+        return c < 0 ? 2 : c > 0;
+    }
+
+    if (bitmap) {
+        if (optind == argc) {
+            usage (argv[0]);
+            return 1;
+        }
+        return verify_paths (argc - optind, argv + optind, bitmap) ? 1 : 0;
+    }
+
+    if (output && collect_open (output, delta))
+        return 1;
+    if (store && store_open (store))
+        return 1;
+
+    if (optind < argc && (build_index || num_queries || monitors || serial)) {
+        for (i = optind; i < argc; i++) {
+            if (build_index) {
+                spdindex_build (argv[i]);
+                edidindex_build (argv[i]);
+                serialindex_build (argv[i]);
+            }
+            if (num_queries)
+                spdindex_query (argv[i], num_queries, queries);
+            if (monitors)
+                edidindex_query (argv[i], &monitor_query);
+        }
+        if (serial)
+            serialindex_query (argc - optind, argv + optind, &serial_query);
+    } else if (optind < argc && carve) {
+        for (; optind < argc; optind++)
+            carve_file (argv[optind]);
+    } else if (optind < argc && num_filters) {
+        query_corpus (argc - optind, argv + optind, jobs,
+                      num_filters, filter_texts, filters);
+    } else if (optind < argc && num_group_keys) {
+        aggregate_corpus (argc - optind, argv + optind, jobs,
+                          num_group_keys, group_keys);
+    } else if (optind < argc) {
+        if (jobs > 1 || json)
+            decode_corpus (argc - optind, argv + optind, jobs, json);
+        else
+            for (; optind < argc; optind++)
+                decode_path (argv[optind]);
+    } else {
+        if (drm)
+            foreach_drm_connector ();
+        if (dp_aux)
+            foreach_dp_aux ();
+        if (!drm && !dp_aux) {
+            if (pipeline)
+                pipeline_i2c_adapters (1);
+            else
+                foreach_i2c_adapter (1);
+        }
+    }
 
-    return 0;
+    return (collect_close () | store_close ()) ? 1 : 0;
 }
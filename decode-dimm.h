@@ -0,0 +1,19 @@
+#pragma once
+
+/* longest note read_adapter() passes along with an eeprom */
+#define SCAN_NOTE_SIZE          96
+
+/* called for every eeprom read, returns the number of eeproms handled;
+   note, if not NULL, is a line to print ahead of the decode */
+typedef int (*eeprom_handler) (void *arg, int client,
+                               const unsigned char *eeprom, int length,
+                               const char *note);
+/* called for every adapter found, returns the number of eeproms handled */
+typedef int (*adapter_handler) (void *arg, const char *adapter,
+                                const char *name);
+
+char *get_i2c_bus_name (const char *id);
+int read_adapter (const char *adapter, eeprom_handler handler, void *arg);
+int scan_adapter (const char *adapter);
+int list_i2c_adapters (int all, adapter_handler handler, void *arg);
+int foreach_i2c_adapter (int all);
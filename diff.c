@@ -0,0 +1,300 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "fields.h"
+#include "container.h"
+#include "diff.h"
+
+/* largest value printed in full; longer fields show their changed bytes */
+#define MAX_VALUE_BYTES         16
+
+/* First offset from offset on where a and b differ, comparing word-wise */
+static int next_difference (const unsigned char *a, const unsigned char *b,
+                            int offset, int length) {
+    uint64_t x, y;
+
+    for (; offset + 8 <= length; offset += 8) {
+        memcpy (&x, a + offset, 8);
+        memcpy (&y, b + offset, 8);
+        if (x != y)
+            break;
+    }
+    for (; offset < length && a[offset] == b[offset]; offset++);
+    return offset;
+}
+
+static void print_value (const unsigned char *data, int size, int text) {
+    uint64_t value = 0;
+    int i;
+
+    if (text) {
+        putchar ('"');
+        for (i = 0; i < size && data[i] && data[i] != 0xff; i++)
+            putchar (data[i] >= 0x20 && data[i] < 0x7f ? data[i] : '.');
+        putchar ('"');
+    } else if (size == 1 || size == 2 || size == 4 || size == 8) {
+        for (i = size - 1; i >= 0; i--)
+            value = value << 8 | data[i];
+        printf ("0x%0*llx", 2 * size, (unsigned long long) value);
+    } else {
+        for (i = 0; i < size && i < MAX_VALUE_BYTES; i++)
+            printf ("%s%02x", i ? " " : "", data[i]);
+        if (size > MAX_VALUE_BYTES)
+            printf (" ...");
+    }
+}
+
+/*
+ * Print the fields in which two images differ. Whole images are compared
+ * at once first, then word by word, and only the differing ranges are
+ * looked up in the field tables. Returns the number of differences.
+ */
+int diff_fields (const unsigned char *a, int a_length,
+                 const unsigned char *b, int b_length) {
+    const struct field *field;
+    char name[80];
+    int length = a_length < b_length ? a_length : b_length;
+    int offset = 0, start, end, base, text, count = 0;
+
+    if (a_length == b_length && !memcmp (a, b, length))
+        return 0;
+
+    while ((offset = next_difference (a, b, offset, length)) < length) {
+        if ((field = find_field (a, a_length, offset, &base))) {
+            start = base + field->offset;
+            end = start + field->size;
+            text = field->text;
+            if (base)
+                snprintf (name, sizeof (name), "block %d %s", base / 128, field->name);
+            else
+                snprintf (name, sizeof (name), "%s", field->name);
+            /* only show the changed part of large fields */
+            if (!text && field->size > MAX_VALUE_BYTES) {
+                snprintf (name + strlen (name), sizeof (name) - strlen (name),
+                          "[%d]", offset - start);
+                start = offset;
+            }
+        } else {
+            start = offset;
+            for (end = offset + 1; end < length && a[end] != b[end] &&
+                     !find_field (a, a_length, end, &base); end++);
+            snprintf (name, sizeof (name), "byte %d", offset);
+            text = 0;
+        }
+        if (end > length)
+            end = length;
+
+        printf ("  0x%03x %-28s ", start, name);
+        print_value (a + start, end - start, text);
+        printf (" -> ");
+        print_value (b + start, end - start, text);
+        printf ("\n");
+        count++;
+        offset = end;
+    }
+    if (a_length != b_length) {
+        printf ("  length %d -> %d\n", a_length, b_length);
+        count++;
+    }
+    return count;
+}
+
+struct mapping {
+    const unsigned char *data;
+    size_t size;
+};
+
+static int map_path (struct mapping *mapping, const char *path) {
+    struct stat statbuf;
+    void *map;
+    int fd;
+
+    if ((fd = open (path, O_RDONLY)) < 0 || fstat (fd, &statbuf)) {
+        fprintf (stderr, "Can't open %s: %s\n", path, strerror (errno));
+        if (fd >= 0)
+            close (fd);
+        return -1;
+    }
+    if (statbuf.st_size == 0 || statbuf.st_size > 0x7fffffff) {
+        fprintf (stderr, "%s: unsupported size %lld\n", path,
+                 (long long) statbuf.st_size);
+        close (fd);
+        return -1;
+    }
+    map = mmap (NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        fprintf (stderr, "Can't mmap() %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    mapping->data = map;
+    mapping->size = statbuf.st_size;
+    return 0;
+}
+
+/* a record of a snapshot, identified by where it was read from */
+struct slot {
+    int source;
+    int client;
+    const char *adapter;
+    const unsigned char *image;
+    int length;
+    unsigned char *copy;        /* of a rebuilt delta record */
+};
+
+static int compare_slots (const void *a, const void *b) {
+    const struct slot *x = a, *y = b;
+    int result;
+
+    if (x->source != y->source)
+        return x->source - y->source;
+    if ((result = strcmp (x->adapter, y->adapter)))
+        return result;
+    return x->client - y->client;
+}
+
+/* The records of a container sorted by slot; names are kept in *names */
+static struct slot *get_slots (const struct container *container, char **names) {
+    struct image_info info;
+    struct slot *slots;
+    uint32_t i;
+
+    slots = calloc (container->count ? container->count : 1, sizeof (*slots));
+    *names = malloc (container->count ? container->count * sizeof (info.adapter) : 1);
+    if (!slots || !*names) {
+        fprintf (stderr, "Out of memory\n");
+        free (slots);
+        free (*names);
+        return NULL;
+    }
+    for (i = 0; i < container->count; i++) {
+        if (container_get (container, i, &info)) {
+            fprintf (stderr, "Record %u is corrupt\n", i);
+            while (i--)
+                free (slots[i].copy);
+            free (slots);
+            free (*names);
+            return NULL;
+        }
+        strcpy (*names + i * sizeof (info.adapter), info.adapter);
+        slots[i].source = info.source;
+        slots[i].client = info.client;
+        slots[i].adapter = *names + i * sizeof (info.adapter);
+        slots[i].image = info.image;
+        slots[i].length = info.image ? info.length : 0;
+        if (info.image == info.data && (slots[i].copy = malloc (info.length))) {
+            memcpy (slots[i].copy, info.data, info.length);
+            slots[i].image = slots[i].copy;
+        } else if (info.image == info.data)
+            slots[i].length = 0;
+    }
+    qsort (slots, container->count, sizeof (*slots), compare_slots);
+    return slots;
+}
+
+static void print_slot (const struct slot *slot, const char *change) {
+    if (slot->source == SOURCE_I2C || slot->source == SOURCE_DP_AUX)
+        printf ("%s %s client 0x%02x: %s\n", source_name (slot->source),
+                slot->adapter, slot->client, change);
+    else
+        printf ("%s %s: %s\n", source_name (slot->source), slot->adapter, change);
+}
+
+/*
+ * Compare two snapshots slot by slot: records are paired by source,
+ * adapter and client, regardless of the host they were taken on
+ */
+static int diff_snapshots (const struct container *a, const struct container *b) {
+    struct slot *x, *y;
+    char *x_names, *y_names;
+    uint32_t i = 0, j = 0;
+    int result, same = 0, changed = 0, added = 0, removed = 0;
+
+    x = get_slots (a, &x_names);
+    y = get_slots (b, &y_names);
+    if (!x || !y) {
+        result = -1;
+        goto out;
+    }
+
+    while (i < a->count || j < b->count) {
+        if (j == b->count || (i < a->count && compare_slots (&x[i], &y[j]) < 0)) {
+            print_slot (&x[i++], "removed");
+            removed++;
+        } else if (i == a->count || compare_slots (&x[i], &y[j]) > 0) {
+            print_slot (&y[j++], "added");
+            added++;
+        } else {
+            if (x[i].length == y[j].length &&
+                !memcmp (x[i].image, y[j].image, x[i].length))
+                same++;
+            else {
+                print_slot (&x[i], "changed");
+                diff_fields (x[i].image, x[i].length, y[j].image, y[j].length);
+                changed++;
+            }
+            i++;
+            j++;
+        }
+    }
+    printf ("%d unchanged, %d changed, %d added, %d removed\n",
+            same, changed, added, removed);
+    result = changed + added + removed;
+
+out:
+    for (i = 0; x && i < a->count; i++)
+        free (x[i].copy);
+    for (j = 0; y && j < b->count; j++)
+        free (y[j].copy);
+    free (x);
+    free (y);
+    if (x)
+        free (x_names);
+    if (y)
+        free (y_names);
+    return result;
+}
+
+/*
+ * Compare two raw images or two containers; returns the number of
+ * changes, or -1 if they can't be read or compared
+ */
+int diff_paths (const char *a, const char *b) {
+    struct mapping x, y;
+    struct container c, d;
+    int result;
+
+    if (map_path (&x, a))
+        return -1;
+    if (map_path (&y, b)) {
+        munmap ((void *) x.data, x.size);
+        return -1;
+    }
+
+    printf ("Comparing %s and %s\n", a, b);
+    if (is_container (x.data, x.size) != is_container (y.data, y.size)) {
+        fprintf (stderr, "Can't compare a container with a single image\n");
+        result = -1;
+    } else if (is_container (x.data, x.size)) {
+        if (container_map (&c, x.data, x.size) || container_map (&d, y.data, y.size)) {
+            fprintf (stderr, "Corrupt container\n");
+            result = -1;
+        } else
+            result = diff_snapshots (&c, &d);
+    } else {
+        result = diff_fields (x.data, x.size, y.data, y.size);
+        printf ("%d difference%s\n", result, result == 1 ? "" : "s");
+    }
+
+    munmap ((void *) x.data, x.size);
+    munmap ((void *) y.data, y.size);
+    return result;
+}
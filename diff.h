@@ -0,0 +1,5 @@
+#pragma once
+
+int diff_fields (const unsigned char *a, int a_length,
+                 const unsigned char *b, int b_length);
+int diff_paths (const char *a, const char *b);
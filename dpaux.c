@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <libgen.h>
+#include <sys/stat.h>
+
+#include "i2c-tools-i2c-dev.h"
+#include "decode-dimm.h"
+#include "ddc.h"
+#include "eeprom.h"
+#include "container.h"
+#include "dpaux.h"
+
+#define SYSFS_DP_AUX            "/sys/class/drm_dp_aux_dev"
+#define DP_DPCD_REV             0x000
+#define DP_AUX_MAX_PAYLOAD      16
+
+static int read_sysfs_string (const char *path, char *buffer, int size) {
+    FILE *file;
+
+    buffer[0] = 0;
+    if (!(file = fopen (path, "r")))
+        return -1;
+    if (!fgets (buffer, size, file))
+        buffer[0] = 0;
+    fclose (file);
+    buffer[strcspn (buffer, "\n")] = 0;
+    return 0;
+}
+
+/*
+ * A single native AUX read of the receiver capabilities tells us whether
+ * a sink is attached, without sitting through the I2C-over-AUX retries
+ * that an absent or sleeping sink would cause.
+ */
+static int dp_aux_sink_present (const char *aux) {
+    char dev_name[64];
+    unsigned char dpcd[DP_AUX_MAX_PAYLOAD];
+    int device, result;
+
+    snprintf (dev_name, sizeof (dev_name), "/dev/%s", aux);
+    if ((device = open (dev_name, O_RDONLY)) < 0) {
+        fprintf (stderr, "Can't open %s: %s\n", dev_name, strerror (errno));
+        return 0;
+    }
+    result = pread (device, dpcd, sizeof (dpcd), DP_DPCD_REV);
+    close (device);
+
+    return result == sizeof (dpcd) && dpcd[0];
+}
+
+/*
+ * The I2C-over-AUX adapter is registered below the connector the AUX
+ * channel belongs to; older kernels parent it elsewhere, but it always
+ * carries the name of the AUX channel.
+ */
+static int dp_aux_find_ddc (const char *aux, const char *aux_name,
+                            char *adapter, int size) {
+    char path[512], link[512];
+    DIR *dir;
+    struct dirent *entry;
+    char *name;
+    int len, found = 0;
+
+    snprintf (path, sizeof (path), SYSFS_DP_AUX "/%s/device/ddc", aux);
+    if ((len = readlink (path, link, sizeof (link) - 1)) > 0) {
+        link[len] = 0;
+        snprintf (adapter, size, "%s", basename (link));
+        return 0;
+    }
+
+    snprintf (path, sizeof (path), SYSFS_DP_AUX "/%s/device", aux);
+    if ((dir = opendir (path))) {
+        while (!found && (entry = readdir (dir)))
+            if (!strncmp (entry->d_name, "i2c-", 4)) {
+                snprintf (adapter, size, "%s", entry->d_name);
+                found = 1;
+            }
+        closedir (dir);
+        if (found)
+            return 0;
+    }
+
+    if (!(dir = opendir ("/sys/class/i2c-dev")))
+        return -1;
+    while (!found && (entry = readdir (dir)))
+        if (entry->d_name[0] != '.') {
+            name = get_i2c_bus_name (strchr (entry->d_name, '-') + 1);
+            if (name && !strcmp (name, aux_name)) {
+                snprintf (adapter, size, "%s", entry->d_name);
+                found = 1;
+            }
+            free (name);
+        }
+    closedir (dir);
+
+    return found ? 0 : -1;
+}
+
+static int scan_dp_aux (const char *aux) {
+    char path[512], link[512], aux_name[256], status[32];
+    char connector[256], adapter[256];
+    unsigned char edid[EDID_MAX_SIZE];
+    int device, len, bytes_read;
+
+    snprintf (path, sizeof (path), SYSFS_DP_AUX "/%s/name", aux);
+    read_sysfs_string (path, aux_name, sizeof (aux_name));
+
+    snprintf (path, sizeof (path), SYSFS_DP_AUX "/%s/device", aux);
+    if ((len = readlink (path, link, sizeof (link) - 1)) > 0) {
+        link[len] = 0;
+        snprintf (connector, sizeof (connector), "%s", basename (link));
+    } else
+        snprintf (connector, sizeof (connector), "unknown connector");
+
+    snprintf (path, sizeof (path), SYSFS_DP_AUX "/%s/device/status", aux);
+    if (!read_sysfs_string (path, status, sizeof (status)) &&
+        strcmp (status, "connected"))
+        return 0;
+
+    if (!dp_aux_sink_present (aux))
+        return 0;
+
+    if (dp_aux_find_ddc (aux, aux_name, adapter, sizeof (adapter))) {
+        fprintf (stderr, "No DDC adapter found for %s\n", aux);
+        return -1;
+    }
+
+    printf ("Testing %s on %s (%s, %s)\n", connector, aux, aux_name, adapter);
+
+    snprintf (path, sizeof (path), "/dev/%s", adapter);
+    if ((device = open (path, O_RDWR)) < 0) {
+        fprintf (stderr, "Can't open %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    bytes_read = ddc_read_edid (device, edid, 0, sizeof (edid));
+    close (device);
+
+    if (bytes_read < 0) {
+        fprintf (stderr, "Can't read EDID from %s: %s\n", adapter, strerror (errno));
+        return -1;
+    }
+    if (bytes_read == 0)
+        return 0;
+
+    collect_image (SOURCE_DP_AUX, connector, DDC_ADDR_EDID, edid, bytes_read);
+    return do_eeprom (DDC_ADDR_EDID, edid, bytes_read) ? 0 : 1;
+}
+
+int foreach_dp_aux (void) {
+    DIR *sysfsdir;
+    struct dirent *aux;
+    int result, count = 0;
+
+    if (!(sysfsdir = opendir (SYSFS_DP_AUX))) {
+        fprintf (stderr, "Can't opendir " SYSFS_DP_AUX ": %s\n",
+                 strerror (errno));
+        return -1;
+    }
+
+    while ((aux = readdir (sysfsdir)))
+        if (!strncmp (aux->d_name, "drm_dp_aux", 10)) {
+            result = scan_dp_aux (aux->d_name);
+            if (result > 0)
+                count += result;
+        }
+    closedir (sysfsdir);
+    return count;
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+int foreach_dp_aux (void);
@@ -0,0 +1,79 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ddc.h"
+#include "eeprom.h"
+#include "container.h"
+#include "eedid.h"
+#include "drm.h"
+
+#define SYSFS_DRM               "/sys/class/drm"
+
+/* connectors are named card<n>-<type>-<index>, e.g. card0-HDMI-A-1 */
+static int is_connector (const char *name) {
+    if (strncmp (name, "card", 4))
+        return 0;
+    name += 4;
+    if (*name < '0' || *name > '9')
+        return 0;
+    while (*name >= '0' && *name <= '9')
+        name++;
+    return *name == '-';
+}
+
+static int decode_drm_connector (const char *connector) {
+    char path[512];
+    unsigned char edid[EDID_MAX_SIZE];
+    int fd, result, bytes_read = 0;
+
+    snprintf (path, sizeof (path), SYSFS_DRM "/%s/edid", connector);
+    if ((fd = open (path, O_RDONLY)) < 0) {
+        if (errno != ENOENT)
+            fprintf (stderr, "Can't open %s: %s\n", path, strerror (errno));
+        return 0;
+    }
+    /* bin attributes may hand out the blob in pieces, read up to EOF */
+    while (bytes_read < sizeof (edid) &&
+           (result = read (fd, edid + bytes_read, sizeof (edid) - bytes_read)) != 0) {
+        if (result < 0) {
+            fprintf (stderr, "Can't read %s: %s\n", path, strerror (errno));
+            close (fd);
+            return -1;
+        }
+        bytes_read += result;
+    }
+    close (fd);
+
+    /* disconnected connectors have an empty edid attribute */
+    if (bytes_read < EDID_BLOCK_SIZE || !is_eedid (edid))
+        return 0;
+
+    collect_image (SOURCE_DRM, connector, 0, edid, bytes_read);
+    printf ("Connector %s\n", connector);
+    do_eedid ((struct eedid_t *) edid, bytes_read);
+    return 1;
+}
+
+int foreach_drm_connector (void) {
+    DIR *sysfsdir;
+    struct dirent *connector;
+    int result, count = 0;
+
+    if (!(sysfsdir = opendir (SYSFS_DRM))) {
+        fprintf (stderr, "Can't opendir " SYSFS_DRM ": %s\n", strerror (errno));
+        return -1;
+    }
+
+    while ((connector = readdir (sysfsdir)))
+        if (is_connector (connector->d_name)) {
+            result = decode_drm_connector (connector->d_name);
+            if (result > 0)
+                count += result;
+        }
+    closedir (sysfsdir);
+    return count;
+}
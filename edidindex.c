@@ -0,0 +1,396 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "eedid.h"
+#include "eeprom.h"
+#include "ddc.h"
+#include "hash.h"
+#include "container.h"
+#include "edidindex.h"
+
+/* descriptor tag of the serial number string, see eedid_constants.h */
+#define DT_SERIAL               0xff
+
+struct build_model {
+    uint64_t hash;
+    unsigned char *key;         /* the masked EDID */
+    int length;
+    struct eedid_caps caps;
+    uint32_t count;
+    uint32_t first;
+};
+
+struct build_sighting {
+    uint32_t model;
+    uint32_t record;
+};
+
+struct build {
+    struct build_model *models;
+    uint32_t count;
+    uint32_t size;
+    uint32_t *table;            /* model + 1, 0 for empty slots */
+    uint32_t table_size;        /* a power of two */
+};
+
+/* Copy an EDID with everything that differs between units of a model zeroed */
+static void mask_edid (unsigned char *key, const unsigned char *edid, int length) {
+    const struct eedid_t *eedid = (const struct eedid_t *) edid;
+    const union eighteen_bytes_descriptor_t *desc;
+    int i;
+
+    memcpy (key, edid, length);
+    memset (key + offsetof (struct eedid_t, id_serial_number), 0, 6);
+    key[offsetof (struct eedid_t, checksum)] = 0;
+    for (i = 0; i < 4; i++) {
+        desc = &eedid->detailed_timings[i];
+        if (!desc->timing.pixel_clock && desc->desc.tag == DT_SERIAL)
+            memset (key + offsetof (struct eedid_t, detailed_timings[i]), 0,
+                    sizeof (*desc));
+    }
+}
+
+static uint32_t *find_slot (const struct build *build, uint32_t *table, uint32_t size,
+                            uint64_t hash, const unsigned char *key, int length) {
+    const struct build_model *model;
+    uint32_t i;
+
+    for (i = hash & (size - 1); table[i]; i = (i + 1) & (size - 1)) {
+        model = &build->models[table[i] - 1];
+        if (model->hash == hash && model->length == length &&
+            !memcmp (model->key, key, length))
+            break;
+    }
+    return &table[i];
+}
+
+/* The model of an EDID, added to build if it is new; -1 if out of memory */
+static int64_t get_model (struct build *build, const unsigned char *edid, int length) {
+    unsigned char key[EDID_MAX_SIZE];
+    struct build_model *models;
+    uint32_t *table, *slot, i, size;
+    uint64_t hash;
+
+    mask_edid (key, edid, length);
+    hash = hash64 (key, length);
+
+    if (2 * (build->count + 1) > build->table_size) {
+        size = build->table_size ? 2 * build->table_size : 1024;
+        if (!(table = calloc (size, sizeof (*table))))
+            return -1;
+        for (i = 0; i < build->count; i++)
+            *find_slot (build, table, size, build->models[i].hash,
+                        build->models[i].key, build->models[i].length) = i + 1;
+        free (build->table);
+        build->table = table;
+        build->table_size = size;
+    }
+    slot = find_slot (build, build->table, build->table_size, hash, key, length);
+    if (*slot)
+        return *slot - 1;
+
+    if (build->count == build->size) {
+        build->size = build->size ? 2 * build->size : 256;
+        if (!(models = realloc (build->models, build->size * sizeof (*models))))
+            return -1;
+        build->models = models;
+    }
+    models = &build->models[build->count];
+    memset (models, 0, sizeof (*models));
+    if (!(models->key = malloc (length)))
+        return -1;
+    memcpy (models->key, key, length);
+    models->hash = hash;
+    models->length = length;
+    get_eedid_caps ((const struct eedid_t *) edid, length, &models->caps);
+    *slot = ++build->count;
+    return build->count - 1;
+}
+
+static const struct build_model *sort_models;
+
+static int compare_models (const void *a, const void *b) {
+    const struct build_model *x = &sort_models[*(const uint32_t *) a];
+    const struct build_model *y = &sort_models[*(const uint32_t *) b];
+    int result = memcmp (x->caps.vendor, y->caps.vendor, 3);
+
+    if (result)
+        return result;
+    if (x->caps.product != y->caps.product)
+        return x->caps.product < y->caps.product ? -1 : 1;
+    return x->hash < y->hash ? -1 : x->hash > y->hash;
+}
+
+static void put_model (struct edidindex_model *out, const struct build_model *model) {
+    memset (out, 0, sizeof (*out));
+    out->hash = htole64 (model->hash);
+    memcpy (out->vendor, model->caps.vendor, 4);
+    out->product = htole16 (model->caps.product);
+    out->digital = model->caps.digital;
+    out->interface = model->caps.interface;
+    out->hdmi = model->caps.hdmi;
+    out->max_tmds = htole16 (model->caps.max_tmds);
+    out->width = htole16 (model->caps.width);
+    out->height = htole16 (model->caps.height);
+    out->refresh = htole16 (model->caps.refresh);
+    memcpy (out->name, model->caps.name, sizeof (out->name));
+    memcpy (out->vics, model->caps.vics, sizeof (out->vics));
+    out->first = htole32 (model->first);
+    out->count = htole32 (model->count);
+}
+
+int edidindex_build (const char *path) {
+    struct container container;
+    struct image_info info;
+    struct build build;
+    struct build_sighting *sightings = NULL;
+    struct edidindex_header header;
+    struct edidindex_model model;
+    uint32_t *order = NULL, *rank = NULL, *list = NULL, *next = NULL;
+    uint32_t record, count = 0, i, first;
+    char name[4096], tmpname[4100];
+    int64_t m;
+    FILE *file;
+    int result = -1;
+
+    if (container_open (&container, path)) {
+        fprintf (stderr, "%s is not a container\n", path);
+        return -1;
+    }
+    memset (&build, 0, sizeof (build));
+    if (!(sightings = malloc ((container.count ? container.count : 1) *
+                              sizeof (*sightings))))
+        goto oom;
+
+    for (record = 0; record < container.count; record++) {
+        if (container_get (&container, record, &info) || info.length < 128 ||
+            info.length > EDID_MAX_SIZE || !is_eedid (info.image))
+            continue;
+        if ((m = get_model (&build, info.image, info.length)) < 0)
+            goto oom;
+        build.models[m].count++;
+        sightings[count].model = m;
+        sightings[count].record = record;
+        count++;
+    }
+
+    order = malloc ((build.count ? build.count : 1) * sizeof (uint32_t));
+    rank = malloc ((build.count ? build.count : 1) * sizeof (uint32_t));
+    next = malloc ((build.count ? build.count : 1) * sizeof (uint32_t));
+    list = malloc ((count ? count : 1) * sizeof (uint32_t));
+    if (!order || !rank || !next || !list)
+        goto oom;
+
+    /* sort the models, then lay out their records in record order */
+    for (i = 0; i < build.count; i++)
+        order[i] = i;
+    sort_models = build.models;
+    qsort (order, build.count, sizeof (uint32_t), compare_models);
+    for (i = 0, first = 0; i < build.count; i++) {
+        rank[order[i]] = i;
+        build.models[order[i]].first = next[i] = first;
+        first += build.models[order[i]].count;
+    }
+    for (i = 0; i < count; i++)
+        list[next[rank[sightings[i].model]]++] = htole32 (sightings[i].record);
+
+    snprintf (name, sizeof (name), "%s" EDIDINDEX_SUFFIX, path);
+    snprintf (tmpname, sizeof (tmpname), "%s.tmp", name);
+    if (!(file = fopen (tmpname, "w"))) {
+        fprintf (stderr, "Can't create %s: %s\n", tmpname, strerror (errno));
+        goto out;
+    }
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, EDIDINDEX_MAGIC, 8);
+    header.models = htole32 (build.count);
+    header.sightings = htole32 (count);
+    fwrite (&header, sizeof (header), 1, file);
+    for (i = 0; i < build.count; i++) {
+        put_model (&model, &build.models[order[i]]);
+        fwrite (&model, sizeof (model), 1, file);
+    }
+    fwrite (list, sizeof (uint32_t), count, file);
+
+    if (ferror (file) | fclose (file) || rename (tmpname, name)) {
+        fprintf (stderr, "Error writing %s: %s\n", name, strerror (errno));
+        unlink (tmpname);
+        goto out;
+    }
+    printf ("Indexed %u display models in %u EDIDs of %s\n", build.count, count, path);
+    result = 0;
+    goto out;
+
+oom:
+    fprintf (stderr, "Out of memory\n");
+out:
+    for (i = 0; i < build.count; i++)
+        free (build.models[i].key);
+    free (build.models);
+    free (build.table);
+    free (sightings);
+    free (order);
+    free (rank);
+    free (next);
+    free (list);
+    container_close (&container);
+    return result;
+}
+
+/* Comma separated terms: WxH[@R], hdmi, dp, dvi, digital, analog,
+   tmds=MHZ, vendor=PNP and product=N */
+int parse_edid_query (const char *text, struct edid_query *query) {
+    char buffer[256], *term, *save, *end;
+    int i;
+
+    memset (query, 0, sizeof (*query));
+    query->interface = query->digital = query->product = -1;
+    snprintf (buffer, sizeof (buffer), "%s", text);
+    for (term = strtok_r (buffer, ",", &save); term; term = strtok_r (NULL, ",", &save)) {
+        if (isdigit (term[0])) {
+            query->width = strtol (term, &end, 10);
+            if (*end != 'x' && *end != 'X')
+                return -1;
+            query->height = strtol (end + 1, &end, 10);
+            if (*end == '@')
+                query->refresh = strtol (end + 1, &end, 10);
+            if (*end)
+                return -1;
+        } else if (!strcasecmp (term, "hdmi"))
+            query->hdmi = 1;
+        else if (!strcasecmp (term, "dp") || !strcasecmp (term, "displayport"))
+            query->interface = 5;
+        else if (!strcasecmp (term, "dvi"))
+            query->interface = 1;
+        else if (!strcasecmp (term, "digital"))
+            query->digital = 1;
+        else if (!strcasecmp (term, "analog"))
+            query->digital = 0;
+        else if (!strncasecmp (term, "tmds=", 5)) {
+            query->max_tmds = strtol (term + 5, &end, 10);
+            if (*end)
+                return -1;
+        } else if (!strncasecmp (term, "vendor=", 7)) {
+            if (strlen (term + 7) != 3)
+                return -1;
+            for (i = 0; i < 3; i++)
+                query->vendor[i] = toupper (term[7 + i]);
+        } else if (!strncasecmp (term, "product=", 8)) {
+            query->product = strtol (term + 8, &end, 0);
+            if (*end)
+                return -1;
+        } else
+            return -1;
+    }
+    return 0;
+}
+
+static void get_model_caps (const struct edidindex_model *model,
+                            struct eedid_caps *caps) {
+    memset (caps, 0, sizeof (*caps));
+    memcpy (caps->vendor, model->vendor, 3);
+    caps->product = le16toh (model->product);
+    memcpy (caps->name, model->name, sizeof (model->name));
+    caps->name[sizeof (caps->name) - 1] = 0;
+    caps->digital = model->digital;
+    caps->interface = model->interface;
+    caps->hdmi = model->hdmi;
+    caps->max_tmds = le16toh (model->max_tmds);
+    caps->width = le16toh (model->width);
+    caps->height = le16toh (model->height);
+    caps->refresh = le16toh (model->refresh);
+    memcpy (caps->vics, model->vics, sizeof (caps->vics));
+}
+
+static int match_caps (const struct eedid_caps *caps, const struct edid_query *query) {
+    if (query->width && !eedid_caps_mode (caps, query->width, query->height,
+                                          query->refresh))
+        return 0;
+    /* HDMI-a and HDMI-b interfaces, or an HDMI vendor specific block */
+    if (query->hdmi && !caps->hdmi && caps->interface != 2 && caps->interface != 3)
+        return 0;
+    if (query->interface >= 0 && caps->interface != query->interface)
+        return 0;
+    if (query->digital >= 0 && caps->digital != query->digital)
+        return 0;
+    if (query->max_tmds && caps->max_tmds < query->max_tmds)
+        return 0;
+    if (query->vendor[0] && memcmp (caps->vendor, query->vendor, 3))
+        return 0;
+    if (query->product >= 0 && caps->product != query->product)
+        return 0;
+    return 1;
+}
+
+/* List the display models of a container that match query */
+int edidindex_query (const char *path, const struct edid_query *query) {
+    const struct edidindex_header *header;
+    const struct edidindex_model *models;
+    struct eedid_caps caps;
+    struct stat statbuf;
+    char name[4096];
+    uint32_t count, sightings, i, matches = 0, matched_sightings = 0;
+    void *map;
+    int fd;
+
+    snprintf (name, sizeof (name), "%s" EDIDINDEX_SUFFIX, path);
+    if ((fd = open (name, O_RDONLY)) < 0) {
+        fprintf (stderr, "Can't open %s: %s\n", name, strerror (errno));
+        return -1;
+    }
+    if (fstat (fd, &statbuf) || statbuf.st_size < sizeof (*header)) {
+        fprintf (stderr, "%s is not a model index\n", name);
+        close (fd);
+        return -1;
+    }
+    map = mmap (NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        fprintf (stderr, "Can't mmap() %s: %s\n", name, strerror (errno));
+        return -1;
+    }
+
+    header = map;
+    models = (const struct edidindex_model *) (header + 1);
+    count = le32toh (header->models);
+    sightings = le32toh (header->sightings);
+    if (memcmp (header->magic, EDIDINDEX_MAGIC, 8) ||
+        sizeof (*header) + (uint64_t) count * sizeof (*models) +
+        (uint64_t) sightings * sizeof (uint32_t) > statbuf.st_size) {
+        fprintf (stderr, "%s is not a valid model index\n", name);
+        munmap (map, statbuf.st_size);
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        get_model_caps (&models[i], &caps);
+        if (!match_caps (&caps, query))
+            continue;
+        printf ("%s %5d %-15s %dx%d@%d", caps.vendor, caps.product,
+                caps.name[0] ? caps.name : "-", caps.width, caps.height,
+                caps.refresh);
+        if (caps.interface)
+            printf (", %s", eedid_interface_name (caps.interface));
+        if (caps.hdmi)
+            printf (", HDMI VSDB");
+        if (caps.max_tmds)
+            printf (", TMDS %dMHz", caps.max_tmds);
+        printf (": %u sightings\n", le32toh (models[i].count));
+        matches++;
+        matched_sightings += le32toh (models[i].count);
+    }
+    printf ("%u matching models with %u sightings in %s\n", matches,
+            matched_sightings, path);
+
+    munmap (map, statbuf.st_size);
+    return matches;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Index of the display models seen in a container, stored next to it as
+ * <container>.models:
+ *
+ *   header | model table | sighting list
+ *
+ * A model is a PNP vendor and product code plus a hash over the EDID
+ * with the per-unit parts (serial numbers, manufacturing date and the
+ * base block checksum) masked out. Every model carries the capability
+ * summary of its EDID and the range of its records in the sighting
+ * list. Models are sorted by vendor, product and hash; all values are
+ * little endian.
+ */
+#define EDIDINDEX_MAGIC         "DSPDMOD1"
+#define EDIDINDEX_SUFFIX        ".models"
+
+#pragma pack(1)
+struct edidindex_header {
+    char magic[8];
+    uint32_t models;
+    uint32_t sightings;
+};
+
+struct edidindex_model {
+    uint64_t hash;
+    char vendor[4];
+    uint16_t product;
+    uint8_t digital;
+    uint8_t interface;
+    uint8_t hdmi;
+    uint8_t reserved[3];
+    uint16_t max_tmds;          /* MHz */
+    uint16_t width;             /* largest detailed timing */
+    uint16_t height;
+    uint16_t refresh;
+    char name[14];
+    uint8_t vics[16];
+    uint32_t first;             /* in the sighting list */
+    uint32_t count;
+};
+#pragma pack()
+
+/* capabilities a model must have, comma separated terms */
+struct edid_query {
+    int width, height, refresh;
+    int hdmi;
+    int interface;              /* -1 for any */
+    int digital;                /* -1 for any */
+    int max_tmds;
+    char vendor[4];
+    int product;                /* -1 for any */
+};
+
+int parse_edid_query (const char *text, struct edid_query *query);
+int edidindex_build (const char *container);
+int edidindex_query (const char *container, const struct edid_query *query);
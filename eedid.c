@@ -7,18 +7,23 @@
 
 #include "eedid_struct.h"
 #include "eedid_constants.h"
+#include "output.h"
+#include "probes.h"
+#include "eedid.h"
+#include "arena.h"
+#include "record.h"
 
 #ifndef ARRAY_SIZE
 #define ARRAY_SIZE(X) (sizeof(X) / sizeof(X[0]))
 #endif
 
-int version = 0, ctf = 0;
+static __thread int version = 0, ctf = 0;
 
 static char * get_eedid_string (const char * in) {
-    static char string[14];
+    static __thread char string[14];
     int i;
     memcpy (string, in, 13);
-    string[14] = 0;
+    string[13] = 0;
     for (i=0; i<13; i++)
         if (string[i] == 0x0a) {
             string[i] = 0;
@@ -52,7 +57,7 @@ static void print_dtd (const struct detailed_timing_t * dtd) {
     vtotal = height + dtd->vert_blank_lo +
         ((int)(dtd->vert_act_blank_hi & 15) << 8);
     vclock = round (hclock * 1000.0 / (float)vtotal);
-    printf ("Detailed Timing: %dx%d@%d (%6.2f %d %d %d %d %d %d %d %d%s",
+    do_printf ("Detailed Timing: %dx%d@%d (%6.2f %d %d %d %d %d %d %d %d%s",
             width, height, (int)vclock,
             (float)le16toh (dtd->pixel_clock) / 100.0,
             width,  hsyncstart, hsyncend, htotal,
@@ -61,13 +66,13 @@ static void print_dtd (const struct detailed_timing_t * dtd) {
     switch (dtd->flags & 24) {
     case 0:
     case 8:
-        printf (" Composite%s)\n", dtd->flags & 0x02 ? "" : " SyncOnGreen");
+        do_printf (" Composite%s)\n", dtd->flags & 0x02 ? "" : " SyncOnGreen");
         break;
     case 16:
-        printf (" Composite %cCSync)\n", dtd->flags & 0x02 ? '+' : '-');
+        do_printf (" Composite %cCSync)\n", dtd->flags & 0x02 ? '+' : '-');
         break;
     case 24:
-        printf (" %cHSync %cVSync)\n",
+        do_printf (" %cHSync %cVSync)\n",
                 dtd->flags & 0x02 ? '+' : '-',
                 dtd->flags & 0x04 ? '+' : '-');
         break;
@@ -75,12 +80,12 @@ static void print_dtd (const struct detailed_timing_t * dtd) {
     switch (((dtd->flags >> 4) & 6) | (dtd->flags & 1)) {
     case 0:
     case 1: break;
-    case 2: printf ("  Field sequential stereo, right image on sync\n"); break;
-    case 3: printf ("  2-way interleaved stereo, right image on even lines\n"); break;
-    case 4: printf ("  Field sequential stereo, left image on sync\n"); break;
-    case 5: printf ("  2-way interleaved stereo, left image on even lines\n"); break;
-    case 6: printf ("  4-way interleaved stereo\n"); break;
-    case 7: printf ("  Side-by-Side interleaved stereo\n");
+    case 2: do_printf ("  Field sequential stereo, right image on sync\n"); break;
+    case 3: do_printf ("  2-way interleaved stereo, right image on even lines\n"); break;
+    case 4: do_printf ("  Field sequential stereo, left image on sync\n"); break;
+    case 5: do_printf ("  2-way interleaved stereo, left image on even lines\n"); break;
+    case 6: do_printf ("  4-way interleaved stereo\n"); break;
+    case 7: do_printf ("  Side-by-Side interleaved stereo\n");
     }
 }
 
@@ -88,16 +93,16 @@ static void print_18b (const union eighteen_bytes_descriptor_t * desc) {
     if (desc->timing.pixel_clock)
         print_dtd ((struct detailed_timing_t *)desc);
     else if (desc->desc.flag2 != 0 || (desc->desc.flag3!= 0 && version < v14))
-        printf ("Warning: invalid device descriptor block\n");
+        do_printf ("Warning: invalid device descriptor block\n");
     else switch (desc->desc.tag) {
         case dt_dummy:
             break;
         case dt_serial:
-            printf ("Serial number: %s\n",
+            do_printf ("Serial number: %s\n",
                     get_eedid_string ((char *)desc->desc.data));
             break;
         case dt_rangelimits:
-            printf ("Range limits: Max clock = %dMHz, Refresh = %d-%dHz, HSync %d-%dkHz",
+            do_printf ("Range limits: Max clock = %dMHz, Refresh = %d-%dHz, HSync %d-%dkHz",
                     desc->limits.max_pixel_clock * 10,
                     (int)desc->limits.min_vert_rate + ((desc->limits.offsets & 0x01) ? 255:0),
                     (int)desc->limits.max_vert_rate + ((desc->limits.offsets & 0x02) ? 255:0),
@@ -107,23 +112,23 @@ static void print_18b (const union eighteen_bytes_descriptor_t * desc) {
                 switch (desc->limits.video_timing_support) {
                 case 0:
                 case 1: break;
-                case 2: printf (", Secondary GTF informationen\n"); break;
-                case 4: printf (", CVT information\n"); break;
+                case 2: do_printf (", Secondary GTF informationen\n"); break;
+                case 4: do_printf (", CVT information\n"); break;
                 default:
-                    printf ("Invalid video timing support (%02x)\n",
+                    do_printf ("Invalid video timing support (%02x)\n",
                             desc->limits.video_timing_support);
                     break;
                 }
-            printf ("\n");
+            do_printf ("\n");
             break;
         case dt_string:
-            printf ("String: %s\n", get_eedid_string ((char *)desc->desc.data));
+            do_printf ("String: %s\n", get_eedid_string ((char *)desc->desc.data));
             break;
         case dt_name:
-            printf ("Name: %s\n", get_eedid_string ((char *)desc->desc.data));
+            do_printf ("Name: %s\n", get_eedid_string ((char *)desc->desc.data));
             break;
         default:
-            printf ("Unhandled tag 0x%02x\n", desc->desc.tag);
+            do_printf ("Unhandled tag 0x%02x\n", desc->desc.tag);
         }
 }
 
@@ -146,7 +151,7 @@ static void print_base_eedid (const struct eedid_t * eedid) {
             return;
 
     version = 1000*eedid->edid_version + eedid->edid_revision;
-    printf ("EDID Version %d.%d, checksum %sok\n",
+    do_printf ("EDID Version %d.%d, checksum %sok\n",
             eedid->edid_version,
             eedid->edid_revision,
             csum ? "not ": "");
@@ -157,7 +162,7 @@ static void print_base_eedid (const struct eedid_t * eedid) {
     vendor[2] = (manufacturer & 31) + '@';
     vendor[3] = 0;
 /* XXX Check for extended info from extra blocks in 1.1+ */
-    printf ("Vendor: %s Product: %d",
+    do_printf ("Vendor: %s Product: %d",
             vendor,
             le16toh (eedid->id_product_code));
     switch (eedid->id_serial_number) {
@@ -165,137 +170,137 @@ static void print_base_eedid (const struct eedid_t * eedid) {
     case 0x01010101:
         break;
     default:
-        printf (" Serial number: %d (%x)", le32toh (eedid->id_serial_number),
+        do_printf (" Serial number: %d (%x)", le32toh (eedid->id_serial_number),
                 eedid->id_serial_number);
     }
-    printf ("\n");
+    do_printf ("\n");
     if (eedid->year_of_manufacture) {
         switch (eedid->week_of_manufacture) {
         case 0x00:
-            printf ("Manufacture year: %d\n",
+            do_printf ("Manufacture year: %d\n",
                     1990+eedid->year_of_manufacture);
             break;
         case 0xff:
-            printf ("Model Year: %d\n", 1990+eedid->year_of_manufacture);
+            do_printf ("Model Year: %d\n", 1990+eedid->year_of_manufacture);
             break;
         default:
             if (eedid->week_of_manufacture < 0x37)
-                printf ("Manufacture date: Week %d/%d\n",
+                do_printf ("Manufacture date: Week %d/%d\n",
                         eedid->week_of_manufacture,
                         1990+eedid->year_of_manufacture);
         }
     }
 
     if (!is_digital) {
-        printf ("Analog Interface, voltage level %s, ",
+        do_printf ("Analog Interface, voltage level %s, ",
                 voltagelevelstrings [(eedid->video_input_definition >> 5) & 3]);
         if (eedid->video_input_definition & 16)
-            printf ("blank-to-black setup/pedestal\n");
-        else printf ("blank level = black level\n");
+            do_printf ("blank-to-black setup/pedestal\n");
+        else do_printf ("blank level = black level\n");
         if (eedid->video_input_definition & 8)
-            printf ("  Separate H&V Sync supported\n");
+            do_printf ("  Separate H&V Sync supported\n");
         if (eedid->video_input_definition & 4)
-            printf ("  Composite Sync on HSync supported\n");
+            do_printf ("  Composite Sync on HSync supported\n");
         if (eedid->video_input_definition & 2)
-            printf ("  Sync on Green supported\n");
+            do_printf ("  Sync on Green supported\n");
         if (eedid->video_input_definition & 1)
-            printf ("  Serration on VSync supported");
+            do_printf ("  Serration on VSync supported");
     } else {
-        printf ("Digital Interface");
+        do_printf ("Digital Interface");
         switch (version) {
         case v13:
             if (eedid->video_input_definition & 1)
-                printf (", compatible with VESA DFP 1.x TMDS");
+                do_printf (", compatible with VESA DFP 1.x TMDS");
             break;
         case v14:
             if ((eedid->video_input_definition & 15) &&
                 ((eedid->video_input_definition & 15) < 15))
-                printf (", type %s",
+                do_printf (", type %s",
                         ifnames[eedid->video_input_definition & 15]);
             if (((eedid->video_input_definition >> 4) & 7) &&
                 (((eedid->video_input_definition >> 4) & 7) < 7))
-                printf (", %d bits per primary color",
+                do_printf (", %d bits per primary color",
                         bppvalues[(eedid->video_input_definition >> 4) & 7]);
             break;
         }
-        printf ("\n");
+        do_printf ("\n");
     }
 
     if (eedid->horz_size_ar && eedid->vert_size_ar) {
-        printf ("Screen size: %dx%dcm\n",
+        do_printf ("Screen size: %dx%dcm\n",
                 eedid->horz_size_ar, eedid->vert_size_ar);
     } else if (version >= v14 && eedid->horz_size_ar) {
-        printf ("Landscape display, aspect ratio ");
+        do_printf ("Landscape display, aspect ratio ");
         switch (eedid->horz_size_ar) {
             /* Stored Value = (Aspect Ratio * 100) - 99 */
-        case 26: printf ("5:4\n"); break;
-        case 34: printf ("4:3\n"); break;
-        case 61: printf ("16:10\n"); break;
-        case 79: printf ("16:9\n"); break;
-        default: printf ("%4.2f:1\n",
+        case 26: do_printf ("5:4\n"); break;
+        case 34: do_printf ("4:3\n"); break;
+        case 61: do_printf ("16:10\n"); break;
+        case 79: do_printf ("16:9\n"); break;
+        default: do_printf ("%4.2f:1\n",
                          ((float)eedid->horz_size_ar + 99.0) / 100.0);
         }
     } else if (version >= v14 && eedid->vert_size_ar) {
-        printf ("Portrait display, aspect ratio ");
+        do_printf ("Portrait display, aspect ratio ");
         switch (eedid->horz_size_ar) {
             /* Stored Value = (100 / Aspect Ratio) - 99 */
-        case 26: printf ("5:4\n"); break;
-        case 34: printf ("3:4\n"); break;
-        case 61: printf ("10:16\n"); break;
-        case 79: printf ("9:16\n"); break;
-        default: printf ("%4.2f:1\n",
+        case 26: do_printf ("5:4\n"); break;
+        case 34: do_printf ("3:4\n"); break;
+        case 61: do_printf ("10:16\n"); break;
+        case 79: do_printf ("9:16\n"); break;
+        default: do_printf ("%4.2f:1\n",
                          100 / ((float)eedid->horz_size_ar + 99.0));
         }
     }
 
     /* XXX Gamma = 0xff means take from extended block */
     if (eedid->gamma)
-        printf ("Gamma: %4.2f\n", ((float)eedid->gamma + 100.0) / 100.0);
+        do_printf ("Gamma: %4.2f\n", ((float)eedid->gamma + 100.0) / 100.0);
 
     switch ((eedid->features >> 5) & 7) {
-    case 0: printf ("No power mananagement support.\n"); break;
-    case 1: printf ("DPM compliant power management.\n"); break;
+    case 0: do_printf ("No power mananagement support.\n"); break;
+    case 1: do_printf ("DPM compliant power management.\n"); break;
     default:
-        printf ("DPMS compliant power management, supported modes:");
-        if (eedid->features & 128) printf (" Standby");
-        if (eedid->features & 64) printf (" Suspend");
-        if (eedid->features & 32) printf (" Active-Off");
-        printf ("\n");
+        do_printf ("DPMS compliant power management, supported modes:");
+        if (eedid->features & 128) do_printf (" Standby");
+        if (eedid->features & 64) do_printf (" Suspend");
+        if (eedid->features & 32) do_printf (" Active-Off");
+        do_printf ("\n");
     }
     switch (version) {
     case v14:
         if (is_digital)
-            printf ("Color Encoding: %s\n",
+            do_printf ("Color Encoding: %s\n",
                     colorformatnames[(eedid->features >> 3) & 3]);
         else
-            printf ("Color Type: %s\n",
+            do_printf ("Color Type: %s\n",
                     colortypenames[(eedid->features >> 3) & 3]);
-        printf ("sRGB is%s the default color space.\n",
+        do_printf ("sRGB is%s the default color space.\n",
                 (eedid->features & 4) ? "" : " not");
-        printf ("Preferred timing does%s include the native pixel format and refresh rate.\n",
+        do_printf ("Preferred timing does%s include the native pixel format and refresh rate.\n",
                 (eedid->features & 2) ? "" : " not");
-        printf ("Display is of %scontinuous frequency type.\n",
+        do_printf ("Display is of %scontinuous frequency type.\n",
                 (eedid->features & 1) ? "" : " non-");
         break;
     default:
-        printf ("Color Type: %s\n",
+        do_printf ("Color Type: %s\n",
                 colortypenames[(eedid->features >> 3) & 3]);
-        printf ("sRGB is%s the default color space.\n",
+        do_printf ("sRGB is%s the default color space.\n",
                 (eedid->features & 4) ? "" : " not");
         if (eedid->features & 2)
-            printf ("First detailed timing is preferred timing.\n");
+            do_printf ("First detailed timing is preferred timing.\n");
         if (eedid->features & 1)
-            printf ("Display supports timings based on default GTF standard values.\n");
+            do_printf ("Display supports timings based on default GTF standard values.\n");
     }
     ctf = eedid->features & 1;
 
     for (i=0; i<16; i++)
         if (be16toh (eedid->established_timings) & (1 << i))
-            printf ("Supported Established Timing: %s\n",
+            do_printf ("Supported Established Timing: %s\n",
                     establishedtimingnames[i]);
     for (i=0; i<8; i++)
         if (be16toh (eedid->manufacturer_timings) & (1 << i))
-            printf ("Supported Manufacturer's Timing: %s\n",
+            do_printf ("Supported Manufacturer's Timing: %s\n",
                     manufacturertimingnames[i]);
     for (i=0; i<8; i++) {
         int x, y, r;
@@ -327,7 +332,7 @@ static void print_base_eedid (const struct eedid_t * eedid) {
                 y = 768;
             }
             r = (be16toh (eedid->standard_timings[i]) & 63) + 60;
-            printf ("Supported Standard Timing: %dx%d@%d\n", x, y, r);
+            do_printf ("Supported Standard Timing: %dx%d@%d\n", x, y, r);
         }
     }
 
@@ -343,7 +348,7 @@ static void handle_extended_cea (const unsigned char * data) {
     case cea_colorimetry:
         break;
     default:
-        printf ("Unhandled CEA Extended Data Block id %d length %d\n",
+        do_printf ("Unhandled CEA Extended Data Block id %d length %d\n",
                 type, length);
     }
 }
@@ -351,30 +356,30 @@ static void handle_extended_cea (const unsigned char * data) {
 static void handle_cea_audio (const unsigned char * data, int length) {
     int i = 0;
 
-    printf ("CEA Audio Data Block\n");
+    do_printf ("CEA Audio Data Block\n");
     while (i < length-2) {
         int format = (data[i] >> 3) & 15;
         if (format == 0xf) format = ((data[i+2] >> 3) & 31) + 15;
-        printf ("  Codec %s, max %d channels",
+        do_printf ("  Codec %s, max %d channels",
                 cea861_audio_format_name[format],
                 (data[i] & 7) + 1);
-        if (data[i+1] & 0x01) printf (", 32kHz");
-        if (data[i+1] & 0x02) printf (", 44.1kHz");
-        if (data[i+1] & 0x04) printf (", 48kHz");
-        if (data[i+1] & 0x08) printf (", 88.2kHz");
-        if (data[i+1] & 0x10) printf (", 96kHz");
-        if (data[i+1] & 0x20) printf (", 176.4kHz");
-        if (data[i+1] & 0x40) printf (", 192kHz");
+        if (data[i+1] & 0x01) do_printf (", 32kHz");
+        if (data[i+1] & 0x02) do_printf (", 44.1kHz");
+        if (data[i+1] & 0x04) do_printf (", 48kHz");
+        if (data[i+1] & 0x08) do_printf (", 88.2kHz");
+        if (data[i+1] & 0x10) do_printf (", 96kHz");
+        if (data[i+1] & 0x20) do_printf (", 176.4kHz");
+        if (data[i+1] & 0x40) do_printf (", 192kHz");
 
         if (format == cea_audio_lpcm) {
-            if (data[i+2] & 0x01) printf (", 16bit");
-            if (data[i+2] & 0x02) printf (", 20bit");
-            if (data[i+2] & 0x04) printf (", 24bit");
+            if (data[i+2] & 0x01) do_printf (", 16bit");
+            if (data[i+2] & 0x02) do_printf (", 20bit");
+            if (data[i+2] & 0x04) do_printf (", 24bit");
         } else if (format >= cea_audio_ac3 && format <= cea_audio_atrac) {
-            printf (", maximum bitrate %dkbit", 8*data[i+2]);
+            do_printf (", maximum bitrate %dkbit", 8*data[i+2]);
         } else if (format == cea_audio_wmapro)
-            printf (", Profile %d", data[i+2] & 7);
-        printf ("\n");
+            do_printf (", Profile %d", data[i+2] & 7);
+        do_printf ("\n");
         i+=3;
     }
 }
@@ -382,10 +387,10 @@ static void handle_cea_audio (const unsigned char * data, int length) {
 static void handle_cea_video (const unsigned char * data, int length) {
     int i = 0;
 
-    printf ("CEA Video Data Block\n");
+    do_printf ("CEA Video Data Block\n");
     for (i=0; i<length; i++) {
         unsigned int mode = (data[i] & 127) - 1;
-        printf ("  CEA Timing %s%s\n",
+        do_printf ("  CEA Timing %s%s\n",
                 (mode < 64) ? cea_mode_names [mode] : "(unknown)",
                 data[i] & 128 ? " (native)" : "");
     }
@@ -396,13 +401,13 @@ static void handle_cea_vendor_hdmi (const unsigned char * data, int length) {
     uint16_t address = le16toh (hdmi->phys_address);
     int printed = 0;
 
-    printf ("HDMI Vendor Specific Data Block\n");
-    printf ("  HDMI address %0x.%0x.%0x.%0x \n",
+    do_printf ("HDMI Vendor Specific Data Block\n");
+    do_printf ("  HDMI address %0x.%0x.%0x.%0x \n",
             (address >> 4) & 15, address & 15,
             (address >> 12) & 15, (address >> 8) & 15);
     if (hdmi->video_flags) {
-        printf ("  Supports ");
-#define lprint(x) printf ("%s%s", printed++ ? ", ": "", x)
+        do_printf ("  Supports ");
+#define lprint(x) do_printf ("%s%s", printed++ ? ", ": "", x)
         if (hdmi->video_flags & 0x80) lprint ("ACP/ISRC1/ISRC2 packets");
         if (hdmi->video_flags & 0x40) lprint ("48bpp");
         if (hdmi->video_flags & 0x20) lprint ("36bpp");
@@ -410,44 +415,44 @@ static void handle_cea_vendor_hdmi (const unsigned char * data, int length) {
         if (hdmi->video_flags & 0x08) lprint ("YCbCr in Deep Color Modes");
         if (hdmi->video_flags & 0x01) lprint ("Dual-Link DVI");
 #undef lprint
-        printf ("\n");
+        do_printf ("\n");
     }
     if (hdmi->max_tmds_clock)
-        printf ("  Maximum TMDS clock: %dMHz\n", 5*hdmi->max_tmds_clock);
+        do_printf ("  Maximum TMDS clock: %dMHz\n", 5*hdmi->max_tmds_clock);
     switch (hdmi->latency_fields & 0xc0) {
     case 0x00:
         break;
     case 0x40:
-        printf ("  Invalid latency flag.\n");
+        do_printf ("  Invalid latency flag.\n");
         break;
     case 0x80:
-        printf ("  Latency: ");
+        do_printf ("  Latency: ");
         if (hdmi->video_latency && hdmi->video_latency<255)
-            printf ("Video: %dms", (hdmi->video_latency-1) * 2);
+            do_printf ("Video: %dms", (hdmi->video_latency-1) * 2);
         if (hdmi->audio_latency && hdmi->audio_latency<255)
-            printf ("%sAudio: %dms",
+            do_printf ("%sAudio: %dms",
                     (hdmi->video_latency && hdmi->video_latency<255)?" ":"",
                     (hdmi->audio_latency-1) * 2);
-        printf ("\n");
+        do_printf ("\n");
         break;
     case 0xc0:
-        printf ("  Latency for progressive operation: ");
+        do_printf ("  Latency for progressive operation: ");
         if (hdmi->video_latency && hdmi->video_latency<255)
-            printf ("Video: %dms", (hdmi->video_latency-1) * 2);
+            do_printf ("Video: %dms", (hdmi->video_latency-1) * 2);
         if (hdmi->audio_latency && hdmi->audio_latency<255)
-            printf ("%sAudio: %dms",
+            do_printf ("%sAudio: %dms",
                     (hdmi->video_latency && hdmi->video_latency<255)?" ":"",
                     (hdmi->audio_latency-1) * 2);
-        printf ("\n");
-        printf ("  Latency for interlaced operation: ");
+        do_printf ("\n");
+        do_printf ("  Latency for interlaced operation: ");
         if (hdmi->interlaced_video_latency && hdmi->interlaced_video_latency<255)
-            printf ("Video: %dms", (hdmi->interlaced_video_latency-1) * 2);
+            do_printf ("Video: %dms", (hdmi->interlaced_video_latency-1) * 2);
         if (hdmi->interlaced_audio_latency && hdmi->interlaced_audio_latency<255)
-            printf ("%sAudio: %dms",
+            do_printf ("%sAudio: %dms",
                     (hdmi->interlaced_video_latency &&
                      hdmi->interlaced_video_latency<255)?" ":"",
                     (hdmi->interlaced_audio_latency-1) * 2);
-        printf ("\n");
+        do_printf ("\n");
         break;
     }
 }
@@ -461,7 +466,7 @@ void handle_cea_vendor (const unsigned char * data, int length) {
     if (vendor->id_lo == 0x03 && vendor->id_mid == 0x0c && vendor->id_hi == 0x00)
         handle_cea_vendor_hdmi (data+3, length-3);
     else
-        printf ("Unknown Vendor %02x%02x%02x Specific Data Block\n",
+        do_printf ("Unknown Vendor %02x%02x%02x Specific Data Block\n",
                 vendor->id_hi, vendor->id_mid, vendor->id_lo);
 }
 
@@ -471,8 +476,8 @@ void handle_cea_speaker (const unsigned char * data, int length) {
     if (length != 3)
         return;
 
-    printf ("CEA Speaker Data Block\n");
-#define lprint(x) printf ("%s%s", printed++ ? ", ": "  ", x)
+    do_printf ("CEA Speaker Data Block\n");
+#define lprint(x) do_printf ("%s%s", printed++ ? ", ": "  ", x)
     if (data[0] & 0x01) lprint ("Front Right/Left");
     if (data[0] & 0x02) lprint ("LFE");
     if (data[0] & 0x04) lprint ("Front Center");
@@ -485,7 +490,7 @@ void handle_cea_speaker (const unsigned char * data, int length) {
     if (data[1] & 0x02) lprint ("Top Center");
     if (data[1] & 0x04) lprint ("Front Center High");
 #undef lprint
-    printf ("\n");
+    do_printf ("\n");
 }
 
 static void handle_cea (const unsigned char * data) {
@@ -509,7 +514,7 @@ static void handle_cea (const unsigned char * data) {
         handle_extended_cea (data);
         break;
     default:
-        printf ("Unhandled CEA Data block id %d length %d\n", type, length);
+        do_printf ("Unhandled CEA Data block id %d length %d\n", type, length);
     }
 }
 
@@ -521,7 +526,7 @@ static void print_cea861 (const struct eedid_ext_cea861 * ext) {
         csum += ((uint8_t *)ext)[i];
     csum &= 255;
 
-    printf ("CEA-681 Data Structure Version %d, checksum %sok\n",
+    do_printf ("CEA-681 Data Structure Version %d, checksum %sok\n",
             ext->version,
             csum?"not ":"");
     if (csum)
@@ -529,24 +534,24 @@ static void print_cea861 (const struct eedid_ext_cea861 * ext) {
 
     if (ext->flags & 240) {
         int printed = 0;
-        printf ("Device ");
+        do_printf ("Device ");
         if (ext->flags & 0x80) {
-            printf ("underscans IT video formats");
+            do_printf ("underscans IT video formats");
             printed = 1;
         }
         if (ext->flags & 0x70)
-            printf ("%ssupports ", printed ? ", " : "");
+            do_printf ("%ssupports ", printed ? ", " : "");
         if (ext->flags & 0x40) {
-            printf ("audio");
+            do_printf ("audio");
             printed = 2;
         }
         if (ext->flags & 0x30) {
-            printf ("%sYCbCr 4:4:4 / 4:2:2", printed == 2? ", " : "");
+            do_printf ("%sYCbCr 4:4:4 / 4:2:2", printed == 2? ", " : "");
             if ((ext->flags & 0x30) != 0x30)
-                printf ("\nWarning: invalid YCbCr support (0x02%x != 0x30)",
+                do_printf ("\nWarning: invalid YCbCr support (0x02%x != 0x30)",
                         ext->flags & 0x30);
         }
-        printf ("\n");
+        do_printf ("\n");
     }
 
     for (i=0; i<n; i++)
@@ -566,34 +571,268 @@ static void handle_extension (const unsigned char * data) {
     case ext_cea861:
         print_cea861 ((struct eedid_ext_cea861 *)data);
         break;
+    case ext_blockmap:
+        /* only lists the tags of the following blocks */
+        break;
     default:
-        printf ("Unhandled extension %02x\n", data[0]);
+        do_printf ("Unhandled extension %02x\n", data[0]);
     }
 }
 
 int get_eedid_memreq (const struct eedid_t * eeprom, int length) {
-    int needed_length;
-    needed_length = 128*(eeprom->extension_block_count+1);
-
-    if (needed_length > 256) {
-      printf ("Warning: eeprom reader >256 needed.\n");
-      return 256;
-    }
-    return needed_length;
+    return 128*(eeprom->extension_block_count+1);
 }
 
 void do_eedid (const struct eedid_t * eeprom, int length) {
+    int i, blocks = length/128 - 1;
+
+    PROBE2 (do_eedid_entry, eeprom, length);
     print_base_eedid (eeprom);
 
-    if (length < 128*(eeprom->extension_block_count+1)) {
-        printf ("Warning: %d bytes expected, only %d bytes passed!\n",
-                128*(eeprom->extension_block_count+1), length);
+    /* decode the extensions that were read, even if some are missing */
+    if (blocks > eeprom->extension_block_count)
+        blocks = eeprom->extension_block_count;
+    for (i=1; i<=blocks; i++)
+        handle_extension ((unsigned char *)eeprom+128*i);
+    if (blocks < eeprom->extension_block_count) {
+        do_printf ("Warning: %d bytes expected, only %d bytes passed, "
+                   "%d of %d extension blocks decoded!\n",
+                   128*(eeprom->extension_block_count+1), length,
+                   blocks, eeprom->extension_block_count);
+        PROBE2 (do_eedid_return, eeprom, 0);
+        return;
+    }
+    PROBE2 (do_eedid_return, eeprom, 1);
+}
+
+/* Mode of a detailed timing; 0 if it is none */
+static int dtd_timing (const struct detailed_timing_t * dtd,
+                       struct edid_timing * timing) {
+    int htotal, vtotal;
+
+    if (!dtd->pixel_clock)
+        return 0;
+    timing->width = dtd->horz_act_lo +
+        (((int)(dtd->horz_act_blank_hi >> 4) & 15) << 8);
+    htotal = timing->width + dtd->horz_blank_lo +
+        ((int)(dtd->horz_act_blank_hi & 15) << 8);
+    timing->height = dtd->vert_act_lo +
+        (((int)(dtd->vert_act_blank_hi >> 4) & 15) << 8);
+    vtotal = timing->height + dtd->vert_blank_lo +
+        ((int)(dtd->vert_act_blank_hi & 15) << 8);
+    if (!htotal || !vtotal)
+        return 0;
+    timing->pixel_clock = 10*le16toh (dtd->pixel_clock);
+    timing->refresh = round (le16toh (dtd->pixel_clock) * 10000.0 / htotal / vtotal);
+    return 1;
+}
+
+static void dtd_caps (const struct detailed_timing_t * dtd,
+                      struct eedid_caps * caps) {
+    struct edid_timing t;
+
+    if (!dtd_timing (dtd, &t))
+        return;
+    if (t.width * t.height > caps->width * caps->height ||
+        (t.width * t.height == caps->width * caps->height && t.refresh > caps->refresh)) {
+        caps->width = t.width;
+        caps->height = t.height;
+        caps->refresh = t.refresh;
+    }
+}
+
+static void cea_caps (const struct eedid_ext_cea861 * ext,
+                      struct eedid_caps * caps) {
+    const struct cea861_vendor * vendor;
+    const struct cea861_vendor_hdmi * hdmi;
+    int n = (127 - ext->_18b_start) / 18;
+    int i, j, type, length, vic;
+
+    /* 0 means neither detailed timings nor data blocks */
+    if (ext->_18b_start < 4)
+        return;
+    for (i=0; i<n; i++)
+        dtd_caps ((struct detailed_timing_t *)&ext->data[ext->_18b_start - 4 + 18*i],
+                  caps);
+
+    if (ext->version < 3)
         return;
+    for (i = 0; i < ext->_18b_start - 4 && i < 123; i += 1 + length) {
+        type = (ext->data[i] >> 5) & 7;
+        length = ext->data[i] & 31;
+        if (i + 1 + length > 123)
+            break;
+        switch (type) {
+        case cea_video:
+            for (j = 0; j < length; j++) {
+                vic = ext->data[i+1+j];
+                /* bit 7 flags native modes for VICs 1-64 */
+                if (vic >= 129 && vic <= 192)
+                    vic &= 127;
+                if (vic < 128)
+                    caps->vics[vic >> 3] |= 1 << (vic & 7);
+            }
+            break;
+        case cea_vendor:
+            vendor = (struct cea861_vendor *)&ext->data[i+1];
+            if (length < 3 || vendor->id_lo != 0x03 || vendor->id_mid != 0x0c ||
+                vendor->id_hi != 0x00)
+                break;
+            caps->hdmi = 1;
+            hdmi = (struct cea861_vendor_hdmi *)&ext->data[i+4];
+            if (length >= 7 && hdmi->max_tmds_clock)
+                caps->max_tmds = 5*hdmi->max_tmds_clock;
+            break;
+        }
+    }
+}
+
+/* Summarise the capabilities of a display without printing anything */
+void get_eedid_caps (const struct eedid_t * eedid, int length,
+                     struct eedid_caps * caps) {
+    const union eighteen_bytes_descriptor_t * desc;
+    uint16_t manufacturer;
+    int i;
+
+    memset (caps, 0, sizeof (*caps));
+    manufacturer = be16toh (eedid->id_manufacturer_name);
+    caps->vendor[0] = ((manufacturer >> 10) & 31) + '@';
+    caps->vendor[1] = ((manufacturer >> 5) & 31) + '@';
+    caps->vendor[2] = (manufacturer & 31) + '@';
+    caps->product = le16toh (eedid->id_product_code);
+    caps->digital = (eedid->video_input_definition & 128) == 128;
+    if (caps->digital && eedid->edid_version == 1 && eedid->edid_revision >= 4)
+        caps->interface = eedid->video_input_definition & 15;
+
+    for (i=0; i<4; i++) {
+        desc = &eedid->detailed_timings[i];
+        if (desc->timing.pixel_clock)
+            dtd_caps (&desc->timing, caps);
+        else if (desc->desc.tag == dt_name)
+            strcpy (caps->name, get_eedid_string ((char *)desc->desc.data));
+    }
+
+    for (i=1; i<=eedid->extension_block_count && 128*(i+1) <= length; i++)
+        if (((unsigned char *)eedid)[128*i] == ext_cea861)
+            cea_caps ((struct eedid_ext_cea861 *)((unsigned char *)eedid+128*i),
+                      caps);
+}
+
+/* Whether a display offers a mode at least as large and as fast */
+int eedid_caps_mode (const struct eedid_caps * caps,
+                     int width, int height, int refresh) {
+    int vic;
+
+    if (caps->width >= width && caps->height >= height &&
+        caps->refresh >= refresh)
+        return 1;
+    for (vic = 1; vic <= ARRAY_SIZE (cea_vic_modes); vic++)
+        if ((caps->vics[vic >> 3] & (1 << (vic & 7))) &&
+            cea_vic_modes[vic-1].width >= width &&
+            cea_vic_modes[vic-1].height >= height &&
+            cea_vic_modes[vic-1].refresh >= refresh)
+            return 1;
+    return 0;
+}
+
+/* The data blocks of a CEA extension, counted only if blocks is NULL */
+static int cea_blocks (const struct eedid_ext_cea861 * ext,
+                       struct cea_block * blocks, struct arena * arena) {
+    int i, length, n = 0;
+    unsigned char * data;
+
+    if (ext->_18b_start < 4 || ext->version < 3)
+        return 0;
+    for (i = 0; i < ext->_18b_start - 4 && i < 123; i += 1 + length) {
+        length = ext->data[i] & 31;
+        if (i + 1 + length > 123)
+            break;
+        if (blocks) {
+            if (!(data = arena_alloc (arena, length ? length : 1)))
+                return -1;
+            memcpy (data, &ext->data[i+1], length);
+            blocks[n].tag = (ext->data[i] >> 5) & 7;
+            blocks[n].length = length;
+            blocks[n].data = data;
+        }
+        n++;
+    }
+    return n;
+}
+
+struct decoded_record * get_eedid_record (const struct eedid_t * eedid, int length,
+                                          struct arena * arena) {
+    const union eighteen_bytes_descriptor_t * desc;
+    const struct eedid_ext_cea861 * ext;
+    struct decoded_record * record;
+    struct edid_record * edid;
+    struct eedid_caps caps;
+    int i, j, n, blocks;
+
+    if (length < 128 || !(record = arena_calloc (arena, sizeof (*record))))
+        return NULL;
+    record->kind = RECORD_EDID;
+    edid = &record->edid;
+    get_eedid_caps (eedid, length, &caps);
+    memcpy (edid->vendor, caps.vendor, sizeof (edid->vendor));
+    edid->product = caps.product;
+    edid->digital = caps.digital;
+    edid->interface = caps.interface;
+    edid->serial = le32toh (eedid->id_serial_number);
+    /* week 255 flags a model year */
+    if (eedid->year_of_manufacture) {
+        edid->year = eedid->year_of_manufacture + 1990;
+        edid->week = eedid->week_of_manufacture == 255 ? 0 : eedid->week_of_manufacture;
+    }
+    edid->version = eedid->edid_version;
+    edid->revision = eedid->edid_revision;
+    edid->name = edid->serial_string = "";
+    edid->extensions = eedid->extension_block_count;
+    blocks = 128*(eedid->extension_block_count+1) <= length ?
+        eedid->extension_block_count : length/128 - 1;
+
+    /* 4 detailed timings in the base block and up to 6 in each extension */
+    if (!(edid->timings = arena_alloc (arena, (4 + 6*blocks) * sizeof (*edid->timings))))
+        return NULL;
+    for (i=0; i<4; i++) {
+        desc = &eedid->detailed_timings[i];
+        if (desc->timing.pixel_clock)
+            edid->num_timings += dtd_timing (&desc->timing, &edid->timings[edid->num_timings]);
+        else if (desc->desc.tag == dt_name || desc->desc.tag == dt_serial) {
+            const char * string = arena_strndup (arena, get_eedid_string ((char *)desc->desc.data), 13);
+
+            if (!string)
+                return NULL;
+            if (desc->desc.tag == dt_name)
+                edid->name = string;
+            else
+                edid->serial_string = string;
+        }
     }
-    if (eeprom->extension_block_count == 1) {
-      handle_extension ((unsigned char *)eeprom+128);
-    } else if (eeprom->extension_block_count > 1) {
-        printf ("More than one Extension (%d found) not supported.\n",
-                eeprom->extension_block_count);
+
+    for (i=1, n=0; i<=blocks; i++) {
+        ext = (const struct eedid_ext_cea861 *)((const unsigned char *)eedid+128*i);
+        if (ext->tag == ext_cea861)
+            n += cea_blocks (ext, NULL, NULL);
     }
+    if (!(edid->cea_blocks = arena_alloc (arena, (n ? n : 1) * sizeof (*edid->cea_blocks))))
+        return NULL;
+    for (i=1; i<=blocks; i++) {
+        ext = (const struct eedid_ext_cea861 *)((const unsigned char *)eedid+128*i);
+        if (ext->tag != ext_cea861)
+            continue;
+        if (ext->_18b_start >= 4)
+            for (j=0; j<(127 - ext->_18b_start) / 18; j++)
+                edid->num_timings += dtd_timing (
+                    (struct detailed_timing_t *)&ext->data[ext->_18b_start - 4 + 18*j],
+                    &edid->timings[edid->num_timings]);
+        if ((n = cea_blocks (ext, edid->cea_blocks + edid->num_cea_blocks, arena)) < 0)
+            return NULL;
+        edid->num_cea_blocks += n;
+    }
+    return record;
+}
+
+const char * eedid_interface_name (int interface) {
+    return ifnames[interface & 15];
 }
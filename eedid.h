@@ -2,5 +2,29 @@
 
 #include "eedid_struct.h"
 
+struct decoded_record;
+struct arena;
+
 int get_eedid_memreq (const struct eedid_t * eeprom, int length);
 void do_eedid (const struct eedid_t * eeprom, int length);
+
+/* what a display model supports, as far as fleet wide queries care */
+struct eedid_caps {
+    char vendor[4];             /* PNP id */
+    int product;
+    char name[14];
+    int digital;
+    int interface;              /* ifnames[] index, EDID 1.4 only */
+    int hdmi;                   /* has an HDMI vendor specific data block */
+    int max_tmds;               /* MHz, 0 if not given */
+    int width, height, refresh; /* largest detailed timing */
+    unsigned char vics[16];     /* bitmap of the CEA video modes 1-127 */
+};
+
+void get_eedid_caps (const struct eedid_t * eeprom, int length,
+                     struct eedid_caps * caps);
+int eedid_caps_mode (const struct eedid_caps * caps,
+                     int width, int height, int refresh);
+const char * eedid_interface_name (int interface);
+struct decoded_record * get_eedid_record (const struct eedid_t * eeprom, int length,
+                                          struct arena * arena);
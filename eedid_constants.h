@@ -205,3 +205,35 @@ static const char * cea_mode_names[] = {
     "1920x1080p@100Hz DAR: 16:9 PAR: 16:9 1:1",
 };
 
+/* active size and field rate of the CEA video modes, indexed by VIC - 1;
+   the comments give the VIC at the start of each line */
+static const struct { short width, height, refresh; } cea_vic_modes[] = {
+    {  640,  480,  60 }, {  720,  480,  60 }, {  720,  480,  60 }, { 1280,  720,  60 },  /* 1 */
+    { 1920, 1080,  60 }, {  720,  480,  60 }, {  720,  480,  60 }, {  720,  240,  60 },  /* 5 */
+    {  720,  240,  60 }, { 2880,  480,  60 }, { 2880,  480,  60 }, { 2880,  240,  60 },  /* 9 */
+    { 2880,  240,  60 }, { 1440,  480,  60 }, { 1440,  480,  60 }, { 1920, 1080,  60 },  /* 13 */
+    {  720,  576,  50 }, {  720,  576,  50 }, { 1280,  720,  50 }, { 1920, 1080,  50 },  /* 17 */
+    {  720,  576,  50 }, {  720,  576,  50 }, {  720,  288,  50 }, {  720,  288,  50 },  /* 21 */
+    { 2880,  576,  50 }, { 2880,  576,  50 }, { 2880,  288,  50 }, { 2880,  288,  50 },  /* 25 */
+    { 1440,  576,  50 }, { 1440,  576,  50 }, { 1920, 1080,  50 }, { 1920, 1080,  24 },  /* 29 */
+    { 1920, 1080,  25 }, { 1920, 1080,  30 }, { 2880,  480,  60 }, { 2880,  480,  60 },  /* 33 */
+    { 2880,  576,  50 }, { 2880,  576,  50 }, { 1920, 1080,  50 }, { 1920, 1080, 100 },  /* 37 */
+    { 1280,  720, 100 }, {  720,  576, 100 }, {  720,  576, 100 }, {  720,  576, 100 },  /* 41 */
+    {  720,  576, 100 }, { 1920, 1080, 120 }, { 1280,  720, 120 }, {  720,  480, 120 },  /* 45 */
+    {  720,  480, 120 }, {  720,  480, 120 }, {  720,  480, 120 }, {  720,  576, 200 },  /* 49 */
+    {  720,  576, 200 }, {  720,  576, 200 }, {  720,  576, 200 }, {  720,  480, 240 },  /* 53 */
+    {  720,  480, 240 }, {  720,  480, 240 }, {  720,  480, 240 }, { 1280,  720,  24 },  /* 57 */
+    { 1280,  720,  25 }, { 1280,  720,  30 }, { 1920, 1080, 120 }, { 1920, 1080, 100 },  /* 61 */
+    { 1280,  720,  24 }, { 1280,  720,  25 }, { 1280,  720,  30 }, { 1280,  720,  50 },  /* 65 */
+    { 1280,  720,  60 }, { 1280,  720, 100 }, { 1280,  720, 120 }, { 1920, 1080,  24 },  /* 69 */
+    { 1920, 1080,  25 }, { 1920, 1080,  30 }, { 1920, 1080,  50 }, { 1920, 1080,  60 },  /* 73 */
+    { 1920, 1080, 100 }, { 1920, 1080, 120 }, { 1680,  720,  24 }, { 1680,  720,  25 },  /* 77 */
+    { 1680,  720,  30 }, { 1680,  720,  50 }, { 1680,  720,  60 }, { 1680,  720, 100 },  /* 81 */
+    { 1680,  720, 120 }, { 2560, 1080,  24 }, { 2560, 1080,  25 }, { 2560, 1080,  30 },  /* 85 */
+    { 2560, 1080,  50 }, { 2560, 1080,  60 }, { 2560, 1080, 100 }, { 2560, 1080, 120 },  /* 89 */
+    { 3840, 2160,  24 }, { 3840, 2160,  25 }, { 3840, 2160,  30 }, { 3840, 2160,  50 },  /* 93 */
+    { 3840, 2160,  60 }, { 4096, 2160,  24 }, { 4096, 2160,  25 }, { 4096, 2160,  30 },  /* 97 */
+    { 4096, 2160,  50 }, { 4096, 2160,  60 }, { 3840, 2160,  24 }, { 3840, 2160,  25 },  /* 101 */
+    { 3840, 2160,  30 }, { 3840, 2160,  50 }, { 3840, 2160,  60 },  /* 105 */
+};
+
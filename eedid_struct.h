@@ -198,3 +198,4 @@ struct cea861_vendor_hdmi {
     uint8_t interlaced_video_latency;
     uint8_t interlaced_audio_latency;
 };
+#pragma pack()
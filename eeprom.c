@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "constants.h"
+#include "struct.h"
+#include "sdr-ddr2.h"
+#include "ddr3.h"
+#include "ddr4.h"
+#include "eedid.h"
+#include "output.h"
+#include "trace.h"
+#include "probes.h"
+#include "eeprom.h"
+
+int is_eedid (const unsigned char *eeprom) {
+    return eeprom[0] == 0x00 && eeprom[1] == 0xff && eeprom[2] == 0xff &&
+        eeprom[3] == 0xff && eeprom[4] == 0xff && eeprom[5] == 0xff &&
+        eeprom[6] == 0xff && eeprom[7] == 0x00;
+}
+
+static int eeprom_memreq (const unsigned char *eeprom, int length) {
+    switch (eeprom[2]) {
+    case MEMTYPE_SDR:
+    case MEMTYPE_DDR:
+    case MEMTYPE_DDR2:
+    case MEMTYPE_DDR3:
+        return 256;
+    case MEMTYPE_DDR4:
+    case MEMTYPE_DDR4E:
+        return get_ddr4_memreq ((struct ddr4_sdram_spd *) eeprom, length);
+    case 0xff:
+        if (is_eedid (eeprom))
+            return get_eedid_memreq ((struct eedid_t *) eeprom, length);
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+int get_eeprom_memreq (const unsigned char *eeprom, int length) {
+    int required = eeprom_memreq (eeprom, length);
+
+    PROBE3 (memreq, eeprom[2], length, required);
+    return required;
+}
+
+int decode_eeprom (const unsigned char *eeprom, int length) {
+    uint64_t begin = trace_begin ();
+
+    switch (eeprom[2]) {
+    case MEMTYPE_SDR:
+    case MEMTYPE_DDR:
+    case MEMTYPE_DDR2:
+        do_sdram ((struct sdram_spd *) eeprom, length);
+        trace_span (begin, "decode", "do_sdram", "\"length\":%d", length);
+        break;
+    case MEMTYPE_DDR3:
+        do_ddr3 ((struct ddr3_sdram_spd *) eeprom, length);
+        trace_span (begin, "decode", "do_ddr3", "\"length\":%d", length);
+        break;
+    case MEMTYPE_DDR4:
+    case MEMTYPE_DDR4E:
+        do_ddr4 ((struct ddr4_sdram_spd *) eeprom, length);
+        trace_span (begin, "decode", "do_ddr4", "\"length\":%d", length);
+        break;
+    case 0xff:
+        if (is_eedid (eeprom)) {
+            do_eedid ((struct eedid_t *) eeprom, length);
+            trace_span (begin, "decode", "do_eedid", "\"length\":%d", length);
+        }
+        break;
+    default:
+        do_printf ("Unsupported memory type %d\n", eeprom[2]);
+        return -1;
+    }
+    return 0;
+}
+
+/* Copy a part number, dropping the padding */
+void get_part_number (char *part, const unsigned char *data, int length) {
+    int i;
+
+    for (i = 0; i < length && data[i] && data[i] != 0xff; i++)
+        part[i] = data[i];
+    while (i && part[i - 1] == ' ')
+        i--;
+    part[i] = 0;
+}
+
+/* Fill info for SPD images of the generations decoded; -1 for others */
+int get_module_info (const unsigned char *eeprom, int length,
+                     struct module_info *info) {
+    memset (info, 0, sizeof (*info));
+    if (length < 128)
+        return -1;
+    info->type = eeprom[2];
+    switch (eeprom[2]) {
+    case MEMTYPE_SDR:
+    case MEMTYPE_DDR:
+    case MEMTYPE_DDR2:
+        return get_sdram_info ((struct sdram_spd *) eeprom, length, info);
+    case MEMTYPE_DDR3:
+        return get_ddr3_info ((struct ddr3_sdram_spd *) eeprom, length, info);
+    case MEMTYPE_DDR4:
+    case MEMTYPE_DDR4E:
+        return get_ddr4_info ((struct ddr4_sdram_spd *) eeprom, length, info);
+    }
+    return -1;
+}
+
+int do_eeprom (int device, const unsigned char *eeprom, int length) {
+    do_printf ("Analyzing client 0x%02x\n", device);
+    return decode_eeprom (eeprom, length);
+}
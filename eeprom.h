@@ -0,0 +1,27 @@
+#pragma once
+
+int is_eedid (const unsigned char *eeprom);
+int get_eeprom_memreq (const unsigned char *eeprom, int length);
+int decode_eeprom (const unsigned char *eeprom, int length);
+int do_eeprom (int device, const unsigned char *eeprom, int length);
+
+/* what an inventory needs to know about a memory module */
+struct module_info {
+    int type;                   /* byte 2, MEMTYPE_* */
+    unsigned int vendor;        /* JEDEC ids as taken by get_vendor16() */
+    unsigned int dram_vendor;   /* 0 if not given */
+    char part[21];
+    int size;                   /* usable capacity in MB */
+    int ranks;
+    int device_width;           /* data bits per DRAM */
+    int ecc;
+    char voltage[40];
+    int module_type;            /* byte 3 of DDR3 and DDR4, 0 if not given */
+    int bank_groups;            /* 0 before DDR4 */
+    int tck;                    /* minimum cycle time in ps, 0 if not given */
+    int taa;                    /* minimum CAS latency time in ps */
+};
+
+void get_part_number (char *part, const unsigned char *data, int length);
+int get_module_info (const unsigned char *eeprom, int length,
+                     struct module_info *info);
@@ -0,0 +1,333 @@
+#include <stddef.h>
+
+#include "constants.h"
+#include "struct.h"
+#include "eedid_struct.h"
+#include "eeprom.h"
+#include "fields.h"
+
+#define FIELD(type, member) \
+    { #member, offsetof (struct type, member), sizeof (((struct type *) 0)->member), 0 }
+#define FIELD_TEXT(type, member) \
+    { #member, offsetof (struct type, member), sizeof (((struct type *) 0)->member), 1 }
+#define NUM_FIELDS(table) ((int) (sizeof (table) / sizeof (table[0])))
+
+/* tag of a CEA-861 extension block, see eedid_constants.h */
+#define EXT_CEA861              0x02
+
+static const struct field sdram_fields[] = {
+    FIELD (sdram_spd, bytes_written),
+    FIELD (sdram_spd, total_bytes),
+    FIELD (sdram_spd, memory_type),
+    FIELD (sdram_spd, num_row_addr),
+    FIELD (sdram_spd, num_col_addr),
+    FIELD (sdram_spd, num_ranks),
+    FIELD (sdram_spd, data_width),
+    FIELD (sdram_spd, reserved1),
+    FIELD (sdram_spd, voltage_level),
+    FIELD (sdram_spd, min_clk_cycle_cl_max_0),
+    FIELD (sdram_spd, access_from_clock),
+    FIELD (sdram_spd, config_type),
+    FIELD (sdram_spd, refresh_type),
+    FIELD (sdram_spd, primary_width),
+    FIELD (sdram_spd, error_checking_width),
+    FIELD (sdram_spd, min_clk_delay),
+    FIELD (sdram_spd, burst_length),
+    FIELD (sdram_spd, num_banks_device),
+    FIELD (sdram_spd, cas_latency),
+    FIELD (sdram_spd, cs_latency),
+    FIELD (sdram_spd, dimm_type),
+    FIELD (sdram_spd, module_attr),
+    FIELD (sdram_spd, module_attr_general),
+    FIELD (sdram_spd, min_clk_cycle_cl_max_1),
+    FIELD (sdram_spd, max_tac_cl_05),
+    FIELD (sdram_spd, min_clk_cycle_cl_max_2),
+    FIELD (sdram_spd, max_tac_cl_1),
+    FIELD (sdram_spd, min_trp),
+    FIELD (sdram_spd, min_trrd),
+    FIELD (sdram_spd, min_trcd),
+    FIELD (sdram_spd, min_tras),
+    FIELD (sdram_spd, bank_density),
+    FIELD (sdram_spd, ctrl_setup_time),
+    FIELD (sdram_spd, ctrl_hold_time),
+    FIELD (sdram_spd, data_setup_time),
+    FIELD (sdram_spd, data_hold_time),
+    FIELD (sdram_spd, reserved2),
+    FIELD (sdram_spd, trc_trfc_ext),
+    FIELD (sdram_spd, min_trc),
+    FIELD (sdram_spd, min_trfc),
+    FIELD (sdram_spd, max_tck),
+    FIELD (sdram_spd, max_tdqsq),
+    FIELD (sdram_spd, max_tqhs),
+    FIELD (sdram_spd, reserved3),
+    FIELD (sdram_spd, attr_dimm_height),
+    FIELD (sdram_spd, reserved4),
+    FIELD (sdram_spd, spd_revision),
+    FIELD (sdram_spd, checksum),
+    FIELD (sdram_spd, manufacturer_jedec_id),
+    FIELD (sdram_spd, manufacturing_location),
+    FIELD_TEXT (sdram_spd, part_number),
+    FIELD (sdram_spd, module_revision),
+    FIELD (sdram_spd, manufacturing_date),
+    FIELD (sdram_spd, serial),
+    FIELD (sdram_spd, manufacturer_specific),
+    FIELD (sdram_spd, customer_specific),
+};
+
+static const struct field ddr3_fields[] = {
+    FIELD (ddr3_sdram_spd, bytes_used_crc),
+    FIELD (ddr3_sdram_spd, spd_revision),
+    FIELD (ddr3_sdram_spd, memory_type),
+    FIELD (ddr3_sdram_spd, module_type),
+    FIELD (ddr3_sdram_spd, density_banks),
+    FIELD (ddr3_sdram_spd, adressing),
+    FIELD (ddr3_sdram_spd, voltage),
+    FIELD (ddr3_sdram_spd, organization),
+    FIELD (ddr3_sdram_spd, bus_width),
+    FIELD (ddr3_sdram_spd, ftb_dividend_divisor),
+    FIELD (ddr3_sdram_spd, mtb_dividend),
+    FIELD (ddr3_sdram_spd, mtb_divisor),
+    FIELD (ddr3_sdram_spd, min_tck),
+    FIELD (ddr3_sdram_spd, reserved1),
+    FIELD (ddr3_sdram_spd, cas_latency),
+    FIELD (ddr3_sdram_spd, min_taa),
+    FIELD (ddr3_sdram_spd, min_twr),
+    FIELD (ddr3_sdram_spd, min_trcd),
+    FIELD (ddr3_sdram_spd, min_trrd),
+    FIELD (ddr3_sdram_spd, min_trp),
+    FIELD (ddr3_sdram_spd, min_tras_trc_upper_nibble),
+    FIELD (ddr3_sdram_spd, min_tras_lsb),
+    FIELD (ddr3_sdram_spd, min_trc_lsb),
+    FIELD (ddr3_sdram_spd, min_trfc),
+    FIELD (ddr3_sdram_spd, min_twtr),
+    FIELD (ddr3_sdram_spd, min_trtp),
+    FIELD (ddr3_sdram_spd, min_tfaw_upper_nibble),
+    FIELD (ddr3_sdram_spd, min_tfaw_lsb),
+    FIELD (ddr3_sdram_spd, optional_features),
+    FIELD (ddr3_sdram_spd, thermal_refresh),
+    FIELD (ddr3_sdram_spd, thermal_sensor),
+    FIELD (ddr3_sdram_spd, device_type),
+    FIELD (ddr3_sdram_spd, reserved2),
+    FIELD (ddr3_sdram_spd, module_specific),
+    FIELD (ddr3_sdram_spd, manufacturer_jedec_id),
+    FIELD (ddr3_sdram_spd, manufacturing_location),
+    FIELD (ddr3_sdram_spd, manufacturing_date),
+    FIELD (ddr3_sdram_spd, serial_number),
+    FIELD (ddr3_sdram_spd, crc),
+    FIELD_TEXT (ddr3_sdram_spd, part_number),
+    FIELD (ddr3_sdram_spd, module_revison),
+    FIELD (ddr3_sdram_spd, dram_manufacturer_jedec_id),
+    FIELD (ddr3_sdram_spd, manufacturer_specific),
+    FIELD (ddr3_sdram_spd, xmp.id),
+    FIELD (ddr3_sdram_spd, xmp.profile_org_conf),
+    FIELD (ddr3_sdram_spd, xmp.revision),
+    FIELD (ddr3_sdram_spd, xmp.p1_mtb_dividend),
+    FIELD (ddr3_sdram_spd, xmp.p1_mtb_divisor),
+    FIELD (ddr3_sdram_spd, xmp.p2_mtb_dividend),
+    FIELD (ddr3_sdram_spd, xmp.p2_mtb_divisor),
+    FIELD (ddr3_sdram_spd, xmp.reserved),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].voltage),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_tck),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_taa),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].cas_latency),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_tcwl),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_trp),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_trcd),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_twr),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_tras_trc_upper_nibble),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_tras_lsb),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_trc_lsb),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].max_trefi),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_trfc),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_trtp),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_trrd),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_tfaw_upper_nibble),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_tfaw_lsb),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].min_twtr),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].turnaround),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].tccd_optimize),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].cmd_rate),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].self_refresh),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].reserved),
+    FIELD (ddr3_sdram_spd, xmp.profiles[0].vendor_personality),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].voltage),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_tck),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_taa),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].cas_latency),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_tcwl),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_trp),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_trcd),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_twr),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_tras_trc_upper_nibble),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_tras_lsb),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_trc_lsb),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].max_trefi),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_trfc),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_trtp),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_trrd),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_tfaw_upper_nibble),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_tfaw_lsb),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].min_twtr),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].turnaround),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].tccd_optimize),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].cmd_rate),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].self_refresh),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].reserved),
+    FIELD (ddr3_sdram_spd, xmp.profiles[1].vendor_personality),
+    FIELD (ddr3_sdram_spd, xmp.unused),
+};
+
+static const struct field ddr4_fields[] = {
+    FIELD (ddr4_sdram_spd, bytes_used_crc),
+    FIELD (ddr4_sdram_spd, spd_revision),
+    FIELD (ddr4_sdram_spd, memory_type),
+    FIELD (ddr4_sdram_spd, module_type),
+    FIELD (ddr4_sdram_spd, density_banks),
+    FIELD (ddr4_sdram_spd, adressing),
+    FIELD (ddr4_sdram_spd, primary_package),
+    FIELD (ddr4_sdram_spd, optional1),
+    FIELD (ddr4_sdram_spd, thermal_refresh),
+    FIELD (ddr4_sdram_spd, optional2),
+    FIELD (ddr4_sdram_spd, secondary_package),
+    FIELD (ddr4_sdram_spd, voltage),
+    FIELD (ddr4_sdram_spd, organization),
+    FIELD (ddr4_sdram_spd, bus_width),
+    FIELD (ddr4_sdram_spd, thermal_sensor),
+    FIELD (ddr4_sdram_spd, extended_module_type),
+    FIELD (ddr4_sdram_spd, reserved2),
+    FIELD (ddr4_sdram_spd, timebases),
+    FIELD (ddr4_sdram_spd, min_tckavg),
+    FIELD (ddr4_sdram_spd, max_tckavg),
+    FIELD (ddr4_sdram_spd, cas_latencies),
+    FIELD (ddr4_sdram_spd, min_taa),
+    FIELD (ddr4_sdram_spd, min_trcd),
+    FIELD (ddr4_sdram_spd, min_trp),
+    FIELD (ddr4_sdram_spd, min_tras_trc_upper),
+    FIELD (ddr4_sdram_spd, min_tras_lower),
+    FIELD (ddr4_sdram_spd, min_trc_lower),
+    FIELD (ddr4_sdram_spd, min_trfc1),
+    FIELD (ddr4_sdram_spd, min_trfc2),
+    FIELD (ddr4_sdram_spd, min_trfc4),
+    FIELD (ddr4_sdram_spd, min_tfaw),
+    FIELD (ddr4_sdram_spd, min_trrd_s),
+    FIELD (ddr4_sdram_spd, min_trrd_l),
+    FIELD (ddr4_sdram_spd, min_tcdd_l),
+    FIELD (ddr4_sdram_spd, reserved3),
+    FIELD (ddr4_sdram_spd, bit_mapping),
+    FIELD (ddr4_sdram_spd, reserved4),
+    FIELD (ddr4_sdram_spd, fine_min_tccd_l),
+    FIELD (ddr4_sdram_spd, fine_min_trrd_l),
+    FIELD (ddr4_sdram_spd, fine_min_trrd_s),
+    FIELD (ddr4_sdram_spd, fine_min_trc),
+    FIELD (ddr4_sdram_spd, fine_min_trp),
+    FIELD (ddr4_sdram_spd, fine_min_trcd),
+    FIELD (ddr4_sdram_spd, fine_min_taa),
+    FIELD (ddr4_sdram_spd, fine_max_tckavg),
+    FIELD (ddr4_sdram_spd, fine_min_tckavg),
+    FIELD (ddr4_sdram_spd, crc),
+    FIELD (ddr4_sdram_spd, module_specific),
+    FIELD (ddr4_sdram_spd, reserved5),
+    FIELD (ddr4_sdram_spd, manufacturer_jedec_id),
+    FIELD (ddr4_sdram_spd, manufacturing_location),
+    FIELD (ddr4_sdram_spd, manufacturing_date),
+    FIELD (ddr4_sdram_spd, serial_number),
+    FIELD_TEXT (ddr4_sdram_spd, part_number),
+    FIELD (ddr4_sdram_spd, module_revison),
+    FIELD (ddr4_sdram_spd, dram_manufacturer_jedec_id),
+    FIELD (ddr4_sdram_spd, dram_stepping),
+    FIELD (ddr4_sdram_spd, manufacturer_specific),
+    FIELD (ddr4_sdram_spd, reserved6),
+    FIELD (ddr4_sdram_spd, end_user_data),
+};
+
+static const struct field eedid_fields[] = {
+    FIELD (eedid_t, header),
+    FIELD (eedid_t, id_manufacturer_name),
+    FIELD (eedid_t, id_product_code),
+    FIELD (eedid_t, id_serial_number),
+    FIELD (eedid_t, week_of_manufacture),
+    FIELD (eedid_t, year_of_manufacture),
+    FIELD (eedid_t, edid_version),
+    FIELD (eedid_t, edid_revision),
+    FIELD (eedid_t, video_input_definition),
+    FIELD (eedid_t, horz_size_ar),
+    FIELD (eedid_t, vert_size_ar),
+    FIELD (eedid_t, gamma),
+    FIELD (eedid_t, features),
+    FIELD (eedid_t, rg_lo),
+    FIELD (eedid_t, bw_lo),
+    FIELD (eedid_t, rx_hi),
+    FIELD (eedid_t, ry_hi),
+    FIELD (eedid_t, gx_hi),
+    FIELD (eedid_t, gy_hi),
+    FIELD (eedid_t, bx_hi),
+    FIELD (eedid_t, by_hi),
+    FIELD (eedid_t, wx_hi),
+    FIELD (eedid_t, wy_hi),
+    FIELD (eedid_t, established_timings),
+    FIELD (eedid_t, manufacturer_timings),
+    FIELD (eedid_t, standard_timings),
+    FIELD (eedid_t, detailed_timings[0]),
+    FIELD (eedid_t, detailed_timings[1]),
+    FIELD (eedid_t, detailed_timings[2]),
+    FIELD (eedid_t, detailed_timings[3]),
+    FIELD (eedid_t, extension_block_count),
+    FIELD (eedid_t, checksum),
+};
+
+static const struct field cea861_fields[] = {
+    FIELD (eedid_ext_cea861, tag),
+    FIELD (eedid_ext_cea861, version),
+    FIELD (eedid_ext_cea861, _18b_start),
+    FIELD (eedid_ext_cea861, flags),
+    FIELD (eedid_ext_cea861, data),
+    FIELD (eedid_ext_cea861, checksum),
+};
+
+/* Binary search for the member of a sorted table covering offset */
+static const struct field *search (const struct field *fields, int count, int offset) {
+    int lo = 0, hi = count, mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (fields[mid].offset + fields[mid].size <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < count && fields[lo].offset <= offset)
+        return &fields[lo];
+    return NULL;
+}
+
+/*
+ * The field of image covering offset, NULL if the layout has no name for
+ * it. For EDIDs, *base is set to the start of the 128 byte block the
+ * field is in, 0 otherwise.
+ */
+const struct field *find_field (const unsigned char *image, int length,
+                                int offset, int *base) {
+    *base = 0;
+    if (length < 128)
+        return NULL;
+    if (is_eedid (image)) {
+        *base = offset & ~127;
+        if (!*base)
+            return search (eedid_fields, NUM_FIELDS (eedid_fields), offset);
+        if (*base < length && image[*base] == EXT_CEA861)
+            return search (cea861_fields, NUM_FIELDS (cea861_fields), offset - *base);
+        return NULL;
+    }
+    switch (image[2]) {
+    case MEMTYPE_SDR:
+    case MEMTYPE_DDR:
+    case MEMTYPE_DDR2:
+        return search (sdram_fields, NUM_FIELDS (sdram_fields), offset);
+    case MEMTYPE_DDR3:
+        return search (ddr3_fields, NUM_FIELDS (ddr3_fields), offset);
+    case MEMTYPE_DDR4:
+    case MEMTYPE_DDR4E:
+        return search (ddr4_fields, NUM_FIELDS (ddr4_fields), offset);
+    }
+    return NULL;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+/* a named member of one of the layouts in struct.h and eedid_struct.h */
+struct field {
+    const char *name;
+    int offset;
+    int size;
+    int text;                   /* printable string rather than a number */
+};
+
+const struct field *find_field (const unsigned char *image, int length,
+                                int offset, int *base);
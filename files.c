@@ -0,0 +1,279 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "eeprom.h"
+#include "output.h"
+#include "container.h"
+#include "store.h"
+#include "hexdump.h"
+#include "ddc.h"
+#include "record.h"
+#include "files.h"
+
+/* smallest image get_eeprom_memreq() and the decoders can look at */
+#define MIN_IMAGE_SIZE          128
+
+/* where the records of the current thread go, text output if NULL */
+static __thread struct arena *record_arena;
+
+struct arena *set_record_arena (struct arena *arena) {
+    struct arena *old = record_arena;
+
+    record_arena = arena;
+    return old;
+}
+
+/* Decode one raw image that has been read or mapped from source */
+int decode_image (const char *source, const unsigned char *image, int length) {
+    const struct decoded_record *record;
+    int required;
+
+    if (record_arena) {
+        if (!(record = get_record (image, length, record_arena))) {
+            print_record_error (source, length < MIN_IMAGE_SIZE ?
+                                "image too short" : "unsupported image");
+            return -1;
+        }
+        print_record (source, record);
+        return 0;
+    }
+    do_printf ("Analyzing %s\n", source);
+    if (length < MIN_IMAGE_SIZE) {
+        do_printf ("Image too short (%d bytes), skipping\n\n", length);
+        return -1;
+    }
+    required = get_eeprom_memreq (image, length);
+    if (required > length)
+        do_printf ("Warning: image has %d bytes, %d needed\n", length, required);
+    return decode_eeprom (image, length);
+}
+
+/* Decode one record of a container, labelled with where it came from */
+int decode_record (const char *path, const struct container *container,
+                   uint32_t record) {
+    struct image_info info;
+    char label[1024];
+
+    if (container_get (container, record, &info)) {
+        fprintf (stderr, "%s: record %u is corrupt\n", path, record);
+        return -1;
+    }
+    collect_info (&info);
+    if (info.source == SOURCE_I2C || info.source == SOURCE_DP_AUX)
+        snprintf (label, sizeof (label), "%s record %u (%s, %s %s client 0x%02x)",
+                  path, record, info.host, source_name (info.source),
+                  info.adapter, info.client);
+    else
+        snprintf (label, sizeof (label), "%s record %u (%s, %s %s)",
+                  path, record, info.host, source_name (info.source),
+                  info.adapter);
+    return decode_image (label, info.image, info.length);
+}
+
+/* Decode every sighting recorded in an image store, in ingestion order */
+static int decode_store (const char *path) {
+    struct store store;
+    struct image_info info;
+    char label[1024];
+    size_t offset = 0;
+    int n, count = 0;
+
+    if (store_map (&store, path)) {
+        fprintf (stderr, "Can't open image store %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    while ((n = store_next (&store, &offset, &info)) > 0) {
+        collect_info (&info);
+        if (info.source == SOURCE_I2C || info.source == SOURCE_DP_AUX)
+            snprintf (label, sizeof (label), "%s sighting %d (%s, %s %s client 0x%02x)",
+                      path, count, info.host, source_name (info.source),
+                      info.adapter, info.client);
+        else
+            snprintf (label, sizeof (label), "%s sighting %d (%s, %s %s)",
+                      path, count, info.host, source_name (info.source),
+                      info.adapter);
+        decode_image (label, info.image, info.length);
+        count++;
+    }
+    if (n < 0)
+        fprintf (stderr, "%s: corrupt sighting %d\n", path, count);
+    store_unmap (&store);
+    return n < 0 ? -1 : count;
+}
+
+/* Decode every image of a text dump, labelled with the line it starts on */
+static int decode_hex_dump (const char *path, const unsigned char *text, size_t size) {
+    static __thread unsigned char image[EDID_MAX_SIZE];
+    struct hex_dump dump;
+    char label[4200];
+    int length, result = 0;
+
+    hex_dump_init (&dump, text, size);
+    while ((length = hex_dump_next (&dump, image, sizeof (image))) > 0) {
+        snprintf (label, sizeof (label), "%s line %d", path, dump.first);
+        collect_image (SOURCE_FILE, label, 0, image, length);
+        if (decode_image (label, image, length))
+            result = -1;
+    }
+    return result;
+}
+
+static int decode_container (const char *path, const struct container *container) {
+    uint32_t record;
+    int result = 0;
+
+    for (record = 0; record < container->count; record++)
+        if (decode_record (path, container, record))
+            result = -1;
+    return result;
+}
+
+/*
+ * Map a raw image file or a container and hand the mapping to the
+ * decoders without copying. Image stores are directories and are
+ * decoded as a whole.
+ */
+int decode_file (const char *path) {
+    struct stat statbuf;
+    unsigned char *image;
+    int fd, result;
+
+    if ((fd = open (path, O_RDONLY)) < 0) {
+        fprintf (stderr, "Can't open %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    if (fstat (fd, &statbuf)) {
+        fprintf (stderr, "Can't stat() %s: %s\n", path, strerror (errno));
+        close (fd);
+        return -1;
+    }
+    if (S_ISDIR (statbuf.st_mode)) {
+        close (fd);
+        return decode_store (path) < 0 ? -1 : 0;
+    }
+    if (statbuf.st_size == 0 || statbuf.st_size > 0x7fffffff) {
+        fprintf (stderr, "%s: unsupported size %lld\n", path,
+                 (long long) statbuf.st_size);
+        close (fd);
+        return -1;
+    }
+
+    image = mmap (NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (image == MAP_FAILED) {
+        fprintf (stderr, "Can't mmap() %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+
+    if (is_container (image, statbuf.st_size)) {
+        struct container container;
+
+        if (container_map (&container, image, statbuf.st_size)) {
+            fprintf (stderr, "%s: corrupt container\n", path);
+            result = -1;
+        } else
+            result = decode_container (path, &container);
+    } else if (is_hex_dump (image, statbuf.st_size)) {
+        result = decode_hex_dump (path, image, statbuf.st_size);
+    } else {
+        collect_image (SOURCE_FILE, path, 0, image, statbuf.st_size);
+        result = decode_image (path, image, statbuf.st_size);
+    }
+    munmap (image, statbuf.st_size);
+    return result;
+}
+
+static int skip_hidden (const struct dirent *entry) {
+    return entry->d_name[0] != '.';
+}
+
+/* Decode a file, or every file below a directory in name order */
+int decode_path (const char *path) {
+    struct stat statbuf;
+    struct dirent **entries;
+    char child[4096];
+    int i, n, result, count = 0;
+
+    if (stat (path, &statbuf)) {
+        fprintf (stderr, "Can't stat() %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    if (!S_ISDIR (statbuf.st_mode))
+        return decode_file (path) == 0;
+    if (is_store (path))
+        return decode_store (path);
+
+    if ((n = scandir (path, &entries, skip_hidden, alphasort)) < 0) {
+        fprintf (stderr, "Can't scan %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        snprintf (child, sizeof (child), "%s/%s", path, entries[i]->d_name);
+        if ((result = decode_path (child)) > 0)
+            count += result;
+        free (entries[i]);
+    }
+    free (entries);
+    return count;
+}
+
+static int add_path (struct path_list *list, const char *path) {
+    char **paths;
+
+    if (list->count == list->size) {
+        list->size = list->size ? 2 * list->size : 256;
+        if (!(paths = realloc (list->paths, list->size * sizeof (char *))))
+            return -1;
+        list->paths = paths;
+    }
+    if (!(list->paths[list->count] = strdup (path)))
+        return -1;
+    list->count++;
+    return 0;
+}
+
+/* Append a file, or every file below a directory in name order, to list */
+int collect_path (const char *path, struct path_list *list) {
+    struct stat statbuf;
+    struct dirent **entries;
+    char child[4096];
+    int i, n, result = 0;
+
+    if (stat (path, &statbuf)) {
+        fprintf (stderr, "Can't stat() %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    if (!S_ISDIR (statbuf.st_mode) || is_store (path))
+        return add_path (list, path);
+
+    if ((n = scandir (path, &entries, skip_hidden, alphasort)) < 0) {
+        fprintf (stderr, "Can't scan %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    for (i = 0; i < n; i++) {
+        snprintf (child, sizeof (child), "%s/%s", path, entries[i]->d_name);
+        if (!result && collect_path (child, list) && errno == ENOMEM)
+            result = -1;
+        free (entries[i]);
+    }
+    free (entries);
+    return result;
+}
+
+void free_path_list (struct path_list *list) {
+    int i;
+
+    for (i = 0; i < list->count; i++)
+        free (list->paths[i]);
+    free (list->paths);
+    list->paths = NULL;
+    list->count = list->size = 0;
+}
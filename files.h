@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+struct container;
+struct arena;
+
+struct path_list {
+    char **paths;
+    int count;
+    int size;
+};
+
+/*
+ * Have decode_image() turn images into records allocated from arena and
+ * print those as JSON lines instead of decoding to text, in the calling
+ * thread; returns the previous arena.
+ */
+struct arena *set_record_arena (struct arena *arena);
+int decode_image (const char *source, const unsigned char *image, int length);
+int decode_record (const char *path, const struct container *container,
+                   uint32_t record);
+int decode_file (const char *path);
+int decode_path (const char *path);
+int collect_path (const char *path, struct path_list *list);
+void free_path_list (struct path_list *list);
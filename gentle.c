@@ -0,0 +1,87 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#include "gentle.h"
+
+/* from linux/ioprio.h, which is not exported by all libc versions */
+#define IOPRIO_CLASS_SHIFT      13
+#define IOPRIO_CLASS_IDLE       3
+#define IOPRIO_WHO_PROCESS      1
+#define IOPRIO_PRIO_VALUE(class, data) (((class) << IOPRIO_CLASS_SHIFT) | (data))
+
+/* 0 means gentle mode is off, otherwise bytes per millisecond */
+int gentle_rate = 0;
+
+/* accounted per thread, as parallel readers each drive their own bus */
+static __thread struct timespec window_start;
+static __thread long window_bytes;
+
+static long elapsed_us (const struct timespec *since) {
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000000L +
+        (now.tv_nsec - since->tv_nsec) / 1000;
+}
+
+static void sleep_us (long us) {
+    struct timespec ts;
+
+    ts.tv_sec = us / 1000000;
+    ts.tv_nsec = (us % 1000000) * 1000;
+    while (nanosleep (&ts, &ts) && errno == EINTR);
+}
+
+int gentle_setup (int bytes_per_ms) {
+    struct sched_param param;
+
+    if (bytes_per_ms <= 0) {
+        fprintf (stderr, "Invalid gentle mode rate %d\n", bytes_per_ms);
+        return -1;
+    }
+    gentle_rate = bytes_per_ms;
+
+    memset (&param, 0, sizeof (param));
+    if (sched_setscheduler (0, SCHED_IDLE, &param))
+        fprintf (stderr, "Can't switch to SCHED_IDLE: %s\n", strerror (errno));
+    if (syscall (SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                 IOPRIO_PRIO_VALUE (IOPRIO_CLASS_IDLE, 0)))
+        fprintf (stderr, "Can't set idle I/O priority: %s\n", strerror (errno));
+
+    return 0;
+}
+
+/*
+ * Account for a transfer of the given size and sleep until the average
+ * bus utilisation since the last yield drops back to gentle_rate.
+ */
+void gentle_pace (int bytes) {
+    long due;
+
+    if (!gentle_rate)
+        return;
+
+    if (!window_start.tv_sec && !window_start.tv_nsec)
+        clock_gettime (CLOCK_MONOTONIC, &window_start);
+    window_bytes += bytes;
+    due = window_bytes * 1000 / gentle_rate - elapsed_us (&window_start);
+    if (due > 0)
+        sleep_us (due);
+}
+
+/* Leave the bus idle for a while so that other masters get their turn */
+void gentle_yield (void) {
+    if (!gentle_rate)
+        return;
+
+    sleep_us (GENTLE_CLIENT_GAP * 1000L);
+    sched_yield ();
+    clock_gettime (CLOCK_MONOTONIC, &window_start);
+    window_bytes = 0;
+}
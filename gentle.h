@@ -0,0 +1,14 @@
+#pragma once
+
+/* default pacing for gentle mode: bytes per millisecond on the bus */
+#define GENTLE_DEFAULT_RATE     2
+/* largest single transfer issued in gentle mode */
+#define GENTLE_CHUNK            16
+/* idle gap left to other bus masters between two clients, in ms */
+#define GENTLE_CLIENT_GAP       20
+
+extern int gentle_rate;
+
+int gentle_setup (int bytes_per_ms);
+void gentle_pace (int bytes);
+void gentle_yield (void);
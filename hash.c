@@ -0,0 +1,42 @@
+#include <string.h>
+
+#include "hash.h"
+
+#define PRIME1                  0x9e3779b185ebca87ULL
+#define PRIME2                  0xc2b2ae3d27d4eb4fULL
+
+static uint64_t rotl (uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+/* final avalanche, from MurmurHash3 */
+static uint64_t fmix64 (uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/*
+ * Non-cryptographic 64 bit hash working a word at a time. Good enough to
+ * tell images apart, callers that need exactness compare the bytes on a
+ * match.
+ */
+uint64_t hash64 (const void *data, size_t length) {
+    const unsigned char *p = data;
+    uint64_t h = PRIME1 ^ (length * PRIME2);
+    uint64_t word;
+
+    for (; length >= 8; p += 8, length -= 8) {
+        memcpy (&word, p, 8);
+        h ^= rotl (word * PRIME2, 31) * PRIME1;
+        h = rotl (h, 27) * PRIME1 + PRIME2;
+    }
+    word = 0;
+    memcpy (&word, p, length);
+    h ^= rotl (word * PRIME2, 31) * PRIME1;
+
+    return fmix64 (h);
+}
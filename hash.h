@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+uint64_t hash64 (const void *data, size_t length);
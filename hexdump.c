@@ -0,0 +1,204 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "eeprom.h"
+#include "hexdump.h"
+
+/* how much of a row the vector decoder looks at */
+#define ROW_WINDOW              64
+
+enum {
+    LAYOUT_I2CDUMP = 0,         /* "00: 92 10 0b ..." */
+    LAYOUT_XXD,                 /* "00000000: 9210 0b02 ..." */
+    NUM_LAYOUTS
+};
+
+/* hex digit and separator positions of a full row, relative to its data */
+static const struct {
+    uint64_t digits;
+    uint64_t separators;
+    int span;
+    unsigned char high[16];     /* of the high nibble of each byte */
+} layouts[NUM_LAYOUTS] = {
+    { 0x6db6db6db6dbULL, 0x124924924924ULL, 47,
+      { 0, 3, 6, 9, 12, 15, 18, 21, 24, 27, 30, 33, 36, 39, 42, 45 } },
+    { 0x7bdef7bdefULL, 0x421084210ULL, 39,
+      { 0, 2, 5, 7, 10, 12, 15, 17, 20, 22, 25, 27, 30, 32, 35, 37 } }
+};
+
+static int hex_value (int c) {
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+#ifdef __SSE2__
+/* Nibble values of 16 characters; returns a bitmap of the non hex digits */
+static unsigned int nibbles16 (const unsigned char *text, unsigned char *nibbles) {
+    __m128i v = _mm_loadu_si128 ((const __m128i *) text);
+    __m128i digit = _mm_sub_epi8 (v, _mm_set1_epi8 ('0'));
+    __m128i letter = _mm_sub_epi8 (_mm_or_si128 (v, _mm_set1_epi8 (0x20)),
+                                   _mm_set1_epi8 ('a'));
+    __m128i is_digit = _mm_cmpeq_epi8 (_mm_min_epu8 (digit, _mm_set1_epi8 (9)), digit);
+    __m128i is_letter = _mm_cmpeq_epi8 (_mm_min_epu8 (letter, _mm_set1_epi8 (5)), letter);
+
+    letter = _mm_add_epi8 (letter, _mm_set1_epi8 (10));
+    _mm_storeu_si128 ((__m128i *) nibbles,
+                      _mm_or_si128 (_mm_and_si128 (is_digit, digit),
+                                    _mm_and_si128 (is_letter, letter)));
+    return ~_mm_movemask_epi8 (_mm_or_si128 (is_digit, is_letter)) & 0xffff;
+}
+#else
+static unsigned int nibbles16 (const unsigned char *text, unsigned char *nibbles) {
+    unsigned int bad = 0;
+    int i;
+
+    for (i = 0; i < 16; i++)
+        if ((nibbles[i] = hex_value (text[i])) > 15) {
+            nibbles[i] = 0;
+            bad |= 1U << i;
+        }
+    return bad;
+}
+#endif
+
+/* Decode a full row of one of the layouts; returns 0 if it is none */
+static int decode_row_fast (const unsigned char *data, int length, unsigned char *bytes) {
+    unsigned char window[ROW_WINDOW], nibbles[ROW_WINDOW];
+    uint64_t bad = 0;
+    int i, l;
+
+    memset (window, ' ', sizeof (window));
+    memcpy (window, data, length < ROW_WINDOW ? length : ROW_WINDOW);
+    for (i = 0; i < ROW_WINDOW; i += 16)
+        bad |= (uint64_t) nibbles16 (window + i, nibbles + i) << i;
+
+    for (l = 0; l < NUM_LAYOUTS; l++)
+        if (length >= layouts[l].span && !(bad & layouts[l].digits) &&
+            (bad & layouts[l].separators) == layouts[l].separators &&
+            (length == layouts[l].span || window[layouts[l].span] == ' ')) {
+            for (i = 0; i < 16; i++)
+                bytes[i] = nibbles[layouts[l].high[i]] << 4 |
+                    nibbles[layouts[l].high[i] + 1];
+            return 16;
+        }
+    return 0;
+}
+
+/*
+ * Tokens of hex digit pairs, or XX for bytes i2cdump could not read,
+ * separated by single spaces; two spaces start the ASCII column.
+ */
+static int decode_row (const unsigned char *data, int length, unsigned char *bytes) {
+    int i = 0, count = 0, high, low;
+
+    if ((count = decode_row_fast (data, length, bytes)))
+        return count;
+    while (count < 16 && i < length) {
+        if (data[i] == ' ') {
+            if (i + 1 < length && data[i + 1] == ' ')
+                break;
+            i++;
+            continue;
+        }
+        if (i + 1 < length && data[i] == 'X' && data[i + 1] == 'X') {
+            bytes[count++] = 0xff;
+            i += 2;
+        } else if (i + 1 < length && (high = hex_value (data[i])) >= 0 &&
+                   (low = hex_value (data[i + 1])) >= 0) {
+            bytes[count++] = high << 4 | low;
+            i += 2;
+        } else
+            break;
+    }
+    return count;
+}
+
+/* "OFFSET: " at the start of a line; returns the length of the prefix */
+static int parse_offset (const unsigned char *line, int length, unsigned long *offset) {
+    int i, value;
+
+    *offset = 0;
+    for (i = 0; i < length && i < 16 && (value = hex_value (line[i])) >= 0; i++)
+        *offset = *offset << 4 | value;
+    if (i < 2 || i + 1 >= length || line[i] != ':' || line[i + 1] != ' ')
+        return 0;
+    return i + 2;
+}
+
+int is_hex_dump (const unsigned char *text, size_t size) {
+    const unsigned char *line, *eol, *end = text + (size < 4096 ? size : 4096);
+    unsigned char bytes[16];
+    unsigned long offset;
+    int prefix, found = 0;
+
+    for (line = text; line < end; line++)
+        if (*line < ' ' && *line != '\n' && *line != '\r' && *line != '\t')
+            return 0;
+    for (line = text; line < end && !found; line = eol + 1) {
+        if (!(eol = memchr (line, '\n', end - line)))
+            eol = end;
+        if ((prefix = parse_offset (line, eol - line, &offset)))
+            found = decode_row (line + prefix, eol - line - prefix, bytes) > 0;
+    }
+    return found;
+}
+
+static int is_complete (const unsigned char *image, int length) {
+    int required;
+
+    if (length < 128)
+        return 0;
+    required = get_eeprom_memreq (image, length);
+    return required < 0 || required <= length;
+}
+
+void hex_dump_init (struct hex_dump *dump, const unsigned char *text, size_t size) {
+    dump->text = text;
+    dump->end = text + size;
+    dump->line = 1;
+    dump->first = 0;
+}
+
+int hex_dump_next (struct hex_dump *dump, unsigned char *image, int size) {
+    const unsigned char *start, *eol;
+    unsigned char bytes[16];
+    unsigned long offset, last = 0;
+    int prefix, count, length = 0, base = 0, i;
+
+    for (start = dump->text; start < dump->end; start = eol + 1, dump->line++) {
+        if (!(eol = memchr (start, '\n', dump->end - start)))
+            eol = dump->end;
+        if (!(prefix = parse_offset (start, eol - start, &offset)) ||
+            !(count = decode_row (start + prefix, eol - start - prefix, bytes)))
+            continue;
+        if (!length)
+            dump->first = dump->line;
+        else if (offset <= last) {
+            if (!offset && is_complete (image, length))
+                break;
+            /* the next page of the same image, as i2cdump prints them */
+            base = length;
+        }
+        last = offset;
+        if (base + offset >= size)
+            continue;
+        /* bytes left out of the dump read as erased */
+        if (base + offset > length)
+            memset (image + length, 0xff, base + offset - length);
+        for (i = 0; i < count && base + offset + i < size; i++)
+            image[base + offset + i] = bytes[i];
+        if (base + offset + i > length)
+            length = base + offset + i;
+    }
+    dump->text = start < dump->end ? start : dump->end;
+    return length;
+}
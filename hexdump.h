@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * Text dumps of images as attached to tickets: i2cdump output, with its
+ * header line and 16 bytes per row, and xxd output in any grouping. Rows
+ * of the usual layouts are decoded 16 characters at a time with vector
+ * instructions, anything else (XX for unreadable bytes, short rows) by
+ * the generic tokenizer. A file may hold many dumps; a new image starts
+ * where the offsets start over at 0 and the previous image is complete.
+ */
+struct hex_dump {
+    const unsigned char *text;
+    const unsigned char *end;
+    int line;                   /* of text */
+    int first;                  /* line of the first row of the last image */
+};
+
+int is_hex_dump (const unsigned char *text, size_t size);
+void hex_dump_init (struct hex_dump *dump, const unsigned char *text, size_t size);
+/* Next image of the dump, returns its length or 0 at the end */
+int hex_dump_next (struct hex_dump *dump, unsigned char *image, int size);
@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hash.h"
+#include "intern.h"
+
+/* strings are copied into blocks of this size that never move */
+#define INTERN_BLOCK            65536
+
+struct intern_block {
+    struct intern_block *next;
+    size_t used;
+    size_t size;
+    char text[];
+};
+
+struct intern_table {
+    pthread_rwlock_t lock;
+    const char **strings;       /* by handle */
+    uint64_t *hashes;           /* by handle */
+    uint32_t count;
+    uint32_t size;
+    uint32_t *slots;            /* open addressing over handles, 0 for unused */
+    uint32_t num_slots;         /* a power of two */
+    struct intern_block *blocks;
+};
+
+static struct intern_table table = { PTHREAD_RWLOCK_INITIALIZER };
+
+static uint32_t lookup (uint64_t hash, const char *text) {
+    uint32_t i, handle;
+
+    if (!table.num_slots)
+        return INTERN_NONE;
+    for (i = hash & (table.num_slots - 1); (handle = table.slots[i]);
+         i = (i + 1) & (table.num_slots - 1))
+        if (table.hashes[handle] == hash && !strcmp (table.strings[handle], text))
+            return handle;
+    return INTERN_NONE;
+}
+
+static int grow (void) {
+    const char **strings;
+    uint64_t *hashes;
+    uint32_t *slots, size, h, i;
+
+    if (table.count == table.size) {
+        size = table.size ? 2 * table.size : 1024;
+        if (!(strings = realloc (table.strings, size * sizeof (*strings))))
+            return -1;
+        table.strings = strings;
+        if (!(hashes = realloc (table.hashes, size * sizeof (*hashes))))
+            return -1;
+        table.hashes = hashes;
+        table.size = size;
+        if (!table.count) {
+            /* handle 0 is the empty string and never looked up */
+            table.strings[0] = "";
+            table.hashes[0] = 0;
+            table.count = 1;
+        }
+    }
+    if (2 * (table.count + 1) > table.num_slots) {
+        size = table.num_slots ? 2 * table.num_slots : 2048;
+        if (!(slots = calloc (size, sizeof (*slots))))
+            return -1;
+        for (h = 1; h < table.count; h++) {
+            for (i = table.hashes[h] & (size - 1); slots[i]; i = (i + 1) & (size - 1))
+                ;
+            slots[i] = h;
+        }
+        free (table.slots);
+        table.slots = slots;
+        table.num_slots = size;
+    }
+    return 0;
+}
+
+static const char *copy (const char *text) {
+    struct intern_block *block = table.blocks;
+    size_t length = strlen (text) + 1, size;
+    char *result;
+
+    if (!block || block->size - block->used < length) {
+        size = length > INTERN_BLOCK ? length : INTERN_BLOCK;
+        if (!(block = malloc (sizeof (*block) + size)))
+            return NULL;
+        block->next = table.blocks;
+        block->used = 0;
+        block->size = size;
+        table.blocks = block;
+    }
+    result = block->text + block->used;
+    memcpy (result, text, length);
+    block->used += length;
+    return result;
+}
+
+uint32_t intern_find (const char *text) {
+    uint32_t handle;
+
+    if (!text[0])
+        return 0;
+    pthread_rwlock_rdlock (&table.lock);
+    handle = lookup (hash64 (text, strlen (text)), text);
+    pthread_rwlock_unlock (&table.lock);
+    return handle;
+}
+
+/* Most strings are there already, so only adding one takes the write lock */
+uint32_t intern (const char *text) {
+    uint64_t hash;
+    uint32_t handle, i;
+    const char *string;
+
+    if ((handle = intern_find (text)) != INTERN_NONE)
+        return handle;
+
+    hash = hash64 (text, strlen (text));
+    pthread_rwlock_wrlock (&table.lock);
+    if ((handle = lookup (hash, text)) == INTERN_NONE &&
+        !grow () && (string = copy (text))) {
+        handle = table.count++;
+        table.strings[handle] = string;
+        table.hashes[handle] = hash;
+        for (i = hash & (table.num_slots - 1); table.slots[i]; i = (i + 1) & (table.num_slots - 1))
+            ;
+        table.slots[i] = handle;
+    }
+    pthread_rwlock_unlock (&table.lock);
+    return handle;
+}
+
+const char *interned (uint32_t handle) {
+    const char *string = "";
+
+    pthread_rwlock_rdlock (&table.lock);
+    if (handle < table.count)
+        string = table.strings[handle];
+    pthread_rwlock_unlock (&table.lock);
+    return string;
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * One copy of every distinct string, such as part numbers and voltages,
+ * for the life of the process. Records keep the 32 bit handle, so equal
+ * strings compare and hash as equal integers and are only turned back
+ * into text for output. Handle 0 is the empty string. Safe to use from
+ * several threads at once.
+ */
+#define INTERN_NONE             0xffffffffu
+
+/* The handle of text, adding it if it is new; INTERN_NONE if out of memory */
+uint32_t intern (const char *text);
+/* The handle of text if it was interned before, INTERN_NONE if not */
+uint32_t intern_find (const char *text);
+const char *interned (uint32_t handle);
@@ -0,0 +1,118 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "hash.h"
+#include "output.h"
+#include "memo.h"
+
+/* largest image cached, SPD images are 512 bytes at most */
+#define MEMO_MAX_IMAGE          1024
+/* models remembered; further ones are rendered every time */
+#define MEMO_MAX_MODELS         4096
+#define MEMO_TABLE_SIZE         (2 * MEMO_MAX_MODELS)
+
+struct memo_entry {
+    uint64_t hash;
+    int length;
+    unsigned char *key;         /* the masked image, NULL for empty slots */
+    char *text;
+};
+
+static struct memo_entry *table;
+static int models;
+static pthread_mutex_t memo_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct memo_entry *find_entry (uint64_t hash, const unsigned char *key,
+                                      int length) {
+    unsigned int i;
+
+    for (i = hash & (MEMO_TABLE_SIZE - 1); table[i].key;
+         i = (i + 1) & (MEMO_TABLE_SIZE - 1))
+        if (table[i].hash == hash && table[i].length == length &&
+            !memcmp (table[i].key, key, length))
+            break;
+    return &table[i];
+}
+
+/* Render the model part of a decode into a string */
+static char *render_text (const void *eeprom, int length, memo_render render) {
+    FILE *file, *old;
+    char *text = NULL;
+    size_t size;
+
+    if (!(file = open_memstream (&text, &size)))
+        return NULL;
+    old = set_output (file);
+    render (eeprom, length);
+    set_output (old);
+    if (fclose (file)) {
+        free (text);
+        return NULL;
+    }
+    return text;
+}
+
+/*
+ * Run render on eeprom, or print what it rendered for an earlier image
+ * that only differs in the masked ranges
+ */
+void memo_decode (const void *eeprom, int length, const struct memo_mask *masks,
+                  int count, memo_render render) {
+    struct memo_entry *entry;
+    unsigned char key[MEMO_MAX_IMAGE];
+    char *text;
+    uint64_t hash;
+    int i, full;
+
+    if (length > MEMO_MAX_IMAGE) {
+        render (eeprom, length);
+        return;
+    }
+    memcpy (key, eeprom, length);
+    for (i = 0; i < count; i++)
+        if (masks[i].offset < length)
+            memset (key + masks[i].offset, 0,
+                    masks[i].offset + masks[i].length > length ?
+                    length - masks[i].offset : masks[i].length);
+    hash = hash64 (key, length);
+
+    pthread_mutex_lock (&memo_lock);
+    if (!table && !(table = calloc (MEMO_TABLE_SIZE, sizeof (*table)))) {
+        pthread_mutex_unlock (&memo_lock);
+        render (eeprom, length);
+        return;
+    }
+    entry = find_entry (hash, key, length);
+    text = entry->text;
+    full = models >= MEMO_MAX_MODELS;
+    pthread_mutex_unlock (&memo_lock);
+
+    /* entries are never changed once added, so no need to hold the lock */
+    if (text) {
+        do_printf ("%s", text);
+        return;
+    }
+
+    if (full || !(text = render_text (eeprom, length, render))) {
+        render (eeprom, length);
+        return;
+    }
+    do_printf ("%s", text);
+
+    pthread_mutex_lock (&memo_lock);
+    entry = find_entry (hash, key, length);
+    if (!entry->key && models < MEMO_MAX_MODELS &&
+        (entry->key = malloc (length))) {
+        memcpy (entry->key, key, length);
+        entry->hash = hash;
+        entry->length = length;
+        entry->text = text;
+        models++;
+        text = NULL;
+    }
+    pthread_mutex_unlock (&memo_lock);
+    free (text);
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+/*
+ * Decode cache for the parts of a decode that only depend on the module
+ * model. Modules of one model differ in a few per-unit bytes (serial
+ * number, manufacturing date and location and the checksums over them);
+ * with those masked out the rest of the image fingerprints the model,
+ * and the text rendered for it is reused for every further unit.
+ */
+
+/* a byte range left out of the model fingerprint */
+struct memo_mask {
+    int offset;
+    int length;
+};
+
+typedef void (*memo_render) (const void *eeprom, int length);
+
+void memo_decode (const void *eeprom, int length, const struct memo_mask *masks,
+                  int count, memo_render render);
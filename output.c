@@ -4,8 +4,26 @@
 
 #include "output.h"
 
+/* decoder output of the current thread, stdout if NULL */
+static __thread FILE *output;
+
+FILE *set_output (FILE *file) {
+    FILE *old = output;
+
+    output = file;
+    return old;
+}
+
+void do_printf (const char *format, ...) {
+    va_list vl;
+
+    va_start (vl, format);
+    vfprintf (output ? output : stdout, format, vl);
+    va_end (vl);
+}
+
 const char * mtostr (int m) {
-    static char buffer [32];
+    static __thread char buffer [32];
     if (m < 1024) snprintf (buffer, 31, "%dM", m);
     else snprintf (buffer, 31, "%dG", m/1024);
 
@@ -25,9 +43,9 @@ void do_error (const char *format, ...) {
 
 void do_line (const char *description, const char *content) {
     if (description)
-        printf ("%-20s%c %s\n", description, description[0] ? ':' : ' ', content);
+        do_printf ("%-20s%c %s\n", description, description[0] ? ':' : ' ', content);
     else
-        printf ("\n");
+        do_printf ("\n");
 }
 
 void addlist (char *old, const char *new) {
@@ -35,3 +53,31 @@ void addlist (char *old, const char *new) {
         strcat (old, " ");
     strcat (old, new);
 }
+
+/*
+ * text as the inside of a JSON string, with quotes, backslashes and
+ * anything but printable ASCII escaped; cut short to fit size
+ */
+char *json_escape (char *dest, size_t size, const char *text) {
+    const unsigned char *p = (const unsigned char *) text;
+    size_t n = 0;
+
+    for (; *p; p++) {
+        if (*p >= 0x20 && *p < 0x7f && *p != '"' && *p != '\\') {
+            if (n + 1 >= size)
+                break;
+            dest[n++] = *p;
+        } else if (*p == '"' || *p == '\\') {
+            if (n + 2 >= size)
+                break;
+            dest[n++] = '\\';
+            dest[n++] = *p;
+        } else {
+            if (n + 6 >= size)
+                break;
+            n += snprintf (dest + n, size - n, "\\u%04x", *p);
+        }
+    }
+    dest[n] = 0;
+    return dest;
+}
@@ -1,6 +1,12 @@
 #pragma once
 
+#include <stdio.h>
+
 const char * mtostr (int m);
+FILE *set_output (FILE *file);
+void do_printf (const char *format, ...)
+    __attribute__ ((format (printf, 1, 2)));
 void do_error (const char *format, ...);
 void do_line (const char *description, const char *content);
 void addlist (char *old, const char *new);
+char *json_escape (char *dest, size_t size, const char *text);
@@ -0,0 +1,120 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "ring.h"
+#include "eeprom.h"
+#include "decode-dimm.h"
+#include "trace.h"
+#include "pipeline.h"
+
+/* eeproms a reader may run ahead of the decoder */
+#define PIPELINE_DEPTH          8
+
+struct scan_item {
+    int client;
+    int length;
+    char note[SCAN_NOTE_SIZE];  /* "" if none */
+    unsigned char data[];
+};
+
+struct reader {
+    pthread_t thread;
+    char *adapter;
+    char *name;
+    struct ring ring;
+};
+
+struct reader_list {
+    struct reader *readers;
+    int count;
+};
+
+static int push_client (void *arg, int client, const unsigned char *eeprom,
+                        int length, const char *note) {
+    struct reader *reader = arg;
+    struct scan_item *item;
+
+    if (!(item = malloc (sizeof (*item) + length))) {
+        fprintf (stderr, "Out of memory reading %s\n", reader->adapter);
+        return 0;
+    }
+    item->client = client;
+    item->length = length;
+    snprintf (item->note, sizeof (item->note), "%s", note ? note : "");
+    memcpy (item->data, eeprom, length);
+    ring_push (&reader->ring, item);
+    return 1;
+}
+
+static void *reader_thread (void *arg) {
+    struct reader *reader = arg;
+
+    trace_thread (reader->adapter);
+    read_adapter (reader->adapter, push_client, reader);
+    /* NULL marks the end of this adapter */
+    ring_push (&reader->ring, NULL);
+    return NULL;
+}
+
+static int add_reader (void *arg, const char *adapter, const char *name) {
+    struct reader_list *list = arg;
+    struct reader *readers, *reader;
+
+    readers = realloc (list->readers, (list->count + 1) * sizeof (*readers));
+    if (!readers)
+        return 0;
+    list->readers = readers;
+    reader = &readers[list->count];
+    if (ring_init (&reader->ring, PIPELINE_DEPTH))
+        return 0;
+    reader->adapter = strdup (adapter);
+    reader->name = strdup (name ? name : "unknown");
+    list->count++;
+    return 0;
+}
+
+/*
+ * Read every adapter in a thread of its own, each feeding a ring that is
+ * drained by the calling thread in adapter order. The output is the same
+ * as foreach_i2c_adapter(), but the next transfers run while the previous
+ * eeprom is decoded and printed.
+ */
+int pipeline_i2c_adapters (int all) {
+    struct reader_list list = { NULL, 0 };
+    struct scan_item *item;
+    int i, started, count = 0;
+
+    if (list_i2c_adapters (all, add_reader, &list) < 0)
+        return -1;
+
+    for (started = 0; started < list.count; started++)
+        if (pthread_create (&list.readers[started].thread, NULL,
+                            reader_thread, &list.readers[started])) {
+            fprintf (stderr, "Can't start reader for %s\n",
+                     list.readers[started].adapter);
+            break;
+        }
+
+    for (i = 0; i < list.count; i++) {
+        struct reader *reader = &list.readers[i];
+
+        if (i < started) {
+            printf ("Testing %s (%s)\n", reader->adapter, reader->name);
+            while ((item = ring_pop (&reader->ring))) {
+                if (item->note[0])
+                    printf ("%s\n", item->note);
+                if (do_eeprom (item->client, item->data, item->length) == 0)
+                    count++;
+                free (item);
+            }
+            pthread_join (reader->thread, NULL);
+        }
+        ring_free (&reader->ring);
+        free (reader->adapter);
+        free (reader->name);
+    }
+    free (list.readers);
+    return count;
+}
@@ -0,0 +1,3 @@
+#pragma once
+
+int pipeline_i2c_adapters (int all);
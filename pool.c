@@ -0,0 +1,135 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "pool.h"
+
+/*
+ * Work-stealing pool over the task indices 0..count-1. Every worker owns
+ * a contiguous range of indices, packed as hi << 32 | lo into a single
+ * atomic word. The owner takes from the low end, an idle worker steals
+ * the upper half of a victim's range with one compare-and-swap, so both
+ * sides stay lock-free and tasks stay mostly in input order per worker.
+ */
+#define RANGE(lo, hi)           (((uint64_t) (hi) << 32) | (uint32_t) (lo))
+#define RANGE_LO(range)         ((uint32_t) (range))
+#define RANGE_HI(range)         ((uint32_t) ((range) >> 32))
+
+struct deque {
+    _Atomic uint64_t range;
+    char pad[64 - sizeof (uint64_t)];   /* keep deques on separate cache lines */
+};
+
+struct pool {
+    struct deque *deques;
+    int workers;
+    pool_task task;
+    void *arg;
+};
+
+struct worker {
+    struct pool *pool;
+    pthread_t thread;
+    int id;
+};
+
+static int take (struct deque *deque, int *index) {
+    uint64_t range = atomic_load (&deque->range);
+    uint32_t lo, hi;
+
+    do {
+        lo = RANGE_LO (range);
+        hi = RANGE_HI (range);
+        if (lo >= hi)
+            return 0;
+    } while (!atomic_compare_exchange_weak (&deque->range, &range,
+                                            RANGE (lo + 1, hi)));
+    *index = lo;
+    return 1;
+}
+
+static int steal (struct deque *victim, uint32_t *stolen_lo, uint32_t *stolen_hi) {
+    uint64_t range = atomic_load (&victim->range);
+    uint32_t lo, hi, mid;
+
+    do {
+        lo = RANGE_LO (range);
+        hi = RANGE_HI (range);
+        if (lo >= hi)
+            return 0;
+        mid = lo + (hi - lo) / 2;
+    } while (!atomic_compare_exchange_weak (&victim->range, &range,
+                                            RANGE (lo, mid)));
+    *stolen_lo = mid;
+    *stolen_hi = hi;
+    return 1;
+}
+
+static void *worker_thread (void *arg) {
+    struct worker *worker = arg;
+    struct pool *pool = worker->pool;
+    struct deque *own = &pool->deques[worker->id];
+    uint32_t lo, hi;
+    int i, index;
+
+    for (;;) {
+        while (take (own, &index))
+            pool->task (pool->arg, worker->id, index);
+
+        /* own range is empty, so nobody else can modify it right now */
+        for (i = 1; i < pool->workers; i++)
+            if (steal (&pool->deques[(worker->id + i) % pool->workers], &lo, &hi)) {
+                atomic_store (&own->range, RANGE (lo, hi));
+                break;
+            }
+        /* tasks never spawn tasks, so once everything is empty we're done */
+        if (i == pool->workers)
+            break;
+    }
+    return NULL;
+}
+
+int pool_run (int workers, int count, pool_task task, void *arg) {
+    struct pool pool = { NULL, workers, task, arg };
+    struct worker *threads;
+    int i, started;
+
+    if (workers < 2 || count < 2) {
+        for (i = 0; i < count; i++)
+            task (arg, 0, i);
+        return 0;
+    }
+
+    pool.deques = aligned_alloc (64, workers * sizeof (struct deque));
+    threads = calloc (workers, sizeof (struct worker));
+    if (!pool.deques || !threads) {
+        free (pool.deques);
+        free (threads);
+        return -1;
+    }
+    for (i = 0; i < workers; i++)
+        atomic_init (&pool.deques[i].range,
+                     RANGE ((int64_t) count * i / workers,
+                            (int64_t) count * (i + 1) / workers));
+
+    for (started = 1; started < workers; started++) {
+        threads[started].pool = &pool;
+        threads[started].id = started;
+        if (pthread_create (&threads[started].thread, NULL, worker_thread,
+                            &threads[started]))
+            break;
+    }
+    /* the caller works as worker 0, and picks up whatever failed to start */
+    threads[0].pool = &pool;
+    threads[0].id = 0;
+    worker_thread (&threads[0]);
+
+    for (i = 1; i < started; i++)
+        pthread_join (threads[i].thread, NULL);
+
+    free (threads);
+    free (pool.deques);
+    return 0;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+/* runs task index on worker, workers are numbered from 0 */
+typedef void (*pool_task) (void *arg, int worker, int index);
+
+int pool_run (int workers, int count, pool_task task, void *arg);
@@ -0,0 +1,41 @@
+#pragma once
+
+/*
+ * USDT probes of provider decode_dimm, for attaching bpftrace or perf to
+ * a running process, e.g.
+ *
+ *   bpftrace -e 'usdt:./decode-dimm:decode_dimm:read_done { @[arg3] = count(); }'
+ *
+ * A probe not attached to is a single nop. Where <sys/sdt.h> is missing
+ * they compile to nothing, arguments included, so an argument must not
+ * have side effects.
+ *
+ *   adapter_open      adapter name, fd or -1, features, errno
+ *   client_select     fd, client, errno
+ *   read_start        fd, offset, bytes asked for
+ *   read_done         fd, offset, bytes read or -1, errno
+ *   page_switch_start fd, bank
+ *   page_switch_done  fd, bank, result, errno
+ *   memreq            memory type, bytes read, bytes required or -1
+ *   do_*_entry        image, length
+ *   do_*_return       image, 1 if decoded in full, 0 if the image was too short
+ *
+ * read_* cover read() chunks, SMBus byte and word reads and E-DDC segments
+ * alike, with the E-DDC ones at offsets of 256 times the segment.
+ */
+#if defined (__has_include)
+#if __has_include (<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_SDT                1
+#endif
+#endif
+
+#ifdef HAVE_SDT
+#define PROBE2(name, a, b)              DTRACE_PROBE2 (decode_dimm, name, a, b)
+#define PROBE3(name, a, b, c)           DTRACE_PROBE3 (decode_dimm, name, a, b, c)
+#define PROBE4(name, a, b, c, d)        DTRACE_PROBE4 (decode_dimm, name, a, b, c, d)
+#else
+#define PROBE2(name, a, b)              do { } while (0)
+#define PROBE3(name, a, b, c)           do { } while (0)
+#define PROBE4(name, a, b, c, d)        do { } while (0)
+#endif
@@ -0,0 +1,207 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "constants.h"
+#include "struct.h"
+#include "eeprom.h"
+#include "vendors.h"
+#include "output.h"
+#include "arena.h"
+#include "intern.h"
+#include "sdr-ddr2.h"
+#include "ddr3.h"
+#include "ddr4.h"
+#include "eedid.h"
+#include "record.h"
+
+static int from_bcd (int value) {
+    if ((value & 15) > 9 || (value >> 4) > 9)
+        return -1;
+    return (value >> 4) * 10 + (value & 15);
+}
+
+void set_spd_date (struct spd_record *spd, uint16_t date) {
+    int year = from_bcd (date & 0xff), week = from_bcd (date >> 8);
+
+    if (year >= 0 && week >= 1 && week <= 53) {
+        spd->year = 2000 + year;
+        spd->week = week;
+    }
+}
+
+struct decoded_record *new_spd_record (int kind, const unsigned char *image, int length,
+                                       struct arena *arena) {
+    struct decoded_record *record;
+    struct spd_record *spd;
+    struct module_info module;
+
+    if (get_module_info (image, length, &module) ||
+        !(record = arena_calloc (arena, sizeof (*record))))
+        return NULL;
+    record->kind = kind;
+    /* the same place in every generation */
+    spd = &record->sdram.spd;
+    spd->type = module.type;
+    spd->vendor = module.vendor;
+    spd->dram_vendor = module.dram_vendor;
+    spd->size = module.size;
+    spd->ranks = module.ranks;
+    spd->device_width = module.device_width;
+    spd->ecc = module.ecc;
+    spd->module_type = module.module_type;
+    spd->tck = module.tck;
+    spd->taa = module.taa;
+    spd->part = intern (module.part);
+    spd->voltage = intern (module.voltage);
+    if (spd->part == INTERN_NONE || spd->voltage == INTERN_NONE)
+        return NULL;
+    return record;
+}
+
+const struct decoded_record *get_record (const unsigned char *image, int length,
+                                         struct arena *arena) {
+    if (length < 128)
+        return NULL;
+    switch (image[2]) {
+    case MEMTYPE_SDR:
+    case MEMTYPE_DDR:
+    case MEMTYPE_DDR2:
+        return get_sdram_record ((const struct sdram_spd *) image, length, arena);
+    case MEMTYPE_DDR3:
+        return get_ddr3_record ((const struct ddr3_sdram_spd *) image, length, arena);
+    case MEMTYPE_DDR4:
+    case MEMTYPE_DDR4E:
+        return get_ddr4_record ((const struct ddr4_sdram_spd *) image, length, arena);
+    case 0xff:
+        if (is_eedid (image))
+            return get_eedid_record ((const struct eedid_t *) image, length, arena);
+    }
+    return NULL;
+}
+
+/* A JSON string, anything but printable ASCII escaped */
+static void print_string (const char *text) {
+    const unsigned char *p = (const unsigned char *) text;
+    int n;
+
+    do_printf ("\"");
+    while (*p) {
+        for (n = 0; p[n] >= 0x20 && p[n] < 0x7f && p[n] != '"' && p[n] != '\\'; n++)
+            ;
+        if (n)
+            do_printf ("%.*s", n, p);
+        p += n;
+        if (*p == '"' || *p == '\\')
+            do_printf ("\\%c", *p++);
+        else if (*p)
+            do_printf ("\\u%04x", *p++);
+    }
+    do_printf ("\"");
+}
+
+static const char *type_names[] = {
+    [MEMTYPE_SDR] = "SDR", [MEMTYPE_DDR] = "DDR", [MEMTYPE_DDR2] = "DDR2",
+    [MEMTYPE_DDR3] = "DDR3", [MEMTYPE_DDR4] = "DDR4", [MEMTYPE_DDR4E] = "DDR4E"
+};
+
+static void print_spd (const struct spd_record *spd) {
+    int cl, first = 1;
+
+    do_printf (",\"type\":\"%s\",\"vendor\":", type_names[spd->type]);
+    print_string (get_vendor16 (spd->vendor));
+    do_printf (",\"vendor_id\":\"%04x\"", spd->vendor);
+    if (spd->dram_vendor) {
+        do_printf (",\"dram_vendor\":");
+        print_string (get_vendor16 (spd->dram_vendor));
+        do_printf (",\"dram_vendor_id\":\"%04x\"", spd->dram_vendor);
+    }
+    do_printf (",\"part\":");
+    print_string (interned (spd->part));
+    do_printf (",\"serial\":\"%08X\"", spd->serial);
+    if (spd->year)
+        do_printf (",\"date\":\"%04d-%02d\"", spd->year, spd->week);
+    do_printf (",\"size\":%d,\"ranks\":%d,\"device_width\":%d,\"ecc\":%s",
+               spd->size, spd->ranks, spd->device_width, spd->ecc ? "true" : "false");
+    if (spd->module_type)
+        do_printf (",\"module_type\":%d", spd->module_type);
+    do_printf (",\"voltage\":");
+    print_string (interned (spd->voltage));
+    do_printf (",\"cas_latencies\":[");
+    for (cl = 0; cl < 64; cl++)
+        if (spd->cas_latencies & (1ull << cl)) {
+            do_printf ("%s%d", first ? "" : ",", cl);
+            first = 0;
+        }
+    do_printf ("],\"tck\":%d,\"taa\":%d,\"trcd\":%d,\"trp\":%d,\"tras\":%d,\"trc\":%d",
+               spd->tck, spd->taa, spd->trcd, spd->trp, spd->tras, spd->trc);
+}
+
+static void print_edid (const struct edid_record *edid) {
+    int i, j;
+
+    do_printf (",\"type\":\"EDID\",\"vendor\":");
+    print_string (edid->vendor);
+    do_printf (",\"product\":%d,\"serial\":\"%08X\"", edid->product, edid->serial);
+    if (edid->year)
+        do_printf (",\"year\":%d", edid->year);
+    if (edid->week)
+        do_printf (",\"week\":%d", edid->week);
+    do_printf (",\"version\":\"%d.%d\",\"digital\":%s", edid->version, edid->revision,
+               edid->digital ? "true" : "false");
+    if (edid->interface)
+        do_printf (",\"interface\":\"%s\"", eedid_interface_name (edid->interface));
+    do_printf (",\"name\":");
+    print_string (edid->name);
+    do_printf (",\"serial_string\":");
+    print_string (edid->serial_string);
+    do_printf (",\"extensions\":%d,\"timings\":[", edid->extensions);
+    for (i = 0; i < edid->num_timings; i++)
+        do_printf ("%s{\"width\":%d,\"height\":%d,\"refresh\":%d,\"pixel_clock\":%d}",
+                   i ? "," : "", edid->timings[i].width, edid->timings[i].height,
+                   edid->timings[i].refresh, edid->timings[i].pixel_clock);
+    do_printf ("],\"cea_blocks\":[");
+    for (i = 0; i < edid->num_cea_blocks; i++) {
+        do_printf ("%s{\"tag\":%d,\"data\":\"", i ? "," : "", edid->cea_blocks[i].tag);
+        for (j = 0; j < edid->cea_blocks[i].length; j++)
+            do_printf ("%02x", edid->cea_blocks[i].data[j]);
+        do_printf ("\"}");
+    }
+    do_printf ("]");
+}
+
+void print_record (const char *source, const struct decoded_record *record) {
+    do_printf ("{\"source\":");
+    print_string (source);
+    switch (record->kind) {
+    case RECORD_SDRAM:
+        print_spd (&record->sdram.spd);
+        do_printf (",\"banks\":%d,\"rows\":%d,\"columns\":%d",
+                   record->sdram.banks, record->sdram.rows[0], record->sdram.columns[0]);
+        break;
+    case RECORD_DDR3:
+        print_spd (&record->ddr3.spd);
+        do_printf (",\"banks\":%d,\"rows\":%d,\"columns\":%d",
+                   record->ddr3.banks, record->ddr3.rows, record->ddr3.columns);
+        break;
+    case RECORD_DDR4:
+        print_spd (&record->ddr4.spd);
+        do_printf (",\"bank_groups\":%d,\"banks\":%d,\"rows\":%d,\"columns\":%d,"
+                   "\"density\":%d,\"package\":",
+                   record->ddr4.bank_groups, record->ddr4.banks, record->ddr4.rows,
+                   record->ddr4.columns, record->ddr4.density);
+        print_string (record->ddr4.package);
+        break;
+    case RECORD_EDID:
+        print_edid (&record->edid);
+        break;
+    }
+    do_printf ("}\n");
+}
+
+void print_record_error (const char *source, const char *error) {
+    do_printf ("{\"source\":");
+    print_string (source);
+    do_printf (",\"error\":");
+    print_string (error);
+    do_printf ("}\n");
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "constants.h"
+
+struct arena;
+
+/*
+ * Decoded images as data rather than text, for batch use. A record and
+ * everything it points to come from the arena given to the get_*_record()
+ * functions and stay valid until that arena is reset; the image itself
+ * need not outlive the call.
+ */
+enum {
+    RECORD_SDRAM = 1,           /* SDR, DDR and DDR2 */
+    RECORD_DDR3,
+    RECORD_DDR4,
+    RECORD_EDID
+};
+
+/* what all SPD generations have in common, times in ps and 0 if not given */
+struct spd_record {
+    int type;                   /* byte 2, MEMTYPE_* */
+    unsigned int vendor;        /* JEDEC ids as taken by get_vendor16() */
+    unsigned int dram_vendor;
+    uint32_t part;              /* intern() handles */
+    uint32_t voltage;
+    uint32_t serial;
+    int year, week;             /* 0 unless given in BCD */
+    int size;                   /* usable capacity in MB */
+    int ranks;
+    int device_width;
+    int ecc;
+    int module_type;
+    uint64_t cas_latencies;     /* bit n set for CL n */
+    int tck, taa, trcd, trp, tras, trc;
+};
+
+struct sdram_record {
+    struct spd_record spd;
+    int banks;                  /* per device */
+    int rows[MAX_RANKS];
+    int columns[MAX_RANKS];
+};
+
+struct ddr3_record {
+    struct spd_record spd;
+    int banks;
+    int rows, columns;
+};
+
+struct ddr4_record {
+    struct spd_record spd;
+    int bank_groups;
+    int banks;                  /* per bank group */
+    int rows, columns;
+    int density;                /* Mbit per die */
+    const char *package;
+};
+
+struct edid_timing {
+    int width, height;
+    int refresh;                /* Hz */
+    int pixel_clock;            /* kHz */
+};
+
+/* a CEA-861 data block, the payload without its header byte */
+struct cea_block {
+    int tag;
+    int length;
+    const unsigned char *data;
+};
+
+struct edid_record {
+    char vendor[4];             /* PNP id */
+    int product;
+    uint32_t serial;
+    int year, week;             /* 0 if not given */
+    int version, revision;
+    int digital;
+    int interface;              /* ifnames[] index, EDID 1.4 only */
+    const char *name;           /* display descriptors, "" if not given */
+    const char *serial_string;
+    int extensions;
+    int num_timings;            /* detailed timings of all blocks */
+    struct edid_timing *timings;
+    int num_cea_blocks;
+    struct cea_block *cea_blocks;
+};
+
+struct decoded_record {
+    int kind;                   /* RECORD_* */
+    union {
+        struct sdram_record sdram;
+        struct ddr3_record ddr3;
+        struct ddr4_record ddr4;
+        struct edid_record edid;
+    };
+};
+
+/* For the get_*_record() of the decoders: a record of kind with the common fields set */
+struct decoded_record *new_spd_record (int kind, const unsigned char *image, int length,
+                                       struct arena *arena);
+/* Year and week from the BCD manufacturing date, left 0 unless valid */
+void set_spd_date (struct spd_record *spd, uint16_t date);
+
+/* The record of any image get_module_info() or is_eedid() accept, NULL for others */
+const struct decoded_record *get_record (const unsigned char *image, int length,
+                                         struct arena *arena);
+/* One line of JSON each */
+void print_record (const char *source, const struct decoded_record *record);
+void print_record_error (const char *source, const char *error);
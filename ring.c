@@ -0,0 +1,55 @@
+#include <stdlib.h>
+#include <time.h>
+#include <sched.h>
+
+#include "ring.h"
+
+/* spin briefly, then back off so a waiting side doesn't burn a core */
+static void ring_wait (int *spins) {
+    struct timespec ts = { 0, 50000 };
+
+    if (++*spins < 64)
+        sched_yield ();
+    else
+        nanosleep (&ts, NULL);
+}
+
+int ring_init (struct ring *ring, unsigned int size) {
+    unsigned int n = 1;
+
+    while (n < size)
+        n <<= 1;
+    if (!(ring->slots = calloc (n, sizeof (void *))))
+        return -1;
+    ring->size = n;
+    atomic_init (&ring->head, 0);
+    atomic_init (&ring->tail, 0);
+    return 0;
+}
+
+void ring_free (struct ring *ring) {
+    free (ring->slots);
+    ring->slots = NULL;
+}
+
+void ring_push (struct ring *ring, void *item) {
+    unsigned int tail = atomic_load_explicit (&ring->tail, memory_order_relaxed);
+    int spins = 0;
+
+    while (tail - atomic_load_explicit (&ring->head, memory_order_acquire) >= ring->size)
+        ring_wait (&spins);
+    ring->slots[tail & (ring->size - 1)] = item;
+    atomic_store_explicit (&ring->tail, tail + 1, memory_order_release);
+}
+
+void *ring_pop (struct ring *ring) {
+    unsigned int head = atomic_load_explicit (&ring->head, memory_order_relaxed);
+    void *item;
+    int spins = 0;
+
+    while (atomic_load_explicit (&ring->tail, memory_order_acquire) == head)
+        ring_wait (&spins);
+    item = ring->slots[head & (ring->size - 1)];
+    atomic_store_explicit (&ring->head, head + 1, memory_order_release);
+    return item;
+}
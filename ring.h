@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdatomic.h>
+
+/*
+ * Lock-free single-producer/single-consumer ring of pointers. head is
+ * only written by the consumer, tail only by the producer.
+ */
+struct ring {
+    void **slots;
+    unsigned int size;          /* power of two */
+    _Atomic unsigned int head;
+    _Atomic unsigned int tail;
+};
+
+int ring_init (struct ring *ring, unsigned int size);
+void ring_free (struct ring *ring);
+void ring_push (struct ring *ring, void *item);
+void *ring_pop (struct ring *ring);
@@ -5,7 +5,11 @@
 #include "constants.h"
 #include "struct.h"
 #include "output.h"
+#include "probes.h"
+#include "memo.h"
+#include "eeprom.h"
 #include "sdr-ddr2.h"
+#include "record.h"
 
 static char *get_ddr2_memtype (const char type) {
     switch (type) {
@@ -43,8 +47,113 @@ static int latency (int memtype, double cyclen, int value) {
     return -1;
 }
 
-void do_sdram (const struct sdram_spd *eeprom, int length) {
-    int i, checksum;
+/*
+ * Ranks and the row and column bits of each; returns the number of ranks,
+ * which may exceed MAX_RANKS, in which case only MAX_RANKS are filled in
+ */
+static int sdram_geometry (const struct sdram_spd *eeprom, int *rows, int *columns) {
+    int i, num_ranks;
+
+    num_ranks = eeprom->num_ranks & 7;
+    if (eeprom->memory_type == MEMTYPE_DDR2)
+        num_ranks++;
+
+    rows[0] = eeprom->num_row_addr & 15;
+    if (eeprom->memory_type < MEMTYPE_DDR2)
+        rows[1] = eeprom->num_row_addr >> 4;
+    else
+        rows[1] = 0;
+    for (i = 1; i < MAX_RANKS; i++)
+        if (!rows[i])
+            rows[i] = rows[0];
+    for (i = 0; i < MAX_RANKS; i++)
+        if (rows[i] < 7)
+            rows[i] += 15;
+
+    columns[0] = eeprom->num_col_addr & 15;
+    if (eeprom->memory_type < MEMTYPE_DDR2)
+        columns[1] = eeprom->num_col_addr >> 4;
+    else
+        columns[1] = 0;
+    for (i = 0; i < MAX_RANKS; i++) {
+        if (i && !columns[i])
+            columns[i] = columns[0];
+        if (columns[i] < 7)
+            columns[i] += 15;
+    }
+    return num_ranks;
+}
+
+/* module size in MB, including parity or ECC bits */
+static int sdram_size (const struct sdram_spd *eeprom, int num_ranks,
+                       const int *rows, const int *columns) {
+    int width = eeprom->data_width + eeprom->reserved1 * 256;
+    int i, size = 0;
+
+    for (i = 0; i < num_ranks; i++)
+        size +=
+            (1 << (rows[i] + columns[i] - 20)) * eeprom->num_banks_device *
+            (width >> 3);
+    return size;
+}
+
+/* A cycle time byte in ns, the low nibble giving tenths or one of a few fractions */
+static double cycle_time (int value) {
+    double fraction;
+
+    if ((value & 15) < 10)
+        fraction = (double) (value & 15) / 10.0;
+    else {
+        switch (value & 15) {
+        case 0x0a:
+            fraction = 0.25;
+            break;
+        case 0x0b:
+            fraction = 1.0 / 3.0;
+            break;
+        case 0x0c:
+            fraction = 2.0 / 3.0;
+            break;
+        case 0x0d:
+            fraction = 0.75;
+            break;
+        default:
+            fraction = 0.0;
+        }
+    }
+    return fraction + (double) (value >> 4);
+}
+
+/* The highest CAS latency in clocks, half ones included for DDR; 0 if none is set */
+static double max_cas_latency (const struct sdram_spd *eeprom) {
+    int i;
+
+    for (i = 6; i >= 0; i--)
+        if (eeprom->cas_latency & (1 << i))
+            switch (eeprom->memory_type) {
+            case MEMTYPE_SDR:
+                return 1 + i;
+            case MEMTYPE_DDR:
+                return 1 + (double) i * 0.5;
+            default:
+                return i;
+            }
+    return 0;
+}
+
+static const char *voltage_levels[] = {
+    "5V TTL", "3.3V LVTTL", "1.5V HSTL", "3.3V SSTL", "2.5V SSTL", "1.8V SSTL"
+};
+
+/* checksum, module location, manufacturing date and serial number */
+static const struct memo_mask sdram_unit_fields[] = {
+    { 0x3f, 1 }, { 0x48, 1 }, { 0x5d, 6 }
+};
+
+/* Everything that is the same for all modules of a model */
+static void sdram_model (const void *data, int length) {
+    const struct sdram_spd *eeprom = data;
+    int i;
 
     int rows[MAX_RANKS], columns[MAX_RANKS];
     int width;
@@ -57,31 +166,6 @@ void do_sdram (const struct sdram_spd *eeprom, int length) {
 
     char linebuf[256], linebuf2[200], cls[16];
 
-    if ((length < 2) || (length < (1 << eeprom->total_bytes))) {
-        printf ("Insufficient data read, aborting decode\n");
-        return;
-    }
-
-    /* SPD information */
-    switch (eeprom->memory_type) {
-    case MEMTYPE_SDR:
-        sprintf (linebuf, "%d", eeprom->spd_revision);
-        break;
-    case MEMTYPE_DDR:
-    case MEMTYPE_DDR2:
-        sprintf (linebuf, "%d.%d", eeprom->spd_revision >> 4,
-                 eeprom->spd_revision & 15);
-        break;
-    }
-    sprintf (linebuf2, "%d/%d bytes used",
-             eeprom->bytes_written, 1 << eeprom->total_bytes);
-    strcat (linebuf, linebuf2);
-    do_line ("SPD Revision", linebuf);
-    checksum = crc ((char *) eeprom, 63);
-    sprintf (linebuf, "%02X, %scorrect", checksum,
-             checksum == eeprom->checksum ? "" : "not ");
-    do_line ("Checksum", linebuf);
-
     /* Vendor information */
     if (eeprom->bytes_written >= 71) {
         do_line ("Vendor", get_vendor64 (eeprom->manufacturer_jedec_id));
@@ -97,43 +181,14 @@ void do_sdram (const struct sdram_spd *eeprom, int length) {
         do_line ("Vendor", "unknown");
 
     /* general module type */
-    num_ranks = eeprom->num_ranks & 7;
-    if (eeprom->memory_type == MEMTYPE_DDR2)
-        num_ranks++;
+    num_ranks = sdram_geometry (eeprom, rows, columns);
     if (num_ranks > MAX_RANKS) {
         do_error ("update decode-dimm to support a minimum of %d ranks\n",
                   num_ranks);
         return;
     }
-    rows[0] = eeprom->num_row_addr & 15;
-    if (eeprom->memory_type < MEMTYPE_DDR2)
-        rows[1] = eeprom->num_row_addr >> 4;
-    else
-        rows[1] = 0;
     width = eeprom->data_width + eeprom->reserved1 * 256;
-    for (i = 1; i < MAX_RANKS; i++)
-        if (!rows[i])
-            rows[i] = rows[0];
-    for (i = 0; i < MAX_RANKS; i++)
-        if (rows[i] < 7)
-            rows[i] += 15;
-
-    columns[0] = eeprom->num_col_addr & 15;
-    if (eeprom->memory_type < MEMTYPE_DDR2)
-        columns[1] = eeprom->num_col_addr >> 4;
-    else
-        columns[1] = 0;
-    for (i = 0; i < MAX_RANKS; i++) {
-        if (i && !columns[i])
-            columns[i] = columns[0];
-        if (columns[i] < 7)
-            columns[i] += 15;
-    }
-
-    for (i = 0; i < num_ranks; i++)
-        size +=
-            (1 << (rows[i] + columns[i] - 20)) * eeprom->num_banks_device *
-            (width >> 3);
+    size = sdram_size (eeprom, num_ranks, rows, columns);
 
     switch (eeprom->memory_type) {
     case MEMTYPE_SDR:
@@ -209,28 +264,7 @@ void do_sdram (const struct sdram_spd *eeprom, int length) {
             else
                 break;
 
-            if ((cyclen_i & 15) < 10) {
-                cyclen = (double) (cyclen_i & 15) / 10.0;
-            }
-            else {
-                switch (cyclen_i & 15) {
-                case 0x0a:
-                    cyclen = 0.25;
-                    break;
-                case 0x0b:
-                    cyclen = 1.0 / 3.0;
-                    break;
-                case 0x0c:
-                    cyclen = 2.0 / 3.0;
-                    break;
-                case 0x0d:
-                    cyclen = 0.75;
-                    break;
-                default:
-                    cyclen = 0.0;
-                }
-            }
-            cyclen += (double) (cyclen_i >> 4);
+            cyclen = cycle_time (cyclen_i);
 
             switch (eeprom->memory_type) {
             case MEMTYPE_SDR:
@@ -252,3 +286,116 @@ void do_sdram (const struct sdram_spd *eeprom, int length) {
             do_line (linebuf, linebuf2);
         }
 }
+
+void do_sdram (const struct sdram_spd *eeprom, int length) {
+    int checksum;
+    char linebuf[256], linebuf2[200];
+
+    PROBE2 (do_sdram_entry, eeprom, length);
+    if ((length < 2) || (length < (1 << eeprom->total_bytes))) {
+        do_printf ("Insufficient data read, aborting decode\n");
+        PROBE2 (do_sdram_return, eeprom, 0);
+        return;
+    }
+
+    /* SPD information */
+    switch (eeprom->memory_type) {
+    case MEMTYPE_SDR:
+        sprintf (linebuf, "%d", eeprom->spd_revision);
+        break;
+    case MEMTYPE_DDR:
+    case MEMTYPE_DDR2:
+        sprintf (linebuf, "%d.%d", eeprom->spd_revision >> 4,
+                 eeprom->spd_revision & 15);
+        break;
+    }
+    sprintf (linebuf2, "%d/%d bytes used",
+             eeprom->bytes_written, 1 << eeprom->total_bytes);
+    strcat (linebuf, linebuf2);
+    do_line ("SPD Revision", linebuf);
+    checksum = crc ((char *) eeprom, 63);
+    sprintf (linebuf, "%02X, %scorrect", checksum,
+             checksum == eeprom->checksum ? "" : "not ");
+    do_line ("Checksum", linebuf);
+
+    memo_decode (eeprom, length, sdram_unit_fields,
+                 sizeof (sdram_unit_fields) / sizeof (sdram_unit_fields[0]),
+                 sdram_model);
+    PROBE2 (do_sdram_return, eeprom, 1);
+}
+
+int get_sdram_info (const struct sdram_spd *eeprom, int length,
+                    struct module_info *info) {
+    int rows[MAX_RANKS], columns[MAX_RANKS];
+
+    if ((length < 2) || (length < (1 << eeprom->total_bytes)))
+        return -1;
+
+    if (eeprom->bytes_written >= 71)
+        info->vendor = get_vendor_id64 (eeprom->manufacturer_jedec_id);
+    if (eeprom->bytes_written >= 90)
+        get_part_number (info->part, eeprom->part_number,
+                         sizeof (eeprom->part_number));
+    info->ranks = sdram_geometry (eeprom, rows, columns);
+    if (info->ranks > MAX_RANKS)
+        return -1;
+    info->device_width = eeprom->primary_width;
+    info->ecc = (eeprom->config_type & (CONFIG_DATA_PARITY | CONFIG_DATA_ECC)) != 0;
+    info->size = sdram_size (eeprom, info->ranks, rows, columns);
+    if (info->ecc)
+        info->size = ceil ((double) info->size * 8.0 / 9.0);
+    if (eeprom->voltage_level < sizeof (voltage_levels) / sizeof (voltage_levels[0]))
+        strcpy (info->voltage, voltage_levels[eeprom->voltage_level]);
+    /* both at the highest CAS latency */
+    info->tck = round (cycle_time (eeprom->min_clk_cycle_cl_max_0) * 1000.0);
+    info->taa = round (max_cas_latency (eeprom) * info->tck);
+    return 0;
+}
+
+struct decoded_record *get_sdram_record (const struct sdram_spd *eeprom, int length,
+                                        struct arena *arena) {
+    struct decoded_record *record;
+    struct sdram_record *sdram;
+    int i, cl;
+
+    if (!(record = new_spd_record (RECORD_SDRAM, (const unsigned char *) eeprom,
+                                   length, arena)))
+        return NULL;
+    sdram = &record->sdram;
+    if (eeprom->bytes_written >= 99) {
+        sdram->spd.serial = eeprom->serial;
+        set_spd_date (&sdram->spd, eeprom->manufacturing_date);
+    }
+
+    /* get_sdram_info() has checked the number of ranks */
+    sdram_geometry (eeprom, sdram->rows, sdram->columns);
+    for (i = sdram->spd.ranks; i < MAX_RANKS; i++)
+        sdram->rows[i] = sdram->columns[i] = 0;
+    sdram->banks = eeprom->num_banks_device;
+
+    /* DDR latencies come in half clocks, of which the whole ones are kept */
+    for (i = 0; i < 7; i++) {
+        if (!(eeprom->cas_latency & (1 << i)))
+            continue;
+        switch (eeprom->memory_type) {
+        case MEMTYPE_SDR:
+            cl = i + 1;
+            break;
+        case MEMTYPE_DDR:
+            cl = i & 1 ? 0 : 1 + i / 2;
+            break;
+        default:
+            cl = i;
+        }
+        if (cl)
+            sdram->spd.cas_latencies |= 1ull << cl;
+    }
+
+    /* tck and taa are set by get_sdram_info(); tRCD and tRP are in quarter ns after SDR */
+    sdram->spd.trcd = eeprom->min_trcd * (eeprom->memory_type == MEMTYPE_SDR ? 1000 : 250);
+    sdram->spd.trp = eeprom->min_trp * (eeprom->memory_type == MEMTYPE_SDR ? 1000 : 250);
+    sdram->spd.tras = eeprom->min_tras * 1000;
+    if (eeprom->memory_type != MEMTYPE_SDR)
+        sdram->spd.trc = eeprom->min_trc * 1000;
+    return record;
+}
@@ -2,4 +2,12 @@
 
 #include "struct.h"
 
+struct module_info;
+struct decoded_record;
+struct arena;
+
 void do_sdram (const struct sdram_spd *eeprom, int length);
+int get_sdram_info (const struct sdram_spd *eeprom, int length,
+                    struct module_info *info);
+struct decoded_record *get_sdram_record (const struct sdram_spd *eeprom, int length,
+                                        struct arena *arena);
@@ -0,0 +1,404 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "eedid_struct.h"
+#include "vendors.h"
+#include "eeprom.h"
+#include "ddc.h"
+#include "hash.h"
+#include "container.h"
+#include "spdindex.h"
+#include "serialindex.h"
+
+/* descriptor tag of the serial number string, see eedid_constants.h */
+#define DT_SERIAL               0xff
+
+struct build {
+    struct serialindex_entry *entries;
+    uint32_t count;
+    uint32_t size;
+};
+
+static int add_serial (struct build *build, const char *serial, int kind,
+                       const unsigned char *vendor, uint32_t record) {
+    struct serialindex_entry *entry;
+
+    if (!*serial)
+        return 0;
+    if (build->count == build->size) {
+        build->size = build->size ? 2 * build->size : 1024;
+        entry = realloc (build->entries, build->size * sizeof (*entry));
+        if (!entry)
+            return -1;
+        build->entries = entry;
+    }
+    entry = &build->entries[build->count++];
+    memset (entry, 0, sizeof (*entry));
+    memcpy (entry->serial, serial, strnlen (serial, SERIALINDEX_KEY));
+    entry->kind = kind;
+    memcpy (entry->vendor, vendor, 2);
+    entry->record = htole32 (record);
+    return 0;
+}
+
+/* The serial number descriptor string, cut at the newline and trimmed */
+static void get_serial_string (char *serial, const uint8_t *data) {
+    int i;
+
+    for (i = 0; i < 13 && data[i] != 0x0a && data[i]; i++)
+        serial[i] = data[i];
+    while (i > 0 && serial[i - 1] == ' ')
+        i--;
+    serial[i] = 0;
+}
+
+/* Add all serial numbers found in one image */
+static int add_image (struct build *build, const unsigned char *image, int length,
+                      uint32_t record) {
+    const struct eedid_t *eedid = (const struct eedid_t *) image;
+    const union eighteen_bytes_descriptor_t *desc;
+    struct spd_keys keys;
+    char serial[SERIALINDEX_KEY];
+    uint32_t id;
+    int i;
+
+    if (length >= EDID_BLOCK_SIZE && is_eedid (image)) {
+        id = le32toh (eedid->id_serial_number);
+        if (id && id != 0x01010101) {
+            snprintf (serial, sizeof (serial), "%08X", id);
+            if (add_serial (build, serial, SERIAL_EDID, image + 8, record))
+                return -1;
+        }
+        for (i = 0; i < 4; i++) {
+            desc = &eedid->detailed_timings[i];
+            if (desc->timing.pixel_clock || desc->desc.tag != DT_SERIAL)
+                continue;
+            get_serial_string (serial, desc->desc.data);
+            if (add_serial (build, serial, SERIAL_EDID, image + 8, record))
+                return -1;
+        }
+        return 0;
+    }
+
+    if (get_spd_keys (image, length, &keys) || !keys.has[FIELD_SERIAL])
+        return 0;
+    /* the index key is big endian, so this reads as the number */
+    snprintf (serial, sizeof (serial), "%02X%02X%02X%02X",
+              keys.key[FIELD_SERIAL][0], keys.key[FIELD_SERIAL][1],
+              keys.key[FIELD_SERIAL][2], keys.key[FIELD_SERIAL][3]);
+    return add_serial (build, serial, SERIAL_SPD, keys.key[FIELD_VENDOR], record);
+}
+
+static int compare_entries (const void *a, const void *b) {
+    const struct serialindex_entry *x = a, *y = b;
+    int result = memcmp (x, y, offsetof (struct serialindex_entry, reserved));
+
+    if (result)
+        return result;
+    return le32toh (x->record) < le32toh (y->record) ? -1 :
+        le32toh (x->record) > le32toh (y->record);
+}
+
+static void bloom_bits (const char *serial, uint32_t bits, uint32_t *bit) {
+    uint64_t hash = hash64 (serial, SERIALINDEX_KEY);
+    uint32_t h1 = hash, h2 = (hash >> 32) | 1;
+    int i;
+
+    for (i = 0; i < SERIALINDEX_HASHES; i++)
+        bit[i] = (h1 + i * h2) & (bits - 1);
+}
+
+int serialindex_build (const char *path) {
+    struct container container;
+    struct image_info info;
+    struct build build;
+    struct serialindex_header header;
+    unsigned char *bloom = NULL;
+    uint32_t record, bits, bit[SERIALINDEX_HASHES], i;
+    char name[4096], tmpname[4100];
+    FILE *file;
+    int h, result = -1;
+
+    if (container_open (&container, path)) {
+        fprintf (stderr, "%s is not a container\n", path);
+        return -1;
+    }
+    memset (&build, 0, sizeof (build));
+    for (record = 0; record < container.count; record++)
+        if (!container_get (&container, record, &info) &&
+            add_image (&build, info.image, info.length, record))
+            goto oom;
+    qsort (build.entries, build.count, sizeof (*build.entries), compare_entries);
+
+    for (bits = 64; bits < (uint64_t) build.count * SERIALINDEX_BITS; bits *= 2);
+    if (!(bloom = calloc (bits / 8, 1)))
+        goto oom;
+    for (i = 0; i < build.count; i++) {
+        bloom_bits (build.entries[i].serial, bits, bit);
+        for (h = 0; h < SERIALINDEX_HASHES; h++)
+            bloom[bit[h] / 8] |= 1 << (bit[h] % 8);
+    }
+
+    snprintf (name, sizeof (name), "%s" SERIALINDEX_SUFFIX, path);
+    snprintf (tmpname, sizeof (tmpname), "%s.tmp", name);
+    if (!(file = fopen (tmpname, "w"))) {
+        fprintf (stderr, "Can't create %s: %s\n", tmpname, strerror (errno));
+        goto out;
+    }
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, SERIALINDEX_MAGIC, 8);
+    header.entries = htole32 (build.count);
+    header.records = htole32 (container.count);
+    header.bloom_bits = htole32 (bits);
+    header.bloom_hashes = htole32 (SERIALINDEX_HASHES);
+    fwrite (&header, sizeof (header), 1, file);
+    fwrite (bloom, bits / 8, 1, file);
+    fwrite (build.entries, sizeof (*build.entries), build.count, file);
+    if (ferror (file) | fclose (file) || rename (tmpname, name)) {
+        fprintf (stderr, "Error writing %s: %s\n", name, strerror (errno));
+        unlink (tmpname);
+        goto out;
+    }
+    printf ("Indexed %u serial numbers of %s\n", build.count, path);
+    result = 0;
+    goto out;
+
+oom:
+    fprintf (stderr, "Out of memory\n");
+out:
+    free (bloom);
+    free (build.entries);
+    container_close (&container);
+    return result;
+}
+
+/* PNP ids are three letters packed into five bits each */
+static int parse_pnp (const char *text) {
+    int i, value = 0;
+
+    if (strlen (text) != 3)
+        return -1;
+    for (i = 0; i < 3; i++) {
+        if (!isalpha ((unsigned char) text[i]))
+            return -1;
+        value = value << 5 | (toupper ((unsigned char) text[i]) - '@');
+    }
+    return value;
+}
+
+static void add_binary_serial (struct serial_query *query, unsigned long value) {
+    char serial[SERIALINDEX_KEY + 1];
+    int i;
+
+    snprintf (serial, sizeof (serial), "%08lX", value);
+    for (i = 0; i < query->count; i++)
+        if (!strncmp (query->serials[i], serial, SERIALINDEX_KEY))
+            return;
+    memcpy (query->serials[query->count++], serial, SERIALINDEX_KEY);
+}
+
+/* [VENDOR:]SERIAL, VENDOR being a JEDEC id or name or a PNP id */
+int parse_serial_query (const char *text, struct serial_query *query) {
+    const char *serial = text, *colon = strchr (text, ':');
+    char vendor[64], *end;
+    unsigned long value;
+
+    memset (query, 0, sizeof (*query));
+    query->spd_vendor = query->edid_vendor = -1;
+    if (colon) {
+        if (colon - text >= sizeof (vendor))
+            return -1;
+        memcpy (vendor, text, colon - text);
+        vendor[colon - text] = 0;
+        serial = colon + 1;
+
+        query->spd_vendor = parse_vendor16 (vendor);
+        query->edid_vendor = parse_pnp (vendor);
+        if (query->spd_vendor < 0 && query->edid_vendor < 0)
+            return -1;
+    }
+
+    if (!*serial || strlen (serial) > SERIALINDEX_KEY)
+        return -1;
+    memcpy (query->serials[query->count++], serial, strnlen (serial, SERIALINDEX_KEY));
+    if (strlen (serial) <= 8 && strspn (serial, "0123456789abcdefABCDEF") == strlen (serial))
+        add_binary_serial (query, strtoul (serial, NULL, 16));
+    value = strtoul (serial, &end, 10);
+    if (!*end && value <= 0xffffffffUL)
+        add_binary_serial (query, value);
+    return 0;
+}
+
+struct serialindex {
+    const unsigned char *map;
+    size_t size;
+    const unsigned char *bloom;
+    uint32_t bits;
+    const struct serialindex_entry *entries;
+    uint32_t count;
+    uint32_t records;
+};
+
+static int serialindex_open (struct serialindex *index, const char *container) {
+    const struct serialindex_header *header;
+    char name[4096];
+    struct stat statbuf;
+    void *map;
+    int fd;
+
+    snprintf (name, sizeof (name), "%s" SERIALINDEX_SUFFIX, container);
+    if ((fd = open (name, O_RDONLY)) < 0) {
+        fprintf (stderr, "Can't open %s: %s\n", name, strerror (errno));
+        return -1;
+    }
+    if (fstat (fd, &statbuf) || statbuf.st_size < sizeof (*header)) {
+        fprintf (stderr, "%s is not a serial index\n", name);
+        close (fd);
+        return -1;
+    }
+    map = mmap (NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        fprintf (stderr, "Can't mmap() %s: %s\n", name, strerror (errno));
+        return -1;
+    }
+
+    header = map;
+    index->map = map;
+    index->size = statbuf.st_size;
+    index->bits = le32toh (header->bloom_bits);
+    index->count = le32toh (header->entries);
+    index->records = le32toh (header->records);
+    index->bloom = (const unsigned char *) (header + 1);
+    index->entries = (const struct serialindex_entry *) (index->bloom + index->bits / 8);
+    if (memcmp (header->magic, SERIALINDEX_MAGIC, 8) ||
+        le32toh (header->bloom_hashes) != SERIALINDEX_HASHES ||
+        index->bits < 64 || (index->bits & (index->bits - 1)) ||
+        sizeof (*header) + index->bits / 8 +
+        (uint64_t) index->count * sizeof (struct serialindex_entry) > index->size) {
+        fprintf (stderr, "%s is not a valid serial index\n", name);
+        munmap (map, statbuf.st_size);
+        return -1;
+    }
+    return 0;
+}
+
+static int bloom_contains (const struct serialindex *index, const char *serial) {
+    uint32_t bit[SERIALINDEX_HASHES];
+    int h;
+
+    bloom_bits (serial, index->bits, bit);
+    for (h = 0; h < SERIALINDEX_HASHES; h++)
+        if (!(index->bloom[bit[h] / 8] & (1 << (bit[h] % 8))))
+            return 0;
+    return 1;
+}
+
+static void print_sighting (const char *path, const struct container *container,
+                            const struct serialindex_entry *entry) {
+    struct image_info info;
+    uint32_t record = le32toh (entry->record);
+    int vendor = entry->vendor[0] << 8 | entry->vendor[1];
+    char label[1024], pnp[4];
+
+    if (container_get (container, record, &info)) {
+        fprintf (stderr, "%s: record %u is corrupt\n", path, record);
+        return;
+    }
+    if (info.source == SOURCE_I2C || info.source == SOURCE_DP_AUX)
+        snprintf (label, sizeof (label), "%s record %u (%s, %s %s client 0x%02x)",
+                  path, record, info.host, source_name (info.source),
+                  info.adapter, info.client);
+    else
+        snprintf (label, sizeof (label), "%s record %u (%s, %s %s)",
+                  path, record, info.host, source_name (info.source),
+                  info.adapter);
+    if (entry->kind == SERIAL_EDID) {
+        pnp[0] = '@' + ((vendor >> 10) & 0x1f);
+        pnp[1] = '@' + ((vendor >> 5) & 0x1f);
+        pnp[2] = '@' + (vendor & 0x1f);
+        pnp[3] = 0;
+        printf ("%s: display %s serial %.16s\n", label, pnp, entry->serial);
+    } else
+        printf ("%s: module %s serial %.16s\n", label, get_vendor16 (vendor),
+                entry->serial);
+}
+
+/* Print the sightings of one serial in an index; returns their number */
+static uint32_t lookup (const char *path, const struct container *container,
+                        const struct serialindex *index, const char *serial,
+                        const struct serial_query *query) {
+    const struct serialindex_entry *entry;
+    uint32_t lo = 0, hi = index->count, mid, matches = 0;
+    int vendor;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        if (memcmp (index->entries[mid].serial, serial, SERIALINDEX_KEY) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    for (entry = &index->entries[lo];
+         entry < index->entries + index->count &&
+         !memcmp (entry->serial, serial, SERIALINDEX_KEY); entry++) {
+        vendor = entry->vendor[0] << 8 | entry->vendor[1];
+        if ((query->spd_vendor >= 0 || query->edid_vendor >= 0) &&
+            vendor != (entry->kind == SERIAL_EDID ? query->edid_vendor : query->spd_vendor))
+            continue;
+        print_sighting (path, container, entry);
+        matches++;
+    }
+    return matches;
+}
+
+/*
+ * Print every sighting of a serial in the given containers; those whose
+ * Bloom filter rules it out are not looked at any further.
+ */
+int serialindex_query (int count, char **paths, const struct serial_query *query) {
+    struct container container;
+    struct serialindex index;
+    int i, s, candidates[3], found, containers = 0, skipped = 0;
+    uint32_t matches = 0, n;
+
+    for (i = 0; i < count; i++) {
+        if (serialindex_open (&index, paths[i]))
+            continue;
+        for (s = found = 0; s < query->count; s++)
+            found |= candidates[s] = bloom_contains (&index, query->serials[s]);
+        if (!found) {
+            skipped++;
+            munmap ((void *) index.map, index.size);
+            continue;
+        }
+        if (container_open (&container, paths[i])) {
+            fprintf (stderr, "%s is not a container\n", paths[i]);
+            munmap ((void *) index.map, index.size);
+            continue;
+        }
+        if (index.records != container.count)
+            fprintf (stderr, "Warning: %s" SERIALINDEX_SUFFIX " is out of date\n",
+                     paths[i]);
+        for (s = n = 0; s < query->count; s++)
+            if (candidates[s])
+                n += lookup (paths[i], &container, &index, query->serials[s], query);
+        if (n)
+            containers++;
+        matches += n;
+        container_close (&container);
+        munmap ((void *) index.map, index.size);
+    }
+    printf ("%u sightings in %d of %d containers, %d ruled out by their filter\n",
+            matches, containers, count, skipped);
+    return matches;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Index of the serial numbers seen in a container, stored next to it as
+ * <container>.serials:
+ *
+ *   header | Bloom filter | sorted entry table
+ *
+ * Serials are kept as text: the binary SPD and EDID ID serial numbers as
+ * 8 hex digits, the EDID serial number descriptor as its string. The
+ * Bloom filter covers the serial alone, so a lookup rejects most
+ * containers after touching a few cache lines of the filter; the entries
+ * are sorted by serial, kind and vendor and binary searched otherwise.
+ * All values are little endian unless noted.
+ */
+#define SERIALINDEX_MAGIC       "DSPDSER1"
+#define SERIALINDEX_SUFFIX      ".serials"
+#define SERIALINDEX_KEY         16
+/* bits per serial and probes in the Bloom filter, about 1% false positives */
+#define SERIALINDEX_BITS        10
+#define SERIALINDEX_HASHES      7
+
+enum {
+    SERIAL_SPD = 0,             /* JEDEC vendor */
+    SERIAL_EDID                 /* PNP vendor as stored in the EDID */
+};
+
+#pragma pack(1)
+struct serialindex_header {
+    char magic[8];
+    uint32_t entries;
+    uint32_t records;
+    uint32_t bloom_bits;        /* a power of two */
+    uint32_t bloom_hashes;
+};
+
+struct serialindex_entry {
+    char serial[SERIALINDEX_KEY];   /* zero padded */
+    uint8_t kind;                   /* SERIAL_* */
+    uint8_t vendor[2];              /* big endian */
+    uint8_t reserved;
+    uint32_t record;
+};
+#pragma pack()
+
+/*
+ * [VENDOR:]SERIAL; the serial is looked up as given and, if it can be
+ * one, as a hex or decimal binary serial number. Vendors are -1 if not
+ * given or not of that kind.
+ */
+struct serial_query {
+    char serials[3][SERIALINDEX_KEY];
+    int count;
+    int spd_vendor;
+    int edid_vendor;
+};
+
+int parse_serial_query (const char *text, struct serial_query *query);
+int serialindex_build (const char *container);
+int serialindex_query (int count, char **containers, const struct serial_query *query);
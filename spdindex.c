@@ -0,0 +1,476 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "constants.h"
+#include "struct.h"
+#include "vendors.h"
+#include "eeprom.h"
+#include "container.h"
+#include "files.h"
+#include "spdindex.h"
+
+const char *field_names[NUM_FIELDS] = {
+    "type", "vendor", "dram_vendor", "part", "serial", "date"
+};
+
+const int field_key_sizes[NUM_FIELDS] = { 1, 2, 2, SPDINDEX_MAX_KEY, 4, 2 };
+
+struct build_entry {
+    unsigned char key[SPDINDEX_MAX_KEY];
+    uint32_t record;
+};
+
+static void put_be16 (unsigned char *key, unsigned int value) {
+    key[0] = value >> 8;
+    key[1] = value;
+}
+
+static void put_be32 (unsigned char *key, uint32_t value) {
+    key[0] = value >> 24;
+    key[1] = value >> 16;
+    key[2] = value >> 8;
+    key[3] = value;
+}
+
+static void put_part (unsigned char *key, const unsigned char *part, int length) {
+    int i;
+
+    for (i = 0; i < SPDINDEX_MAX_KEY; i++)
+        key[i] = (i < length && part[i] && part[i] != 0xff) ? part[i] : ' ';
+}
+
+/* manufacturing date as stored: year in the first byte, week in the second */
+static void put_date (unsigned char *key, uint16_t date) {
+    key[0] = le16toh (date) & 0xff;
+    key[1] = le16toh (date) >> 8;
+}
+
+/* Extract the indexed fields from the struct.h layout matching the image */
+int get_spd_keys (const unsigned char *image, int length, struct spd_keys *keys) {
+    memset (keys, 0, sizeof (*keys));
+    if (length < 128)
+        return -1;
+
+    keys->key[FIELD_TYPE][0] = image[2];
+    keys->has[FIELD_TYPE] = 1;
+
+    switch (image[2]) {
+    case MEMTYPE_SDR:
+    case MEMTYPE_DDR:
+    case MEMTYPE_DDR2: {
+        const struct sdram_spd *spd = (const struct sdram_spd *) image;
+
+        put_be16 (keys->key[FIELD_VENDOR], get_vendor_id64 (spd->manufacturer_jedec_id));
+        put_part (keys->key[FIELD_PART], spd->part_number, sizeof (spd->part_number));
+        put_be32 (keys->key[FIELD_SERIAL], le32toh (spd->serial));
+        put_date (keys->key[FIELD_DATE], spd->manufacturing_date);
+        keys->has[FIELD_VENDOR] = keys->has[FIELD_PART] = 1;
+        keys->has[FIELD_SERIAL] = keys->has[FIELD_DATE] = 1;
+        break;
+    }
+    case MEMTYPE_DDR3: {
+        const struct ddr3_sdram_spd *spd = (const struct ddr3_sdram_spd *) image;
+
+        if (length < 256)
+            break;
+        put_be16 (keys->key[FIELD_VENDOR], le16toh (spd->manufacturer_jedec_id));
+        put_be16 (keys->key[FIELD_DRAM_VENDOR], le16toh (spd->dram_manufacturer_jedec_id));
+        put_part (keys->key[FIELD_PART], spd->part_number, sizeof (spd->part_number));
+        put_be32 (keys->key[FIELD_SERIAL], le32toh (spd->serial_number));
+        put_date (keys->key[FIELD_DATE], spd->manufacturing_date);
+        keys->has[FIELD_VENDOR] = keys->has[FIELD_DRAM_VENDOR] = 1;
+        keys->has[FIELD_PART] = keys->has[FIELD_SERIAL] = keys->has[FIELD_DATE] = 1;
+        break;
+    }
+    case MEMTYPE_DDR4:
+    case MEMTYPE_DDR4E: {
+        const struct ddr4_sdram_spd *spd = (const struct ddr4_sdram_spd *) image;
+
+        if (length < 384)
+            break;
+        put_be16 (keys->key[FIELD_VENDOR], le16toh (spd->manufacturer_jedec_id));
+        put_be16 (keys->key[FIELD_DRAM_VENDOR], le16toh (spd->dram_manufacturer_jedec_id));
+        put_part (keys->key[FIELD_PART], spd->part_number, sizeof (spd->part_number));
+        put_be32 (keys->key[FIELD_SERIAL], le32toh (spd->serial_number));
+        put_date (keys->key[FIELD_DATE], spd->manufacturing_date);
+        keys->has[FIELD_VENDOR] = keys->has[FIELD_DRAM_VENDOR] = 1;
+        keys->has[FIELD_PART] = keys->has[FIELD_SERIAL] = keys->has[FIELD_DATE] = 1;
+        break;
+    }
+    }
+    return 0;
+}
+
+static int compare_entries (const void *a, const void *b) {
+    const struct build_entry *x = a, *y = b;
+    int result = memcmp (x->key, y->key, SPDINDEX_MAX_KEY);
+
+    if (result)
+        return result;
+    return x->record < y->record ? -1 : x->record > y->record;
+}
+
+int spdindex_build (const char *path) {
+    struct container container;
+    struct image_info info;
+    struct spd_keys keys;
+    struct build_entry *entries[NUM_FIELDS];
+    struct spdindex_header header;
+    struct spdindex_section sections[NUM_FIELDS];
+    int count[NUM_FIELDS];
+    char name[4096], tmpname[4100];
+    uint64_t offset;
+    uint32_t record;
+    unsigned char entry[SPDINDEX_MAX_KEY + 4];
+    FILE *file;
+    int f, i, result = -1;
+
+    if (container_open (&container, path)) {
+        fprintf (stderr, "%s is not a container\n", path);
+        return -1;
+    }
+
+    for (f = 0; f < NUM_FIELDS; f++) {
+        count[f] = 0;
+        entries[f] = malloc ((container.count ? container.count : 1) *
+                             sizeof (struct build_entry));
+    }
+    for (f = 0; f < NUM_FIELDS; f++)
+        if (!entries[f]) {
+            fprintf (stderr, "Out of memory\n");
+            goto out;
+        }
+
+    for (record = 0; record < container.count; record++) {
+        if (container_get (&container, record, &info) ||
+            get_spd_keys (info.image, info.length, &keys))
+            continue;
+        for (f = 0; f < NUM_FIELDS; f++)
+            if (keys.has[f]) {
+                memcpy (entries[f][count[f]].key, keys.key[f], SPDINDEX_MAX_KEY);
+                entries[f][count[f]].record = record;
+                count[f]++;
+            }
+    }
+
+    snprintf (name, sizeof (name), "%s" SPDINDEX_SUFFIX, path);
+    snprintf (tmpname, sizeof (tmpname), "%s.tmp", name);
+    if (!(file = fopen (tmpname, "w"))) {
+        fprintf (stderr, "Can't create %s: %s\n", tmpname, strerror (errno));
+        goto out;
+    }
+
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, SPDINDEX_MAGIC, 8);
+    header.fields = htole32 (NUM_FIELDS);
+    header.records = htole32 (container.count);
+    fwrite (&header, sizeof (header), 1, file);
+
+    offset = sizeof (header) + sizeof (sections);
+    for (f = 0; f < NUM_FIELDS; f++) {
+        memset (&sections[f], 0, sizeof (sections[f]));
+        sections[f].field = htole32 (f);
+        sections[f].key_size = htole32 (field_key_sizes[f]);
+        sections[f].offset = htole64 (offset);
+        sections[f].count = htole32 (count[f]);
+        offset += (uint64_t) count[f] * (field_key_sizes[f] + 4);
+    }
+    fwrite (sections, sizeof (sections), 1, file);
+
+    for (f = 0; f < NUM_FIELDS; f++) {
+        qsort (entries[f], count[f], sizeof (struct build_entry), compare_entries);
+        for (i = 0; i < count[f]; i++) {
+            uint32_t le_record = htole32 (entries[f][i].record);
+
+            memcpy (entry, entries[f][i].key, field_key_sizes[f]);
+            memcpy (entry + field_key_sizes[f], &le_record, 4);
+            fwrite (entry, field_key_sizes[f] + 4, 1, file);
+        }
+    }
+
+    if (ferror (file) | fclose (file) || rename (tmpname, name)) {
+        fprintf (stderr, "Error writing %s: %s\n", name, strerror (errno));
+        unlink (tmpname);
+        goto out;
+    }
+    printf ("Indexed %u records of %s\n", container.count, path);
+    result = 0;
+
+out:
+    for (f = 0; f < NUM_FIELDS; f++)
+        free (entries[f]);
+    container_close (&container);
+    return result;
+}
+
+static int bcd (int value) {
+    return ((value / 10) % 10) << 4 | (value % 10);
+}
+
+/* Parse one bound of a query; low selects the lower or upper end */
+static int parse_bound (int field, const char *text, unsigned char *key, int low) {
+    static const struct { const char *name; int type; } types[] = {
+        { "sdr", MEMTYPE_SDR }, { "ddr", MEMTYPE_DDR }, { "ddr2", MEMTYPE_DDR2 },
+        { "ddr3", MEMTYPE_DDR3 }, { "ddr4", MEMTYPE_DDR4 },
+        { "ddr4e", MEMTYPE_DDR4E }, { "edid", 0xff }
+    };
+    unsigned long value;
+    char *end;
+    int i, year, week;
+
+    memset (key, low ? 0x00 : 0xff, SPDINDEX_MAX_KEY);
+    switch (field) {
+    case FIELD_TYPE:
+        for (i = 0; i < sizeof (types) / sizeof (types[0]); i++)
+            if (!strcasecmp (text, types[i].name)) {
+                key[0] = types[i].type;
+                return 0;
+            }
+        value = strtoul (text, &end, 0);
+        if (*end || value > 0xff)
+            return -1;
+        key[0] = value;
+        return 0;
+    case FIELD_VENDOR:
+    case FIELD_DRAM_VENDOR:
+        if ((i = parse_vendor16 (text)) < 0)
+            return -1;
+        put_be16 (key, i);
+        return 0;
+    case FIELD_PART:
+        /* prefix match: pad with the lowest or highest byte */
+        if (strlen (text) > SPDINDEX_MAX_KEY)
+            return -1;
+        memcpy (key, text, strlen (text));
+        return 0;
+    case FIELD_SERIAL:
+        value = strtoul (text, &end, 16);
+        if (*end || value > 0xffffffffUL)
+            return -1;
+        put_be32 (key, value);
+        return 0;
+    case FIELD_DATE:
+        year = strtol (text, &end, 10);
+        if (end == text)
+            return -1;
+        if (!*end) {
+            key[0] = bcd (year);
+            key[1] = low ? 0x00 : 0xff;
+            return 0;
+        }
+        if (*end++ != '-')
+            return -1;
+        while (*end == 'w' || *end == 'k' || *end == 'W' || *end == 'K')
+            end++;
+        week = strtol (end, &end, 10);
+        if (*end)
+            return -1;
+        key[0] = bcd (year);
+        key[1] = bcd (week);
+        return 0;
+    }
+    return -1;
+}
+
+/* FIELD=VALUE or FIELD=LOW..HIGH */
+int parse_spd_query (const char *text, struct spd_query *query) {
+    char buffer[256], *value, *high;
+    int f;
+
+    snprintf (buffer, sizeof (buffer), "%s", text);
+    if (!(value = strchr (buffer, '=')))
+        return -1;
+    *value++ = 0;
+    for (f = 0; f < NUM_FIELDS; f++)
+        if (!strcasecmp (buffer, field_names[f]))
+            break;
+    if (f == NUM_FIELDS)
+        return -1;
+    query->field = f;
+
+    if ((high = strstr (value, ".."))) {
+        *high = 0;
+        high += 2;
+    } else
+        high = value;
+    if (parse_bound (f, value, query->low, 1) || parse_bound (f, high, query->high, 0))
+        return -1;
+    return 0;
+}
+
+struct spdindex {
+    const unsigned char *map;
+    size_t size;
+    const struct spdindex_section *sections;
+    uint32_t records;
+};
+
+static int spdindex_open (struct spdindex *index, const char *container) {
+    const struct spdindex_header *header;
+    char name[4096];
+    struct stat statbuf;
+    void *map;
+    int fd, f;
+
+    snprintf (name, sizeof (name), "%s" SPDINDEX_SUFFIX, container);
+    if ((fd = open (name, O_RDONLY)) < 0) {
+        fprintf (stderr, "Can't open %s: %s\n", name, strerror (errno));
+        return -1;
+    }
+    if (fstat (fd, &statbuf) ||
+        statbuf.st_size < sizeof (*header) + NUM_FIELDS * sizeof (struct spdindex_section)) {
+        fprintf (stderr, "%s is not an index\n", name);
+        close (fd);
+        return -1;
+    }
+    map = mmap (NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED) {
+        fprintf (stderr, "Can't mmap() %s: %s\n", name, strerror (errno));
+        return -1;
+    }
+
+    header = map;
+    index->map = map;
+    index->size = statbuf.st_size;
+    index->sections = (const struct spdindex_section *) (header + 1);
+    index->records = le32toh (header->records);
+    if (memcmp (header->magic, SPDINDEX_MAGIC, 8) ||
+        le32toh (header->fields) != NUM_FIELDS)
+        goto invalid;
+    for (f = 0; f < NUM_FIELDS; f++)
+        if (le32toh (index->sections[f].key_size) != field_key_sizes[f] ||
+            le64toh (index->sections[f].offset) > index->size ||
+            le32toh (index->sections[f].count) >
+            (index->size - le64toh (index->sections[f].offset)) / (field_key_sizes[f] + 4))
+            goto invalid;
+    return 0;
+
+invalid:
+    fprintf (stderr, "%s is not a valid index\n", name);
+    munmap (map, statbuf.st_size);
+    return -1;
+}
+
+/* first entry whose key is >= key, or > key if upper is set */
+static uint32_t search (const unsigned char *entries, uint32_t count, int key_size,
+                        const unsigned char *key, int upper) {
+    uint32_t lo = 0, hi = count, mid;
+    int result;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo) / 2;
+        result = memcmp (entries + (size_t) mid * (key_size + 4), key, key_size);
+        if (result < 0 || (upper && result == 0))
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+static int compare_records (const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+
+    return x < y ? -1 : x > y;
+}
+
+/* Sorted record numbers matching one query, their count in n */
+static int lookup (const struct spdindex *index, const struct spd_query *query,
+                   uint32_t **records, uint32_t *n) {
+    const struct spdindex_section *section = &index->sections[query->field];
+    const unsigned char *entries = index->map + le64toh (section->offset);
+    int key_size = field_key_sizes[query->field];
+    uint32_t count = le32toh (section->count);
+    uint32_t first, last, i;
+
+    first = search (entries, count, key_size, query->low, 0);
+    last = search (entries, count, key_size, query->high, 1);
+    if (last < first)
+        last = first;
+
+    *records = malloc (((last - first) ? (last - first) : 1) * sizeof (uint32_t));
+    if (!*records) {
+        fprintf (stderr, "Out of memory\n");
+        return -1;
+    }
+    for (i = first; i < last; i++) {
+        uint32_t record;
+
+        memcpy (&record, entries + (size_t) i * (key_size + 4) + key_size, 4);
+        (*records)[i - first] = le32toh (record);
+    }
+    qsort (*records, last - first, sizeof (uint32_t), compare_records);
+    *n = last - first;
+    return 0;
+}
+
+static uint32_t intersect (uint32_t *a, uint32_t na, const uint32_t *b, uint32_t nb) {
+    uint32_t i = 0, j = 0, n = 0;
+
+    while (i < na && j < nb)
+        if (a[i] < b[j])
+            i++;
+        else if (a[i] > b[j])
+            j++;
+        else {
+            a[n++] = a[i];
+            i++;
+            j++;
+        }
+    return n;
+}
+
+/* Decode the records of container that match all queries */
+int spdindex_query (const char *path, int count, const struct spd_query *queries) {
+    struct container container;
+    struct spdindex index;
+    uint32_t *result = NULL, *records, matches = 0, n, i;
+    int q;
+
+    if (container_open (&container, path)) {
+        fprintf (stderr, "%s is not a container\n", path);
+        return -1;
+    }
+    if (spdindex_open (&index, path)) {
+        container_close (&container);
+        return -1;
+    }
+    if (index.records != container.count)
+        fprintf (stderr, "Warning: %s" SPDINDEX_SUFFIX " is out of date\n", path);
+
+    for (q = 0; q < count; q++) {
+        if (lookup (&index, &queries[q], &records, &n)) {
+            free (result);
+            munmap ((void *) index.map, index.size);
+            container_close (&container);
+            return -1;
+        }
+        if (!result) {
+            result = records;
+            matches = n;
+        } else {
+            matches = intersect (result, matches, records, n);
+            free (records);
+        }
+    }
+
+    for (i = 0; i < matches; i++)
+        if (result[i] < container.count)
+            decode_record (path, &container, result[i]);
+    printf ("%u matching records in %s\n", matches, path);
+
+    free (result);
+    munmap ((void *) index.map, index.size);
+    container_close (&container);
+    return matches;
+}
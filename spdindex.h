@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Secondary indexes over the records of a container, stored next to it
+ * as <container>.idx:
+ *
+ *   header | section table | sorted section per field
+ *
+ * Each section holds one entry per record carrying the field, made of
+ * the key (big endian, so memcmp() order is numeric order) followed by
+ * the little endian record number, sorted by key and record. Lookups
+ * are binary searches over the mapped sections.
+ */
+#define SPDINDEX_MAGIC          "DSPDSIX1"
+#define SPDINDEX_SUFFIX         ".idx"
+#define SPDINDEX_MAX_KEY        20
+
+enum {
+    FIELD_TYPE = 0,             /* memory type, byte 2 */
+    FIELD_VENDOR,               /* module manufacturer JEDEC id */
+    FIELD_DRAM_VENDOR,          /* DRAM manufacturer JEDEC id */
+    FIELD_PART,                 /* part number, space padded */
+    FIELD_SERIAL,               /* serial number */
+    FIELD_DATE,                 /* manufacturing year and week, BCD */
+    NUM_FIELDS
+};
+
+#pragma pack(1)
+struct spdindex_header {
+    char magic[8];
+    uint32_t fields;
+    uint32_t records;
+};
+
+struct spdindex_section {
+    uint32_t field;
+    uint32_t key_size;
+    uint64_t offset;
+    uint32_t count;
+    uint32_t reserved;
+};
+#pragma pack()
+
+/* the indexed fields of one image; has[] is 0 for fields it lacks */
+struct spd_keys {
+    unsigned char key[NUM_FIELDS][SPDINDEX_MAX_KEY];
+    int has[NUM_FIELDS];
+};
+
+/* FIELD=VALUE or FIELD=LOW..HIGH, with the bounds as index keys */
+struct spd_query {
+    int field;
+    unsigned char low[SPDINDEX_MAX_KEY];
+    unsigned char high[SPDINDEX_MAX_KEY];
+};
+
+extern const char *field_names[NUM_FIELDS];
+extern const int field_key_sizes[NUM_FIELDS];
+
+int get_spd_keys (const unsigned char *image, int length, struct spd_keys *keys);
+int parse_spd_query (const char *text, struct spd_query *query);
+int spdindex_build (const char *container);
+int spdindex_query (const char *container, int count,
+                    const struct spd_query *queries);
@@ -0,0 +1,385 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <errno.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "hash.h"
+#include "container.h"
+#include "store.h"
+
+static int check_header (const unsigned char *map, size_t size,
+                         const char *magic) {
+    return size >= sizeof (struct store_header) && !memcmp (map, magic, 8);
+}
+
+static const unsigned char *map_file (const char *dir, const char *name,
+                                      size_t *size) {
+    struct stat statbuf;
+    char path[4096];
+    void *map;
+    int fd;
+
+    snprintf (path, sizeof (path), "%s/%s", dir, name);
+    if ((fd = open (path, O_RDONLY)) < 0)
+        return NULL;
+    if (fstat (fd, &statbuf) || statbuf.st_size == 0) {
+        close (fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    map = mmap (NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+        return NULL;
+    *size = statbuf.st_size;
+    return map;
+}
+
+int is_store (const char *dir) {
+    char path[4096], magic[8];
+    int fd, result;
+
+    snprintf (path, sizeof (path), "%s/%s", dir, STORE_SIGHTINGS);
+    if ((fd = open (path, O_RDONLY)) < 0)
+        return 0;
+    result = read (fd, magic, 8) == 8 && !memcmp (magic, STORE_SIGHTINGS_MAGIC, 8);
+    close (fd);
+    return result;
+}
+
+int store_map (struct store *store, const char *dir) {
+    memset (store, 0, sizeof (*store));
+    if (!(store->images = map_file (dir, STORE_IMAGES, &store->images_size)))
+        return -1;
+    if (!(store->sightings = map_file (dir, STORE_SIGHTINGS, &store->sightings_size)) ||
+        !check_header (store->images, store->images_size, STORE_IMAGES_MAGIC) ||
+        !check_header (store->sightings, store->sightings_size, STORE_SIGHTINGS_MAGIC)) {
+        store_unmap (store);
+        errno = EINVAL;
+        return -1;
+    }
+    return 0;
+}
+
+void store_unmap (struct store *store) {
+    if (store->images)
+        munmap ((void *) store->images, store->images_size);
+    if (store->sightings)
+        munmap ((void *) store->sightings, store->sightings_size);
+    memset (store, 0, sizeof (*store));
+}
+
+/*
+ * Fetch the sighting at *offset (0 for the first one) with its image and
+ * advance *offset. Returns 1 for a sighting, 0 at the end and -1 if the
+ * store is corrupt.
+ */
+int store_next (const struct store *store, size_t *offset,
+                struct image_info *info) {
+    const struct store_sighting *sighting;
+    const struct store_image *image;
+    const unsigned char *names;
+    uint64_t image_offset;
+
+    if (*offset < sizeof (struct store_header))
+        *offset = sizeof (struct store_header);
+    if (*offset == store->sightings_size)
+        return 0;
+    if (*offset + sizeof (*sighting) > store->sightings_size)
+        return -1;
+
+    sighting = (const struct store_sighting *) (store->sightings + *offset);
+    names = (const unsigned char *) (sighting + 1);
+    if (*offset + sizeof (*sighting) + sighting->host_length +
+        sighting->adapter_length > store->sightings_size)
+        return -1;
+
+    /* subtract first, the offset comes from the file and may be anything */
+    image_offset = le64toh (sighting->image);
+    if (image_offset < sizeof (struct store_header) ||
+        image_offset > store->images_size ||
+        store->images_size - image_offset < sizeof (*image))
+        return -1;
+    image = (const struct store_image *) (store->images + image_offset);
+    if (le32toh (image->length) > INT_MAX ||
+        le32toh (image->length) > store->images_size - sizeof (*image) - image_offset)
+        return -1;
+
+    info->source = sighting->source;
+    info->client = sighting->client;
+    info->timestamp = le64toh (sighting->timestamp);
+    memcpy (info->host, names, sighting->host_length);
+    info->host[sighting->host_length] = 0;
+    memcpy (info->adapter, names + sighting->host_length, sighting->adapter_length);
+    info->adapter[sighting->adapter_length] = 0;
+    info->image = (const unsigned char *) (image + 1);
+    info->length = le32toh (image->length);
+
+    *offset += sizeof (*sighting) + sighting->host_length + sighting->adapter_length;
+    return 1;
+}
+
+/*
+ * Ingestion: the images already in the store are looked up through an
+ * open addressing hash table keyed by hash64(); a hash match is only
+ * taken for a duplicate after comparing the bytes. Images stored before
+ * this run are compared against a mapping of the images file, new ones
+ * against a private copy.
+ */
+struct known_image {
+    uint64_t hash;
+    uint64_t offset;            /* 0 for an empty slot */
+    const unsigned char *image;
+    uint32_t length;
+    int copied;                 /* image is a private copy */
+};
+
+static struct {
+    FILE *images;
+    FILE *sightings;
+    char host[256];
+    const unsigned char *map;
+    size_t map_size;
+    uint64_t images_offset;
+    struct known_image *table;
+    uint32_t table_size;        /* a power of two */
+    uint32_t table_count;
+    uint32_t new_images;
+    uint32_t new_sightings;
+} ingest;
+
+static pthread_mutex_t ingest_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static struct known_image *find_slot (struct known_image *table, uint32_t size,
+                                      uint64_t hash, const unsigned char *image,
+                                      uint32_t length) {
+    uint32_t i;
+
+    for (i = hash & (size - 1); table[i].offset; i = (i + 1) & (size - 1))
+        if (table[i].hash == hash && table[i].length == length &&
+            !memcmp (table[i].image, image, length))
+            break;
+    return &table[i];
+}
+
+static struct known_image *add_known (uint64_t hash, uint64_t offset,
+                                      const unsigned char *image,
+                                      uint32_t length) {
+    struct known_image *table, *slot;
+    uint32_t i, size;
+
+    if (2 * (ingest.table_count + 1) > ingest.table_size) {
+        size = ingest.table_size ? 2 * ingest.table_size : 1024;
+        if (!(table = calloc (size, sizeof (*table))))
+            return NULL;
+        for (i = 0; i < ingest.table_size; i++)
+            if (ingest.table[i].offset)
+                *find_slot (table, size, ingest.table[i].hash,
+                            ingest.table[i].image, ingest.table[i].length) =
+                    ingest.table[i];
+        free (ingest.table);
+        ingest.table = table;
+        ingest.table_size = size;
+    }
+    slot = find_slot (ingest.table, ingest.table_size, hash, image, length);
+    slot->hash = hash;
+    slot->offset = offset;
+    slot->image = image;
+    slot->length = length;
+    ingest.table_count++;
+    return slot;
+}
+
+/* Open or create one of the store files for appending */
+static FILE *open_store_file (const char *dir, const char *name,
+                              const char *magic, uint64_t *size) {
+    struct store_header header;
+    struct stat statbuf;
+    char path[4096];
+    FILE *file;
+    int fd;
+
+    snprintf (path, sizeof (path), "%s/%s", dir, name);
+    if ((fd = open (path, O_RDWR | O_CREAT | O_APPEND, 0644)) < 0 ||
+        fstat (fd, &statbuf)) {
+        fprintf (stderr, "Can't open %s: %s\n", path, strerror (errno));
+        if (fd >= 0)
+            close (fd);
+        return NULL;
+    }
+    if (flock (fd, LOCK_EX | LOCK_NB)) {
+        fprintf (stderr, "Can't lock %s: %s\n", path, strerror (errno));
+        close (fd);
+        return NULL;
+    }
+    if (statbuf.st_size == 0) {
+        memset (&header, 0, sizeof (header));
+        memcpy (header.magic, magic, 8);
+        header.version = htole32 (1);
+        if (write (fd, &header, sizeof (header)) != sizeof (header)) {
+            fprintf (stderr, "Can't write %s: %s\n", path, strerror (errno));
+            close (fd);
+            return NULL;
+        }
+        statbuf.st_size = sizeof (header);
+    } else if (pread (fd, &header, sizeof (header), 0) != sizeof (header) ||
+               memcmp (header.magic, magic, 8)) {
+        fprintf (stderr, "%s is not part of an image store\n", path);
+        close (fd);
+        return NULL;
+    }
+    if (!(file = fdopen (fd, "a"))) {
+        fprintf (stderr, "Can't open %s: %s\n", path, strerror (errno));
+        close (fd);
+        return NULL;
+    }
+    *size = statbuf.st_size;
+    return file;
+}
+
+/* Load the images already in the store into the lookup table */
+static int load_images (const char *dir) {
+    const struct store_image *image;
+    uint64_t offset;
+    uint32_t length;
+
+    if (ingest.images_offset == sizeof (struct store_header))
+        return 0;
+    if (!(ingest.map = map_file (dir, STORE_IMAGES, &ingest.map_size))) {
+        fprintf (stderr, "Can't map %s/%s: %s\n", dir, STORE_IMAGES, strerror (errno));
+        return -1;
+    }
+    for (offset = sizeof (struct store_header); offset < ingest.map_size;
+         offset += sizeof (*image) + length) {
+        image = (const struct store_image *) (ingest.map + offset);
+        if (ingest.map_size - offset < sizeof (*image) ||
+            le32toh (image->length) > ingest.map_size - sizeof (*image) - offset) {
+            fprintf (stderr, "%s/%s is corrupt at offset %llu\n", dir, STORE_IMAGES,
+                     (unsigned long long) offset);
+            return -1;
+        }
+        length = le32toh (image->length);
+        if (!add_known (le64toh (image->hash), offset,
+                        (const unsigned char *) (image + 1), length)) {
+            fprintf (stderr, "Out of memory\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int store_open (const char *dir) {
+    uint64_t size;
+
+    if (mkdir (dir, 0755) && errno != EEXIST) {
+        fprintf (stderr, "Can't create %s: %s\n", dir, strerror (errno));
+        return -1;
+    }
+    if (!(ingest.images = open_store_file (dir, STORE_IMAGES, STORE_IMAGES_MAGIC,
+                                           &ingest.images_offset)) ||
+        !(ingest.sightings = open_store_file (dir, STORE_SIGHTINGS,
+                                              STORE_SIGHTINGS_MAGIC, &size)) ||
+        load_images (dir)) {
+        store_close ();
+        return -1;
+    }
+    if (gethostname (ingest.host, sizeof (ingest.host)))
+        strcpy (ingest.host, "unknown");
+    ingest.host[sizeof (ingest.host) - 1] = 0;
+    return 0;
+}
+
+int store_is_open (void) {
+    return ingest.sightings != NULL;
+}
+
+/* Record a sighting of an image, storing the image if it is new */
+void store_add (const struct image_info *info) {
+    struct store_sighting sighting;
+    struct store_image header;
+    struct known_image *known;
+    const char *host = info->host[0] ? info->host : ingest.host;
+    unsigned char *copy;
+    uint64_t hash;
+    int host_length, adapter_length;
+
+    if (!ingest.sightings)
+        return;
+
+    hash = hash64 (info->image, info->length);
+    host_length = strlen (host);
+    adapter_length = strlen (info->adapter);
+    if (host_length > 255)
+        host_length = 255;
+    if (adapter_length > 255)
+        adapter_length = 255;
+
+    pthread_mutex_lock (&ingest_lock);
+    known = ingest.table ? find_slot (ingest.table, ingest.table_size, hash,
+                                      info->image, info->length) : NULL;
+    if (!known || !known->offset) {
+        if (!(copy = malloc (info->length ? info->length : 1)) ||
+            !(known = add_known (hash, ingest.images_offset, copy, info->length))) {
+            fprintf (stderr, "Out of memory, image not stored\n");
+            free (copy);
+            pthread_mutex_unlock (&ingest_lock);
+            return;
+        }
+        memcpy (copy, info->image, info->length);
+        known->copied = 1;
+        memset (&header, 0, sizeof (header));
+        header.hash = htole64 (hash);
+        header.length = htole32 (info->length);
+        fwrite (&header, sizeof (header), 1, ingest.images);
+        fwrite (info->image, 1, info->length, ingest.images);
+        ingest.images_offset += sizeof (header) + info->length;
+        ingest.new_images++;
+    }
+
+    memset (&sighting, 0, sizeof (sighting));
+    sighting.image = htole64 (known->offset);
+    sighting.timestamp = htole64 (info->timestamp ? info->timestamp : time (NULL));
+    sighting.source = info->source;
+    sighting.client = info->client;
+    sighting.host_length = host_length;
+    sighting.adapter_length = adapter_length;
+    fwrite (&sighting, sizeof (sighting), 1, ingest.sightings);
+    fwrite (host, 1, host_length, ingest.sightings);
+    fwrite (info->adapter, 1, adapter_length, ingest.sightings);
+    ingest.new_sightings++;
+    pthread_mutex_unlock (&ingest_lock);
+}
+
+int store_close (void) {
+    uint32_t i;
+    int result = 0;
+
+    if (ingest.images && (ferror (ingest.images) | fclose (ingest.images)))
+        result = -1;
+    if (ingest.sightings && (ferror (ingest.sightings) | fclose (ingest.sightings)))
+        result = -1;
+    if (result)
+        fprintf (stderr, "Error writing image store: %s\n", strerror (errno));
+    else if (ingest.sightings)
+        fprintf (stderr, "Stored %u sightings, %u new images\n",
+                 ingest.new_sightings, ingest.new_images);
+
+    for (i = 0; i < ingest.table_size; i++)
+        if (ingest.table[i].copied)
+            free ((void *) ingest.table[i].image);
+    free (ingest.table);
+    if (ingest.map)
+        munmap ((void *) ingest.map, ingest.map_size);
+    memset (&ingest, 0, sizeof (ingest));
+    return result;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+struct image_info;
+
+/*
+ * Content addressed store for raw images, a directory holding two append
+ * only files:
+ *
+ *   images:    header | store_image + image | store_image + image | ...
+ *   sightings: header | store_sighting + names | ...
+ *
+ * Every distinct image is kept once in images, identified by its offset
+ * there. Each time an image is seen a small sighting record pointing at
+ * it is appended, carrying the host, the adapter and client it was read
+ * from and the time. All values are little endian.
+ */
+#define STORE_IMAGES            "images"
+#define STORE_SIGHTINGS         "sightings"
+#define STORE_IMAGES_MAGIC      "DSPDIMG1"
+#define STORE_SIGHTINGS_MAGIC   "DSPDSEE1"
+
+#pragma pack(1)
+struct store_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+struct store_image {
+    uint64_t hash;              /* hash64() of the image */
+    uint32_t length;
+    uint32_t reserved;
+};
+
+struct store_sighting {
+    uint64_t image;             /* offset of the store_image in images */
+    uint64_t timestamp;         /* seconds since the epoch */
+    uint8_t source;
+    uint8_t client;
+    uint8_t host_length;
+    uint8_t adapter_length;
+    uint32_t reserved;
+};
+#pragma pack()
+
+struct store {
+    const unsigned char *images;
+    size_t images_size;
+    const unsigned char *sightings;
+    size_t sightings_size;
+};
+
+int is_store (const char *dir);
+int store_map (struct store *store, const char *dir);
+void store_unmap (struct store *store);
+int store_next (const struct store *store, size_t *offset,
+                struct image_info *info);
+
+int store_open (const char *dir);
+int store_is_open (void);
+void store_add (const struct image_info *info);
+int store_close (void);
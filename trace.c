@@ -0,0 +1,116 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+
+#include "trace.h"
+#include "output.h"
+
+static FILE *file;               /* NULL once closed at exit */
+static int enabled;
+static const char *trace_path;
+static uint64_t origin;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread int tid;
+
+static uint64_t now_ns (void) {
+    struct timespec now;
+
+    clock_gettime (CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static int thread_id (void) {
+    if (!tid)
+        tid = syscall (SYS_gettid);
+    return tid;
+}
+
+/* The first event goes right after the opening bracket, all others after a comma */
+static void emit (const char *format, ...) __attribute__ ((format (printf, 1, 2)));
+static void emit (const char *format, ...) {
+    static int events;
+    va_list ap;
+
+    pthread_mutex_lock (&lock);
+    if (file) {
+        fprintf (file, "%s\n", events++ ? "," : "");
+        va_start (ap, format);
+        vfprintf (file, format, ap);
+        va_end (ap);
+    }
+    pthread_mutex_unlock (&lock);
+}
+
+static void trace_close (void) {
+    pthread_mutex_lock (&lock);
+    fprintf (file, "\n]}\n");
+    if (fclose (file))
+        fprintf (stderr, "Can't write %s: %s\n", trace_path, strerror (errno));
+    file = NULL;
+    pthread_mutex_unlock (&lock);
+}
+
+int trace_open (const char *path) {
+    if (!(file = fopen (path, "w"))) {
+        fprintf (stderr, "Can't create %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    if (atexit (trace_close)) {
+        fprintf (stderr, "Can't register the trace for completion\n");
+        fclose (file);
+        file = NULL;
+        return -1;
+    }
+    trace_path = path;
+    origin = now_ns ();
+    enabled = 1;
+    fprintf (file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    trace_thread ("main");
+    return 0;
+}
+
+void trace_thread (const char *name) {
+    char escaped[256];
+
+    if (enabled)
+        emit ("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+              "\"args\":{\"name\":\"%s\"}}", getpid (), thread_id (),
+              json_escape (escaped, sizeof (escaped), name));
+}
+
+uint64_t trace_begin (void) {
+    return enabled ? now_ns () : 0;
+}
+
+void trace_span (uint64_t begin, const char *category, const char *name,
+                 const char *args, ...) {
+    uint64_t end;
+    char members[256] = "", escaped_name[256], escaped_category[64];
+    int saved = errno;
+    va_list ap;
+
+    if (!begin)
+        return;
+
+    end = now_ns ();
+    if (args) {
+        va_start (ap, args);
+        vsnprintf (members, sizeof (members), args, ap);
+        va_end (ap);
+    }
+    emit ("{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+          "\"pid\":%d,\"tid\":%d,\"args\":{%s}}",
+          json_escape (escaped_name, sizeof (escaped_name), name),
+          json_escape (escaped_category, sizeof (escaped_category), category),
+          (begin - origin) / 1000.0, (end - begin) / 1000.0,
+          getpid (), thread_id (), members);
+    errno = saved;
+}
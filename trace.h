@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * A timeline of the scan in Chrome's trace event format, for Perfetto or
+ * chrome://tracing. Every thread is a track of its own; spans of one
+ * thread nest by time. Until trace_open() is called nothing is recorded
+ * and trace_begin() returns 0.
+ */
+
+/* Write the trace to path, completed at exit */
+int trace_open (const char *path);
+/* Name the track of the calling thread */
+void trace_thread (const char *name);
+/* A timestamp to pass to trace_span(), 0 when not tracing */
+uint64_t trace_begin (void);
+/*
+ * A span from begin until now; args, if not NULL, are the members of a
+ * JSON object, with any strings in them escaped by the caller
+ */
+void trace_span (uint64_t begin, const char *category, const char *name,
+                 const char *args, ...) __attribute__ ((format (printf, 4, 5)));
@@ -1,18 +1,35 @@
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include "vendors.h"
 
 #include "vendortable.h"
 
 static const int num_vendors = sizeof (jedec_vendors) / sizeof (jedec_vendors[0]);
 
-const char *get_vendor64 (const unsigned char vendor_id[8]) {
-    int i;
+/*
+ * Convert the SDR/DDR/DDR2 continuation code notation into the 16 bit
+ * notation used from DDR3 on: manufacturer code in the upper byte, bank
+ * number with odd parity in the lower byte.
+ */
+unsigned int get_vendor_id64 (const unsigned char vendor_id[8]) {
+    int i, bit, bank_par = 0x80;
 
     for (i=0; i<8; i++)
         if (vendor_id[i] != 0x7f)
             break;
+    if (i == 8)
+        return 0;
+
+    for (bit=0; bit<7; bit++)
+        if (i & (1 << bit))
+            bank_par ^= 0x80;
+
+    return ((unsigned int) vendor_id[i] << 8) | (bank_par + i);
+}
 
-    return get_vendor16 (256*i+vendor_id[i]);
+const char *get_vendor64 (const unsigned char vendor_id[8]) {
+    return get_vendor16 (get_vendor_id64 (vendor_id));
 }
 
 const char *get_vendor16 (const unsigned int vendor_id) {
@@ -24,3 +41,34 @@ const char *get_vendor16 (const unsigned int vendor_id) {
 
     return "Unknown";
 }
+
+int find_vendor16 (const char *name) {
+    int i;
+
+    for (i=0; i<num_vendors; i++)
+        if (!strcasecmp (jedec_vendors[i].name, name))
+            return jedec_vendors[i].id;
+
+    return -1;
+}
+
+/*
+ * A vendor given by name or as a hex id. Ids are taken in either byte
+ * order, as the SPD bytes read (bank first, 0x80CE for Samsung) or in
+ * the 16 bit notation above (0xCE80), as long as one of them is a known
+ * vendor; -1 if none is.
+ */
+int parse_vendor16 (const char *text) {
+    unsigned long value;
+    char *end;
+
+    value = strtoul (text, &end, 16);
+    if (end == text || *end || value > 0xffff)
+        return find_vendor16 (text);
+    if (strcmp (get_vendor16 (value), "Unknown"))
+        return value;
+    value = (value >> 8) | ((value & 0xff) << 8);
+    if (strcmp (get_vendor16 (value), "Unknown"))
+        return value;
+    return -1;
+}
@@ -1,4 +1,8 @@
 #pragma once
 
+unsigned int get_vendor_id64 (const unsigned char vendor_id[8]);
 const char *get_vendor64 (const unsigned char vendor_id[8]);
 const char *get_vendor16 (const unsigned int vendor_id);
+int find_vendor16 (const char *name);
+/* a name or a known id in either byte order, -1 if neither */
+int parse_vendor16 (const char *text);
@@ -0,0 +1,190 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "container.h"
+#include "store.h"
+#include "files.h"
+#include "crc.h"
+#include "verify.h"
+
+/* images checked together, a multiple of CRC_LANES */
+#define VERIFY_BATCH            256
+
+struct verify {
+    struct image_info infos[VERIFY_BATCH];
+    const unsigned char *images[VERIFY_BATCH];
+    int lengths[VERIFY_BATCH];
+    const char *paths[VERIFY_BATCH];
+    int64_t where[VERIFY_BATCH];    /* record or sighting, -1 for files */
+    int count;
+    unsigned char *bitmap;
+    uint64_t images_seen;
+    uint64_t size;
+    uint64_t passed, failed, unchecked;
+};
+
+static int flush (struct verify *verify) {
+    int results[VERIFY_BATCH];
+    unsigned char *bitmap;
+    uint64_t bit, size;
+    int i;
+
+    if (verify->images_seen + verify->count > verify->size * 8) {
+        size = verify->size ? 2 * verify->size : 4096;
+        if (!(bitmap = realloc (verify->bitmap, size))) {
+            fprintf (stderr, "Out of memory\n");
+            return -1;
+        }
+        memset (bitmap + verify->size, 0, size - verify->size);
+        verify->bitmap = bitmap;
+        verify->size = size;
+    }
+
+    spd_crc_verify (verify->images, verify->lengths, verify->count, results);
+    for (i = 0; i < verify->count; i++) {
+        bit = verify->images_seen + i;
+        if (results[i] == CRC_FAIL || verify->lengths[i] < 0) {
+            verify->failed++;
+            if (verify->where[i] < 0)
+                printf ("%s: %s\n", verify->paths[i],
+                        verify->lengths[i] < 0 ? "unreadable" : "CRC mismatch");
+            else
+                printf ("%s %s %lld: %s\n", verify->paths[i],
+                        is_store (verify->paths[i]) ? "sighting" : "record",
+                        (long long) verify->where[i],
+                        verify->lengths[i] < 0 ? "corrupt" : "CRC mismatch");
+            continue;
+        }
+        if (results[i] == CRC_PASS)
+            verify->passed++;
+        else
+            verify->unchecked++;
+        verify->bitmap[bit / 8] |= 1 << (bit % 8);
+    }
+    verify->images_seen += verify->count;
+    verify->count = 0;
+    return 0;
+}
+
+/* The next slot of the batch, flushing a full one first; length -1 marks it bad */
+static struct image_info *next_slot (struct verify *verify, const char *path,
+                                     int64_t where) {
+    if (verify->count == VERIFY_BATCH && flush (verify))
+        return NULL;
+    verify->paths[verify->count] = path;
+    verify->where[verify->count] = where;
+    verify->infos[verify->count].image = NULL;
+    verify->infos[verify->count].length = -1;
+    return &verify->infos[verify->count];
+}
+
+static void add_slot (struct verify *verify, const struct image_info *info) {
+    verify->images[verify->count] = info->image;
+    verify->lengths[verify->count] = info->length;
+    verify->count++;
+}
+
+static int verify_path (struct verify *verify, const char *path) {
+    struct container container;
+    struct store store;
+    struct image_info *info;
+    size_t offset = 0;
+    uint32_t record;
+    int fd, n = 0, count = 0, result = 0;
+
+    if (!container_open (&container, path)) {
+        for (record = 0; record < container.count && !result; record++) {
+            if (!(info = next_slot (verify, path, record)))
+                result = -1;
+            else {
+                if (container_get (&container, record, info))
+                    info->length = -1;
+                add_slot (verify, info);
+            }
+        }
+        /* the batch points into the mapping */
+        if (flush (verify))
+            result = -1;
+        container_close (&container);
+        return result;
+    }
+
+    if (is_store (path)) {
+        if (store_map (&store, path)) {
+            fprintf (stderr, "Can't open image store %s: %s\n", path, strerror (errno));
+            return -1;
+        }
+        while (!result && (info = next_slot (verify, path, count)) &&
+               (n = store_next (&store, &offset, info)) > 0) {
+            add_slot (verify, info);
+            count++;
+        }
+        if (info && n < 0)
+            fprintf (stderr, "%s: corrupt sighting %d\n", path, count);
+        if (!info || flush (verify))
+            result = -1;
+        store_unmap (&store);
+        return result;
+    }
+
+    if ((fd = open (path, O_RDONLY)) < 0) {
+        fprintf (stderr, "Can't open %s: %s\n", path, strerror (errno));
+        return -1;
+    }
+    /* the CRCs are all within the first 256 bytes */
+    if (!(info = next_slot (verify, path, -1)))
+        result = -1;
+    else {
+        if ((info->length = read (fd, info->data, sizeof (info->data))) >= 0)
+            info->image = info->data;
+        add_slot (verify, info);
+    }
+    close (fd);
+    return result;
+}
+
+int verify_paths (int count, char **paths, const char *bitmap) {
+    static struct verify verify;
+    struct path_list list;
+    FILE *file;
+    int i, result = 0;
+
+    memset (&list, 0, sizeof (list));
+    for (i = 0; i < count; i++)
+        if (collect_path (paths[i], &list) && errno == ENOMEM) {
+            fprintf (stderr, "Out of memory\n");
+            free_path_list (&list);
+            return -1;
+        }
+
+    memset (&verify, 0, sizeof (verify));
+    for (i = 0; i < list.count && !result; i++)
+        result = verify_path (&verify, list.paths[i]);
+    if (!result)
+        result = flush (&verify);
+
+    if (!result) {
+        if (!(file = fopen (bitmap, "w"))) {
+            fprintf (stderr, "Can't create %s: %s\n", bitmap, strerror (errno));
+            result = -1;
+        } else {
+            fwrite (verify.bitmap, 1, (verify.images_seen + 7) / 8, file);
+            if (ferror (file) | fclose (file)) {
+                fprintf (stderr, "Error writing %s: %s\n", bitmap, strerror (errno));
+                result = -1;
+            }
+        }
+        printf ("Verified %llu images: %llu passed, %llu failed, %llu without CRC\n",
+                (unsigned long long) verify.images_seen,
+                (unsigned long long) verify.passed,
+                (unsigned long long) verify.failed,
+                (unsigned long long) verify.unchecked);
+    }
+    free (verify.bitmap);
+    free_path_list (&list);
+    return result ? -1 : verify.failed > 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+/*
+ * Bulk integrity check of the SPD CRCs of every image in the given files,
+ * containers and stores. The result is a bitmap with one bit per image in
+ * input order, least significant bit first, set unless a CRC is wrong.
+ */
+int verify_paths (int count, char **paths, const char *bitmap);